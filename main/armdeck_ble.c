@@ -1,5 +1,7 @@
 #include "armdeck_ble.h"
 #include "armdeck_service.h"
+#include "armdeck_link.h"
+#include "esp_hidd_prf_api.h"
 #include "esp_log.h"
 #include "esp_bt_device.h"
 #include "esp_timer.h"
@@ -17,11 +19,50 @@ static esp_timer_handle_t adv_restart_timer = NULL;
 
 /* Callbacks */
 static esp_gap_ble_cb_t user_gap_callback = NULL;
-static esp_gatts_cb_t user_gatts_callback = NULL;
 
-/* GATTS interface */
+/* GATTS interface of the configuration service */
 static esp_gatt_if_t gatts_if = ESP_GATT_IF_NONE;
 
+/* GATTS applications. Bluedroid keeps a single GATTS callback: each application registers
+ * here and each event goes to exactly one owner, looked up by attribute handle for
+ * attribute accesses and by gatts_if for the rest (every application gets its own copy
+ * of the connection events). Handles are claimed as the owner creates its attributes. */
+#define BLE_GATTS_MAX_APPS          4
+#define BLE_GATTS_MAX_IF            16      // gatts_if values handed out by the stack
+#define BLE_GATT_MAX_HANDLES        128     // Attribute database size
+
+typedef struct {
+    uint16_t app_id;
+    esp_gatts_cb_t callback;
+} gatts_app_t;
+
+static gatts_app_t gatts_apps[BLE_GATTS_MAX_APPS];
+static uint8_t num_gatts_apps = 0;
+static bool gatts_dispatcher_registered = false;
+
+/* Owner per gatts_if and per attribute handle: index in gatts_apps + 1, 0 = none */
+static uint8_t if_owner[BLE_GATTS_MAX_IF];
+static uint8_t handle_owner[BLE_GATT_MAX_HANDLES];
+
+/* Notification longer than one MTU, sent chunk by chunk (BLE stack task) */
+static struct {
+    esp_gatt_if_t gatts_if;
+    uint16_t conn_id;
+    uint16_t handle;
+    uint16_t len;
+    uint16_t offset;                // Bytes sent, offset == len when idle
+    uint8_t data[ARMDECK_NOTIFY_MAX_LEN];
+} long_notify;
+static bool link_congested = false; // Between the two ESP_GATTS_CONGEST_EVT
+
+/* Connection interval, set by the BLE stack task and read by the dispatch task */
+#define BLE_CONN_INTERVAL_UNIT_US   1250
+#define BLE_MIN_CONN_INTERVAL_US    7500    // Assumed until the link reports its interval
+static volatile uint32_t conn_interval_us = 0;
+
+/* ATT MTU per connection ID, set by the BLE stack task, 0 = default */
+static volatile uint16_t conn_mtu[BLE_MAX_CONNECTIONS];
+
 /* Service UUIDs for advertising - Big-endian format matching service definition */
 static uint8_t armdeck_service_uuid[16] = {0x7a, 0x0b, 0x10, 0x00, 0x00, 0x00, 0x10, 0x00,
                                            0x80, 0x00, 0x00, 0x80, 0x5f, 0x9b, 0x34, 0xfb};
@@ -137,6 +178,18 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
             }
             break;
             
+        case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+            if (param->update_conn_params.status == ESP_BT_STATUS_SUCCESS) {
+                conn_interval_us = param->update_conn_params.conn_int * BLE_CONN_INTERVAL_UNIT_US;
+                ESP_LOGI(TAG, "Connection interval: %lu us, latency %d",
+                         conn_interval_us, param->update_conn_params.latency);
+            }
+            armdeck_link_params_updated(param->update_conn_params.status == ESP_BT_STATUS_SUCCESS,
+                                        param->update_conn_params.conn_int,
+                                        param->update_conn_params.latency,
+                                        param->update_conn_params.timeout);
+            break;
+            
         default:
             break;
     }
@@ -147,21 +200,179 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
     }
 }
 
-/* GATTS event handler */
+static void claim_handles(uint8_t owner, uint16_t first, uint16_t count) {
+    for (uint16_t handle = first; handle < first + count; handle++) {
+        if (handle < BLE_GATT_MAX_HANDLES) {
+            handle_owner[handle] = owner;
+        } else {
+            /* Still routed, by gatts_if */
+            ESP_LOGW(TAG, "Attribute handle %d beyond the dispatch table", handle);
+        }
+    }
+}
+
+/* Attributes created by an application belong to it */
+static void claim_created(uint8_t owner, esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t *param) {
+    switch (event) {
+        case ESP_GATTS_CREATE_EVT:
+            if (param->create.status == ESP_GATT_OK) {
+                claim_handles(owner, param->create.service_handle, 1);
+            }
+            break;
+            
+        case ESP_GATTS_ADD_CHAR_EVT:
+            /* Declaration and value */
+            if (param->add_char.status == ESP_GATT_OK) {
+                claim_handles(owner, param->add_char.attr_handle - 1, 2);
+            }
+            break;
+            
+        case ESP_GATTS_ADD_CHAR_DESCR_EVT:
+            if (param->add_char_descr.status == ESP_GATT_OK) {
+                claim_handles(owner, param->add_char_descr.attr_handle, 1);
+            }
+            break;
+            
+        case ESP_GATTS_CREAT_ATTR_TAB_EVT:
+            if (param->add_attr_tab.status == ESP_GATT_OK) {
+                for (uint16_t i = 0; i < param->add_attr_tab.num_handle; i++) {
+                    claim_handles(owner, param->add_attr_tab.handles[i], 1);
+                }
+            }
+            break;
+            
+        default:
+            break;
+    }
+}
+
+/* Attribute an event is about, 0 for connection and application events */
+static uint16_t event_handle(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t *param) {
+    switch (event) {
+        case ESP_GATTS_READ_EVT:
+            return param->read.handle;
+        case ESP_GATTS_WRITE_EVT:
+            return param->write.handle;
+        case ESP_GATTS_CONF_EVT:
+            return param->conf.handle;
+        default:
+            return 0;
+    }
+}
+
+/* Send the chunks of the long notification until it is done, the link is congested or
+ * the stack refuses one. Resumed on each ESP_GATTS_CONF_EVT and at the end of congestion. */
+static esp_err_t send_long_notify(void) {
+    uint16_t chunk = armdeck_ble_get_mtu(long_notify.conn_id) - 3;
+    while (long_notify.offset < long_notify.len && !link_congested) {
+        uint16_t n = long_notify.len - long_notify.offset < chunk ? long_notify.len - long_notify.offset : chunk;
+        esp_err_t ret = esp_ble_gatts_send_indicate(long_notify.gatts_if, long_notify.conn_id, long_notify.handle,
+                                                    n, long_notify.data + long_notify.offset, false);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        long_notify.offset += n;
+    }
+    return ESP_OK;
+}
+
+/* Connection bookkeeping and long notifications, from the configuration service's copy of each event */
+static void track_connection(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t *param) {
+    /* Track the connection interval (updates come through GAP) */
+    if (event == ESP_GATTS_CONNECT_EVT) {
+        conn_interval_us = param->connect.conn_params.interval * BLE_CONN_INTERVAL_UNIT_US;
+        armdeck_link_connected(param->connect.remote_bda, param->connect.conn_params.interval,
+                               param->connect.conn_params.latency, param->connect.conn_params.timeout);
+    } else if (event == ESP_GATTS_DISCONNECT_EVT) {
+        conn_interval_us = 0;
+        armdeck_link_disconnected();
+        long_notify.offset = long_notify.len = 0;
+        link_congested = false;
+        if (param->disconnect.conn_id < BLE_MAX_CONNECTIONS) {
+            conn_mtu[param->disconnect.conn_id] = 0;
+        }
+    } else if (event == ESP_GATTS_MTU_EVT && param->mtu.conn_id < BLE_MAX_CONNECTIONS) {
+        conn_mtu[param->mtu.conn_id] = param->mtu.mtu;
+        ESP_LOGI(TAG, "ATT MTU %d on connection %d: %d bytes per notification",
+                 param->mtu.mtu, param->mtu.conn_id, param->mtu.mtu - 3);
+    } else if (event == ESP_GATTS_CONGEST_EVT) {
+        link_congested = param->congest.congested;
+        if (!link_congested) {
+            send_long_notify();
+        }
+    } else if (event == ESP_GATTS_CONF_EVT) {
+        send_long_notify();
+    }
+}
+
+/* GATTS event dispatcher */
 static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if_param,
                                 esp_ble_gatts_cb_param_t *param) {
-    /* Store interface ID */
-    if (event == ESP_GATTS_REG_EVT && param->reg.status == ESP_GATT_OK) {
-        gatts_if = gatts_if_param;
+    uint8_t owner = 0;
+    
+    if (event == ESP_GATTS_REG_EVT) {
+        for (uint8_t i = 0; i < num_gatts_apps; i++) {
+            if (gatts_apps[i].app_id == param->reg.app_id) {
+                owner = i + 1;
+                break;
+            }
+        }
+        if (owner && param->reg.status == ESP_GATT_OK && gatts_if_param < BLE_GATTS_MAX_IF) {
+            if_owner[gatts_if_param] = owner;
+        }
+        if (param->reg.app_id == ARMDECK_GATTS_APP_ID && param->reg.status == ESP_GATT_OK) {
+            gatts_if = gatts_if_param;
+        }
+    } else {
+        uint16_t handle = event_handle(event, param);
+        if (handle != 0 && handle < BLE_GATT_MAX_HANDLES) {
+            owner = handle_owner[handle];
+        }
+        if (owner == 0 && gatts_if_param < BLE_GATTS_MAX_IF) {
+            owner = if_owner[gatts_if_param];
+        }
+        if (owner != 0) {
+            claim_created(owner, event, param);
+        }
     }
     
-    /* Forward to service handler */
-    armdeck_service_gatts_handler(event, gatts_if_param, param);
+    if (gatts_if_param == gatts_if && gatts_if != ESP_GATT_IF_NONE) {
+        track_connection(event, param);
+    }
     
-    /* Forward to user callback */
-    if (user_gatts_callback) {
-        user_gatts_callback(event, gatts_if_param, param);
+    if (owner != 0) {
+        gatts_apps[owner - 1].callback(event, gatts_if_param, param);
+    } else if (gatts_if_param == ESP_GATT_IF_NONE) {
+        /* Not addressed to one application */
+        for (uint8_t i = 0; i < num_gatts_apps; i++) {
+            gatts_apps[i].callback(event, gatts_if_param, param);
+        }
+    } else {
+        ESP_LOGD(TAG, "GATTS event %d for gatts_if %d has no owner", event, gatts_if_param);
+    }
+}
+
+esp_err_t armdeck_ble_register_gatts_app(uint16_t app_id, esp_gatts_cb_t callback) {
+    if (num_gatts_apps >= BLE_GATTS_MAX_APPS) {
+        ESP_LOGE(TAG, "No room for GATTS application 0x%04x", app_id);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    if (!gatts_dispatcher_registered) {
+        esp_err_t ret = esp_ble_gatts_register_callback(gatts_event_handler);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to register GATTS callback: %s", esp_err_to_name(ret));
+            return ret;
+        }
+        gatts_dispatcher_registered = true;
     }
+    
+    /* In the table before the stack answers with ESP_GATTS_REG_EVT */
+    gatts_apps[num_gatts_apps].app_id = app_id;
+    gatts_apps[num_gatts_apps].callback = callback;
+    num_gatts_apps++;
+    
+    return esp_ble_gatts_app_register(app_id);
 }
 
 esp_err_t armdeck_ble_init(void) {
@@ -181,16 +392,16 @@ esp_err_t armdeck_ble_init(void) {
         }
     }
     
-    /* Register callbacks */
-    esp_err_t ret = esp_ble_gap_register_callback(gap_event_handler);
+    /* Offer a large MTU, the client picks the one used in its exchange */
+    esp_err_t ret = esp_ble_gatt_set_local_mtu(ARMDECK_PREFERRED_MTU);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register GAP callback: %s", esp_err_to_name(ret));
-        return ret;
+        ESP_LOGW(TAG, "Failed to set local MTU %d: %s", ARMDECK_PREFERRED_MTU, esp_err_to_name(ret));
     }
     
-    ret = esp_ble_gatts_register_callback(gatts_event_handler);
+    /* Register callbacks */
+    ret = esp_ble_gap_register_callback(gap_event_handler);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register GATTS callback: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to register GAP callback: %s", esp_err_to_name(ret));
         return ret;
     }
     
@@ -202,7 +413,7 @@ esp_err_t armdeck_ble_init(void) {
     }
     
     /* Register GATTS application for custom service */
-    ret = esp_ble_gatts_app_register(0x55);  // App ID for ArmDeck service
+    ret = armdeck_ble_register_gatts_app(ARMDECK_GATTS_APP_ID, armdeck_service_gatts_handler);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register GATTS app: %s", esp_err_to_name(ret));
         return ret;
@@ -262,12 +473,51 @@ ble_adv_state_t armdeck_ble_get_adv_state(void) {
     return adv_state;
 }
 
-void armdeck_ble_register_gap_callback(esp_gap_ble_cb_t callback) {
-    user_gap_callback = callback;
+uint32_t armdeck_ble_get_conn_interval_us(void) {
+    uint32_t interval_us = conn_interval_us;
+    return interval_us ? interval_us : BLE_MIN_CONN_INTERVAL_US;
 }
 
-void armdeck_ble_register_gatts_callback(esp_gatts_cb_t callback) {
-    user_gatts_callback = callback;
+uint16_t armdeck_ble_get_mtu(uint16_t conn_id) {
+    uint16_t mtu = conn_id < BLE_MAX_CONNECTIONS ? conn_mtu[conn_id] : 0;
+    return mtu ? mtu : ESP_GATT_DEF_BLE_MTU_SIZE;
+}
+
+esp_err_t armdeck_ble_notify(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t handle,
+                             const uint8_t* data, uint16_t len) {
+    if (len == 0) {
+        return ESP_OK;
+    }
+    if (long_notify.offset < long_notify.len) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    /* Notification header: opcode and handle */
+    if (len <= armdeck_ble_get_mtu(conn_id) - 3) {
+        return esp_ble_gatts_send_indicate(gatts_if, conn_id, handle, len, (uint8_t*)data, false);
+    }
+    if (len > sizeof(long_notify.data)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    long_notify.gatts_if = gatts_if;
+    long_notify.conn_id = conn_id;
+    long_notify.handle = handle;
+    long_notify.len = len;
+    long_notify.offset = 0;
+    memcpy(long_notify.data, data, len);
+    
+    esp_err_t ret = send_long_notify();
+    if (ret != ESP_OK && long_notify.offset == 0) {
+        /* Nothing went out: the client reads the value back instead */
+        long_notify.len = 0;
+        return ret;
+    }
+    return ESP_OK;
+}
+
+void armdeck_ble_register_gap_callback(esp_gap_ble_cb_t callback) {
+    user_gap_callback = callback;
 }
 
 void armdeck_ble_set_continuous_advertising(bool enable) {
@@ -9,6 +9,18 @@
 
 #define ARMDECK_DEVICE_NAME "ArmDeck"
 
+/* ATT MTU offered to clients: a whole protocol response fits one notification or read */
+#define ARMDECK_PREFERRED_MTU       517
+
+/* Longest value armdeck_ble_notify() sends (ATT attribute value limit) */
+#define ARMDECK_NOTIFY_MAX_LEN      512
+
+/* GATTS application of the configuration service */
+#define ARMDECK_GATTS_APP_ID        0x55
+
+/* Connections tracked for their MTU */
+#define BLE_MAX_CONNECTIONS         4
+
 /* BLE advertising state */
 typedef enum {
     BLE_ADV_STOPPED,
@@ -28,13 +40,27 @@ esp_err_t armdeck_ble_stop_advertising(void);
 /* Get advertising state */
 ble_adv_state_t armdeck_ble_get_adv_state(void);
 
+/* Current connection interval in microseconds (the 7.5 ms BLE minimum until the link reports one) */
+uint32_t armdeck_ble_get_conn_interval_us(void);
+
+/* ATT MTU negotiated on a connection (ESP_GATT_DEF_BLE_MTU_SIZE until the client exchanges it) */
+uint16_t armdeck_ble_get_mtu(uint16_t conn_id);
+
+/* Notify a value (BLE stack task). A value larger than one notification is split in
+ * MTU-sized chunks, the rest going out as the stack confirms each one; until it is done,
+ * other notifications are refused (ESP_ERR_INVALID_STATE) so none interleaves with it.
+ * A value refused before its first chunk went out returns an error, never a partial value. */
+esp_err_t armdeck_ble_notify(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t handle,
+                             const uint8_t* data, uint16_t len);
+
 /* Enable/disable continuous advertising (restarts automatically when stopped) */
 void armdeck_ble_set_continuous_advertising(bool enable);
 
 /* Register GAP callback */
 void armdeck_ble_register_gap_callback(esp_gap_ble_cb_t callback);
 
-/* Register GATTS callback */
-void armdeck_ble_register_gatts_callback(esp_gatts_cb_t callback);
+/* Register a GATTS application: events for its gatts_if and for the attributes it
+ * creates go to callback, and only to it. Usable before armdeck_ble_init(). */
+esp_err_t armdeck_ble_register_gatts_app(uint16_t app_id, esp_gatts_cb_t callback);
 
 #endif /* ARMDECK_BLE_H */
\ No newline at end of file
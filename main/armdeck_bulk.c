@@ -0,0 +1,319 @@
+#include "armdeck_bulk.h"
+#include "armdeck_ble.h"
+#include "armdeck_service.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char* TAG = "ARMDECK_BULK";
+
+/* Notification or write-without-response header: opcode and handle */
+#define BULK_ATT_HEADER             3
+
+#define BULK_MAX_SEGMENTS           (ARMDECK_BULK_MAX_LEN / ARMDECK_BULK_MIN_SEGMENT)
+
+/* Downloads hold the whole response packet, the framing is not sent */
+#define BULK_FRAMING                (sizeof(armdeck_header_t) + 1)
+
+typedef enum {
+    BULK_IDLE,
+    BULK_UPLOAD,
+    BULK_DOWNLOAD,
+} bulk_state_t;
+
+typedef struct {
+    bulk_state_t state;
+    uint8_t id;
+    uint8_t command;
+    uint16_t length;
+    uint16_t segment_size;
+    uint16_t segments;
+    uint16_t next_seq;              // Upload: first missing segment. Download: last host ack.
+    uint16_t next_send;             // Download: next segment to notify
+    uint16_t received_count;        // Upload: distinct segments stored
+    uint16_t unacked;               // Upload: segments received since the last ack
+    uint16_t duplicates;
+    uint16_t open_len;              // Open request, to recognise a repeated one
+    uint8_t open_check;
+    int64_t started_us;
+    uint8_t received[(BULK_MAX_SEGMENTS + 7) / 8];
+} bulk_transfer_t;
+
+static bulk_transfer_t transfer = { .state = BULK_IDLE };
+static uint8_t last_id = 0;
+
+/* Reassembly buffer (uploads) or response packet (downloads) */
+static uint8_t staging[BULK_FRAMING + ARMDECK_BULK_MAX_LEN];
+
+static uint8_t segment_frame[ARMDECK_PREFERRED_MTU];
+
+static bool is_bulk_command(uint8_t command) {
+    return command == CMD_BULK_WRITE || command == CMD_BULK_READ || command == CMD_BULK_ACK;
+}
+
+static bool is_received(uint16_t seq) {
+    return transfer.received[seq / 8] & (1 << (seq % 8));
+}
+
+static uint16_t segment_len(uint16_t seq) {
+    uint16_t offset = seq * transfer.segment_size;
+    return transfer.length - offset < transfer.segment_size ? transfer.length - offset : transfer.segment_size;
+}
+
+/* Largest segment a notification or a write carries at the current MTU, or the
+ * smaller size the host asked for */
+static uint16_t pick_segment_size(uint16_t wanted) {
+    uint16_t size = armdeck_ble_get_mtu(armdeck_service_get_conn_id()) - BULK_ATT_HEADER - sizeof(armdeck_segment_t);
+    if (wanted != 0 && wanted < size) {
+        size = wanted;
+    }
+    if (size < ARMDECK_BULK_MIN_SEGMENT) {
+        size = ARMDECK_BULK_MIN_SEGMENT;
+    }
+    return size;
+}
+
+static bool is_repeated_open(bulk_state_t state, const uint8_t* payload, uint16_t payload_len) {
+    /* Response lost and the host asks again before any data moved: same transfer */
+    return transfer.state == state && transfer.open_len == payload_len &&
+           transfer.open_check == armdeck_protocol_checksum(payload, payload_len) &&
+           (state == BULK_UPLOAD ? transfer.received_count == 0 : transfer.next_send == 0);
+}
+
+static void start_transfer(bulk_state_t state, uint8_t command, uint16_t length, uint16_t segment_size,
+                           const uint8_t* payload, uint16_t payload_len) {
+    memset(&transfer, 0, sizeof(transfer));
+    transfer.state = state;
+    transfer.id = ++last_id;
+    transfer.command = command;
+    transfer.length = length;
+    transfer.segment_size = segment_size;
+    transfer.segments = (length + segment_size - 1) / segment_size;
+    transfer.open_len = payload_len;
+    transfer.open_check = armdeck_protocol_checksum(payload, payload_len);
+    transfer.started_us = esp_timer_get_time();
+}
+
+static esp_err_t respond_info(uint8_t cmd, uint8_t* output, uint16_t* output_len) {
+    armdeck_bulk_info_t info = {
+        .transfer_id = transfer.id,
+        .command = transfer.command,
+        .length = transfer.length,
+        .segment_size = transfer.segment_size,
+        .window = ARMDECK_BULK_WINDOW,
+    };
+    
+    *output_len = armdeck_protocol_build_response(cmd, ERR_NONE, &info, sizeof(info), output, 256);
+    return ESP_OK;
+}
+
+static void log_done(const char* what) {
+    uint32_t elapsed_ms = (esp_timer_get_time() - transfer.started_us) / 1000;
+    ESP_LOGI(TAG, "%s %d: %d bytes for 0x%02X in %d segments of %d, %lu ms (%lu bytes/s), %d duplicates",
+             what, transfer.id, transfer.length, transfer.command, transfer.segments, transfer.segment_size,
+             elapsed_ms, elapsed_ms ? transfer.length * 1000UL / elapsed_ms : 0, transfer.duplicates);
+}
+
+static void send_ack(uint8_t error) {
+    armdeck_bulk_ack_t ack = {
+        .transfer_id = transfer.id,
+        .next_seq = transfer.next_seq,
+        .received = 0,
+    };
+    for (uint16_t i = 0; i < 32 && transfer.next_seq + 1 + i < transfer.segments; i++) {
+        if (is_received(transfer.next_seq + 1 + i)) {
+            ack.received |= 1UL << i;
+        }
+    }
+    
+    uint8_t packet[sizeof(armdeck_header_t) + 1 + sizeof(ack) + 1];
+    uint16_t len = armdeck_protocol_build_response(CMD_BULK_ACK, error, &ack, sizeof(ack), packet, sizeof(packet));
+    esp_err_t ret = armdeck_service_send_notification(packet, len);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot send ack %d/%d: %s", transfer.next_seq, transfer.segments, esp_err_to_name(ret));
+    }
+    transfer.unacked = 0;
+}
+
+static void complete_upload(void) {
+    send_ack(ERR_NONE);
+    log_done("Upload");
+    transfer.state = BULK_IDLE;
+    
+    /* The command answers as if its payload had come in one packet */
+    uint8_t response[256];
+    uint16_t response_len = 0;
+    armdeck_protocol_dispatch(transfer.command, staging, transfer.length, response, &response_len, sizeof(response));
+    if (response_len > 0) {
+        armdeck_service_send_notification(response, response_len);
+    }
+}
+
+esp_err_t armdeck_bulk_open_write(const uint8_t* payload, uint16_t payload_len,
+                                  uint8_t* output, uint16_t* output_len) {
+    armdeck_bulk_begin_t begin;
+    if (payload_len != sizeof(begin)) {
+        *output_len = armdeck_protocol_build_response(CMD_BULK_WRITE, ERR_INVALID_PARAM,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&begin, payload, sizeof(begin));
+    
+    if (begin.length == 0 || begin.length > ARMDECK_BULK_MAX_LEN || is_bulk_command(begin.command)) {
+        ESP_LOGE(TAG, "Invalid upload: %d bytes for 0x%02X", begin.length, begin.command);
+        *output_len = armdeck_protocol_build_response(CMD_BULK_WRITE,
+                                                      is_bulk_command(begin.command) ? ERR_INVALID_PARAM : ERR_LENGTH,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (!is_repeated_open(BULK_UPLOAD, payload, payload_len)) {
+        start_transfer(BULK_UPLOAD, begin.command, begin.length, pick_segment_size(begin.segment_size),
+                       payload, payload_len);
+        ESP_LOGI(TAG, "Upload %d opened: %d bytes for 0x%02X, %d segments of %d",
+                 transfer.id, transfer.length, transfer.command, transfer.segments, transfer.segment_size);
+    }
+    
+    return respond_info(CMD_BULK_WRITE, output, output_len);
+}
+
+esp_err_t armdeck_bulk_open_read(const uint8_t* payload, uint16_t payload_len,
+                                 uint8_t* output, uint16_t* output_len) {
+    if (payload_len < 1 || is_bulk_command(payload[0])) {
+        *output_len = armdeck_protocol_build_response(CMD_BULK_READ, ERR_INVALID_PARAM,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (is_repeated_open(BULK_DOWNLOAD, payload, payload_len)) {
+        return respond_info(CMD_BULK_READ, output, output_len);
+    }
+    
+    /* Build the whole response packet in the staging buffer */
+    transfer.state = BULK_IDLE;
+    uint16_t packet_len = 0;
+    armdeck_protocol_dispatch(payload[0], payload + 1, payload_len - 1, staging, &packet_len, sizeof(staging));
+    if (packet_len < BULK_FRAMING + 1) {
+        *output_len = armdeck_protocol_build_response(CMD_BULK_READ, ERR_INVALID_CMD,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    /* Errors are small: answer them directly, as the command would */
+    if (staging[sizeof(armdeck_header_t)] != ERR_NONE && packet_len <= 256) {
+        memcpy(output, staging, packet_len);
+        *output_len = packet_len;
+        return ESP_OK;
+    }
+    
+    start_transfer(BULK_DOWNLOAD, payload[0], packet_len - BULK_FRAMING, pick_segment_size(0),
+                   payload, payload_len);
+    ESP_LOGI(TAG, "Download %d opened: %d bytes for 0x%02X, %d segments of %d",
+             transfer.id, transfer.length, transfer.command, transfer.segments, transfer.segment_size);
+             
+    return respond_info(CMD_BULK_READ, output, output_len);
+}
+
+esp_err_t armdeck_bulk_receive_ack(const uint8_t* payload, uint16_t payload_len) {
+    armdeck_bulk_ack_t ack;
+    if (payload_len != sizeof(ack)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&ack, payload, sizeof(ack));
+    
+    /* Late ack of a finished download */
+    if (transfer.state != BULK_DOWNLOAD || ack.transfer_id != transfer.id) {
+        return ESP_OK;
+    }
+    if (ack.next_seq > transfer.segments) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (ack.next_seq == transfer.segments) {
+        log_done("Download");
+        transfer.state = BULK_IDLE;
+        return ESP_OK;
+    }
+    
+    /* A repeated ack (host timeout) sends again what was refused by the stack, never
+     * what was already notified: notifications are not lost on a live link */
+    transfer.next_seq = ack.next_seq;
+    if (transfer.next_send < ack.next_seq) {
+        transfer.next_send = ack.next_seq;
+    }
+    
+    const uint8_t* data = staging + sizeof(armdeck_header_t);
+    uint16_t limit = ack.next_seq + ARMDECK_BULK_WINDOW;
+    while (transfer.next_send < limit && transfer.next_send < transfer.segments) {
+        uint16_t seq = transfer.next_send;
+        uint16_t len = segment_len(seq);
+        armdeck_segment_t header = {
+            .marker = ARMDECK_SEGMENT_MARKER,
+            .transfer_id = transfer.id,
+            .seq = seq,
+        };
+        memcpy(segment_frame, &header, sizeof(header));
+        memcpy(segment_frame + sizeof(header), data + seq * transfer.segment_size, len);
+        
+        esp_err_t ret = armdeck_service_send_notification(segment_frame, sizeof(header) + len);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Segment %d not sent: %s", seq, esp_err_to_name(ret));
+            break;
+        }
+        transfer.next_send++;
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t armdeck_bulk_receive_segment(const uint8_t* data, uint16_t len) {
+    armdeck_segment_t header;
+    if (len < sizeof(header)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(&header, data, sizeof(header));
+    
+    /* Late segment of a finished or dropped upload */
+    if (transfer.state != BULK_UPLOAD || header.transfer_id != transfer.id) {
+        ESP_LOGD(TAG, "Segment %d of transfer %d ignored", header.seq, header.transfer_id);
+        return ESP_OK;
+    }
+    
+    uint16_t data_len = len - sizeof(header);
+    if (header.seq >= transfer.segments || data_len != segment_len(header.seq)) {
+        ESP_LOGE(TAG, "Upload %d aborted: segment %d of %d bytes", transfer.id, header.seq, data_len);
+        send_ack(ERR_LENGTH);
+        transfer.state = BULK_IDLE;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    if (is_received(header.seq)) {
+        transfer.duplicates++;
+        return ESP_OK;
+    }
+    
+    /* In place: no copy once the upload is complete */
+    memcpy(staging + header.seq * transfer.segment_size, data + sizeof(header), data_len);
+    transfer.received[header.seq / 8] |= 1 << (header.seq % 8);
+    transfer.received_count++;
+    transfer.unacked++;
+    while (transfer.next_seq < transfer.segments && is_received(transfer.next_seq)) {
+        transfer.next_seq++;
+    }
+    
+    if (transfer.next_seq == transfer.segments) {
+        complete_upload();
+    } else if (transfer.unacked >= ARMDECK_BULK_WINDOW / 2) {
+        /* Half a window: the host can keep sending while this ack travels */
+        send_ack(ERR_NONE);
+    }
+    
+    return ESP_OK;
+}
+
+void armdeck_bulk_reset(void) {
+    if (transfer.state != BULK_IDLE) {
+        ESP_LOGW(TAG, "Transfer %d dropped at segment %d/%d", transfer.id, transfer.next_seq, transfer.segments);
+    }
+    transfer.state = BULK_IDLE;
+}
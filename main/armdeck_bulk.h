@@ -0,0 +1,30 @@
+#ifndef ARMDECK_BULK_H
+#define ARMDECK_BULK_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "armdeck_protocol.h"
+
+/* Segmented transfers over the command characteristic (see armdeck_protocol.h).
+ * Everything runs in the BLE stack task, one transfer at a time: opening a new
+ * transfer drops the previous one. Acknowledgements, download segments and the
+ * response to a completed upload are sent as notifications. */
+
+/* CMD_BULK_WRITE: open an upload, the info response is built in output */
+esp_err_t armdeck_bulk_open_write(const uint8_t* payload, uint16_t payload_len,
+                                  uint8_t* output, uint16_t* output_len);
+
+/* CMD_BULK_READ: run the command and open its response for download */
+esp_err_t armdeck_bulk_open_read(const uint8_t* payload, uint16_t payload_len,
+                                 uint8_t* output, uint16_t* output_len);
+
+/* CMD_BULK_ACK from the host: notify the next download segments */
+esp_err_t armdeck_bulk_receive_ack(const uint8_t* payload, uint16_t payload_len);
+
+/* Upload segment (starts with ARMDECK_SEGMENT_MARKER) */
+esp_err_t armdeck_bulk_receive_segment(const uint8_t* data, uint16_t len);
+
+/* Drop the transfer in progress (disconnection) */
+void armdeck_bulk_reset(void);
+
+#endif /* ARMDECK_BULK_H */
@@ -0,0 +1,113 @@
+#include "armdeck_button_table.h"
+#include "armdeck_config.h"
+#include "button_matrix.h"
+#include "esp_log.h"
+#include <string.h>
+
+#ifdef ARMDECK_PRESS_BENCHMARK
+#include "esp_cpu.h"
+#endif
+
+static const char* TAG = "ARMDECK_BUTTONS";
+
+static armdeck_button_entry_t table[MATRIX_MAX_KEYS];
+static uint8_t num_entries = 0;
+static volatile bool reload_pending = false;
+
+static void compile_table(void) {
+    uint8_t num_buttons = armdeck_config_get_num_buttons();
+    if (num_buttons > MATRIX_MAX_KEYS) {
+        num_buttons = MATRIX_MAX_KEYS;
+    }
+    
+    for (int i = 0; i < num_buttons; i++) {
+        const armdeck_button_t* button = armdeck_config_get_button(i);
+        const armdeck_button_ext_t* ext = armdeck_config_get_button_ext(i);
+        armdeck_button_entry_t* entry = &table[i];
+        
+        /* Tap is the button action, hold and double tap come from its gestures */
+        entry->actions[GESTURE_TAP] = (armdeck_action_def_t){
+            .action_type = button->action_type,
+            .key_code = button->key_code,
+            .modifier = button->modifier
+        };
+        entry->actions[GESTURE_HOLD] = ext->hold;
+        entry->actions[GESTURE_DOUBLE_TAP] = ext->double_tap;
+        entry->ext = *ext;
+        memcpy(entry->label, button->label, sizeof(entry->label));
+        entry->label[sizeof(entry->label) - 1] = '\0';
+    }
+    num_entries = num_buttons;
+    
+    ESP_LOGI(TAG, "Button table compiled: %d button(s)", num_entries);
+}
+
+esp_err_t armdeck_button_table_init(void) {
+    reload_pending = false;
+    compile_table();
+    return ESP_OK;
+}
+
+void armdeck_button_table_reload(void) {
+    reload_pending = true;
+}
+
+const armdeck_button_entry_t* armdeck_button_table_get(uint8_t button_id) {
+    if (reload_pending) {
+        reload_pending = false;
+        compile_table();
+    }
+    
+    return button_id < num_entries ? &table[button_id] : NULL;
+}
+
+#ifdef ARMDECK_PRESS_BENCHMARK
+/* Lookups of the press path as they were before the table: protocol and config
+ * accessors with their bounds checks, then the action built from the tap or ext */
+static void legacy_lookup(uint8_t button_id, armdeck_gesture_t gesture, armdeck_action_def_t* action) {
+    const armdeck_button_t* button = armdeck_protocol_get_button_config(button_id);
+    const armdeck_button_ext_t* ext = armdeck_config_get_button_ext(button_id);
+    if (!button || !ext) {
+        return;
+    }
+    
+    *action = (armdeck_action_def_t){
+        .action_type = button->action_type,
+        .key_code = button->key_code,
+        .modifier = button->modifier
+    };
+    if (gesture == GESTURE_HOLD) {
+        *action = ext->hold;
+    } else if (gesture == GESTURE_DOUBLE_TAP) {
+        *action = ext->double_tap;
+    }
+}
+
+esp_err_t armdeck_button_table_benchmark(uint32_t lookups) {
+    if (lookups == 0 || num_entries == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    volatile uint8_t sink = 0;
+    armdeck_action_def_t action = {0};
+    
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (uint32_t i = 0; i < lookups; i++) {
+        legacy_lookup(i % num_entries, i % GESTURE_COUNT, &action);
+        sink += action.key_code;
+    }
+    uint32_t legacy_cycles = esp_cpu_get_cycle_count() - start;
+    
+    start = esp_cpu_get_cycle_count();
+    for (uint32_t i = 0; i < lookups; i++) {
+        const armdeck_button_entry_t* entry = armdeck_button_table_get(i % num_entries);
+        sink += entry->actions[i % GESTURE_COUNT].key_code;
+    }
+    uint32_t table_cycles = esp_cpu_get_cycle_count() - start;
+    
+    ESP_LOGI(TAG, "Benchmark lookup: config=%lu table=%lu cycles per press (n=%lu)",
+             legacy_cycles / lookups, table_cycles / lookups, lookups);
+    (void)sink;
+    return ESP_OK;
+}
+#endif
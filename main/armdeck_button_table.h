@@ -0,0 +1,31 @@
+#ifndef ARMDECK_BUTTON_TABLE_H
+#define ARMDECK_BUTTON_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "armdeck_protocol.h"
+#include "armdeck_gesture.h"
+
+/* Everything the press path needs about a button, compiled from the configuration */
+typedef struct {
+    armdeck_action_def_t actions[GESTURE_COUNT];    // Indexed by armdeck_gesture_t
+    armdeck_button_ext_t ext;                       // Gesture and repeat timings
+    char label[8];
+} armdeck_button_entry_t;
+
+/* Compile the table from the configuration (before armdeck_dispatch_init) */
+esp_err_t armdeck_button_table_init(void);
+
+/* Recompile after a button change (any task, applied at the next lookup) */
+void armdeck_button_table_reload(void);
+
+/* Entry of a button, NULL past the configured buttons (dispatch task) */
+const armdeck_button_entry_t* armdeck_button_table_get(uint8_t button_id);
+
+#ifdef ARMDECK_PRESS_BENCHMARK
+/* Compare the per-press configuration lookups with the compiled table */
+esp_err_t armdeck_button_table_benchmark(uint32_t lookups);
+#endif
+
+#endif /* ARMDECK_BUTTON_TABLE_H */
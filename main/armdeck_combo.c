@@ -0,0 +1,199 @@
+#include "armdeck_combo.h"
+#include "armdeck_config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char* TAG = "ARMDECK_COMBO";
+
+/* Combo table used by the engine (dispatch task), swapped only while nothing is in flight */
+static armdeck_combo_table_t table;
+static matrix_mask_t member_mask = 0;       // Buttons that belong to at least one combo
+static int64_t window_us = COMBO_DEFAULT_WINDOW_MS * 1000LL;
+static volatile bool reload_pending = false;
+
+/* Member presses waiting for the combo to resolve, in press order */
+static matrix_mask_t buffered_mask = 0;
+static uint8_t buffered_keys[MATRIX_MAX_KEYS];
+static uint8_t buffered_count = 0;
+static int64_t window_end_us = 0;
+
+/* Fired combos and the members whose release they own */
+static uint32_t active_combos = 0;          // Bit n = combo n down
+static matrix_mask_t swallow_mask = 0;
+
+static button_event_cb_t key_output = NULL;
+static armdeck_combo_cb_t combo_output = NULL;
+
+static void load_table(void) {
+    const armdeck_combo_table_t* stored = armdeck_config_get_combos();
+    memcpy(&table, stored, ARMDECK_COMBO_TABLE_SIZE(stored->num_combos));
+    
+    member_mask = 0;
+    for (int i = 0; i < table.num_combos; i++) {
+        member_mask |= table.combos[i].buttons;
+    }
+    window_us = (table.window_ms ? table.window_ms : COMBO_DEFAULT_WINDOW_MS) * 1000LL;
+    
+    ESP_LOGI(TAG, "%d combo(s) on %d button(s), window %lld ms",
+             table.num_combos, __builtin_popcountll(member_mask), window_us / 1000);
+}
+
+static void apply_pending_reload(void) {
+    if (reload_pending && buffered_mask == 0 && active_combos == 0) {
+        reload_pending = false;
+        load_table();
+    }
+}
+
+/* Combo made of exactly these buttons, -1 if none */
+static int find_exact(matrix_mask_t keys) {
+    for (int i = 0; i < table.num_combos; i++) {
+        if (table.combos[i].buttons == keys) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* True if a combo could still be completed from these buttons (strict = more buttons needed) */
+static bool has_superset(matrix_mask_t keys, bool strict) {
+    for (int i = 0; i < table.num_combos; i++) {
+        matrix_mask_t buttons = table.combos[i].buttons;
+        if ((buttons & keys) == keys && (!strict || buttons != keys)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void fire(int combo_id) {
+    active_combos |= 1UL << combo_id;
+    swallow_mask |= buffered_mask;
+    buffered_mask = 0;
+    buffered_count = 0;
+    
+    ESP_LOGD(TAG, "Combo %d fired", combo_id);
+    if (combo_output) {
+        combo_output(combo_id, &table.combos[combo_id].action, true);
+    }
+}
+
+/* No combo: the buffered presses go out as individual keys, in order */
+static void flush(void) {
+    for (int i = 0; i < buffered_count; i++) {
+        if (key_output) {
+            key_output(buffered_keys[i], true);
+        }
+    }
+    buffered_mask = 0;
+    buffered_count = 0;
+}
+
+/* Window over, a release or a foreign key: fire the exact combo if complete, else flush */
+static void resolve(void) {
+    int combo_id = find_exact(buffered_mask);
+    if (combo_id >= 0) {
+        fire(combo_id);
+    } else {
+        flush();
+    }
+}
+
+esp_err_t armdeck_combo_init(button_event_cb_t on_key, armdeck_combo_cb_t on_combo) {
+    key_output = on_key;
+    combo_output = on_combo;
+    buffered_mask = 0;
+    buffered_count = 0;
+    active_combos = 0;
+    swallow_mask = 0;
+    reload_pending = false;
+    load_table();
+    return ESP_OK;
+}
+
+void armdeck_combo_reload(void) {
+    reload_pending = true;
+}
+
+static void handle_member_press(uint8_t button_id, int64_t now_us) {
+    matrix_mask_t bit = MATRIX_KEY_BIT(button_id);
+    
+    /* The new key cannot join the buffered ones in any combo: settle those first */
+    if (buffered_mask && !has_superset(buffered_mask | bit, false)) {
+        resolve();
+    }
+    
+    if (buffered_mask == 0) {
+        window_end_us = now_us + window_us;
+    }
+    buffered_mask |= bit;
+    buffered_keys[buffered_count++] = button_id;
+    
+    /* Complete and no bigger combo to wait for: no need to sit out the window */
+    int combo_id = find_exact(buffered_mask);
+    if (combo_id >= 0 && !has_superset(buffered_mask, true)) {
+        fire(combo_id);
+    }
+}
+
+static void handle_release(uint8_t button_id) {
+    matrix_mask_t bit = MATRIX_KEY_BIT(button_id);
+    
+    /* Released before the combo resolved: settle it now, then handle the release */
+    if (buffered_mask & bit) {
+        resolve();
+    }
+    
+    if (swallow_mask & bit) {
+        swallow_mask &= ~bit;
+        
+        /* First member up releases the combo, the other members' releases are dropped */
+        for (uint32_t work = active_combos; work; work &= work - 1) {
+            int combo_id = __builtin_ctz(work);
+            if (table.combos[combo_id].buttons & bit) {
+                active_combos &= ~(1UL << combo_id);
+                if (combo_output) {
+                    combo_output(combo_id, &table.combos[combo_id].action, false);
+                }
+            }
+        }
+        return;
+    }
+    
+    if (key_output) {
+        key_output(button_id, false);
+    }
+}
+
+void armdeck_combo_handle_event(uint8_t button_id, bool pressed) {
+    if (button_id >= MATRIX_MAX_KEYS) {
+        return;
+    }
+    
+    apply_pending_reload();
+    matrix_mask_t bit = MATRIX_KEY_BIT(button_id);
+    
+    if (!pressed) {
+        handle_release(button_id);
+    } else if (member_mask & bit) {
+        handle_member_press(button_id, esp_timer_get_time());
+    } else {
+        /* Not in any combo: no buffering, only keep the order with pending member presses */
+        if (buffered_mask) {
+            resolve();
+        }
+        if (key_output) {
+            key_output(button_id, true);
+        }
+    }
+}
+
+int64_t armdeck_combo_poll(int64_t now_us) {
+    if (buffered_mask && now_us >= window_end_us) {
+        resolve();
+    }
+    apply_pending_reload();
+    
+    return buffered_mask ? window_end_us : 0;
+}
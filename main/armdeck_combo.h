@@ -0,0 +1,28 @@
+#ifndef ARMDECK_COMBO_H
+#define ARMDECK_COMBO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "button_matrix.h"
+#include "armdeck_protocol.h"
+
+/* Combo action output: a combo fired (pressed) or its first member was released */
+typedef void (*armdeck_combo_cb_t)(uint8_t combo_id, const armdeck_action_def_t* action, bool pressed);
+
+/* Load the combo table and set the outputs (before armdeck_dispatch_init).
+ * on_key receives every event that is not part of a combo. */
+esp_err_t armdeck_combo_init(button_event_cb_t on_key, armdeck_combo_cb_t on_combo);
+
+/* Feed a debounced key event (dispatch task). Buttons in no combo go straight
+ * to on_key, combo members are held until the combo resolves. */
+void armdeck_combo_handle_event(uint8_t button_id, bool pressed);
+
+/* Resolve an expired combo window (dispatch task). Returns the window end
+ * (esp_timer time) or 0 when nothing is buffered. */
+int64_t armdeck_combo_poll(int64_t now_us);
+
+/* Pick up a new combo table (any task, applied once no combo is in flight) */
+void armdeck_combo_reload(void);
+
+#endif /* ARMDECK_COMBO_H */
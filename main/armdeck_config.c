@@ -1,23 +1,131 @@
 #include "armdeck_config.h"
+#include "armdeck_debounce.h"
+#include "power_button.h"
+#include "driver/gpio.h"
+#include "soc/soc_caps.h"
+#include "sdkconfig.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
 #include <string.h>
+#include <stddef.h>
 
 static const char* TAG = "ARMDECK_CONFIG";
 
-/* Current configuration in memory */
+/* Pins a geometry may not claim: wired to the SPI flash, driving them crashes the chip.
+ * Strapping pins are accepted with a warning, a key held at reset can change the boot mode. */
+#if CONFIG_IDF_TARGET_ESP32
+#define GEOMETRY_FLASH_PINS         (0x3FULL << 6)      /* GPIO 6-11 */
+#define GEOMETRY_STRAPPING_PINS     ((1ULL << 0) | (1ULL << 2) | (1ULL << 5) | (1ULL << 12) | (1ULL << 15))
+#elif CONFIG_IDF_TARGET_ESP32S3
+#define GEOMETRY_FLASH_PINS         (0x7FULL << 26)     /* GPIO 26-32 */
+#define GEOMETRY_STRAPPING_PINS     ((1ULL << 0) | (1ULL << 3) | (1ULL << 45) | (1ULL << 46))
+#elif CONFIG_IDF_TARGET_ESP32C3
+#define GEOMETRY_FLASH_PINS         (0x3FULL << 12)     /* GPIO 12-17 */
+#define GEOMETRY_STRAPPING_PINS     ((1ULL << 2) | (1ULL << 8) | (1ULL << 9))
+#elif CONFIG_IDF_TARGET_ESP32C2
+#define GEOMETRY_FLASH_PINS         (0x3FULL << 12)     /* GPIO 12-17 */
+#define GEOMETRY_STRAPPING_PINS     ((1ULL << 8) | (1ULL << 9))
+#else
+#define GEOMETRY_FLASH_PINS         0ULL
+#define GEOMETRY_STRAPPING_PINS     0ULL
+#endif
+
+_Static_assert(SOC_GPIO_PIN_COUNT <= 64, "geometry pin masks are 64 bits");
+
+/* Current configuration in memory (num_buttons used entries) */
 static armdeck_config_t current_config;
 static bool config_initialized = false;
 
-/* Default button configuration */
-static const armdeck_button_t default_buttons[15] = {
+/* NVS read buffer, too large for the caller's stack */
+static armdeck_config_t load_buffer;
+
+/* Matrix geometry in use since boot */
+static armdeck_geometry_t current_geometry;
+static uint8_t num_buttons = 0;
+
+/* Default matrix geometry: 5x3 deck */
+static const armdeck_geometry_t default_geometry = {
+    .version = ARMDECK_GEOMETRY_VERSION,
+    .rows = 3,
+    .cols = 5,
+    .row_pins = {
+        GPIO_NUM_2,   // ROW1 - Buttons 1,2,3,4,5
+        GPIO_NUM_4,   // ROW2 - Buttons 6,7,8,9,10
+        GPIO_NUM_5    // ROW3 - Buttons 11,12,13,14,15
+    },
+    .col_pins = {
+        GPIO_NUM_18,  // COL1 - Buttons 1,6,11
+        GPIO_NUM_19,  // COL2 - Buttons 2,7,12
+        GPIO_NUM_21,  // COL3 - Buttons 3,8,13
+        GPIO_NUM_22,  // COL4 - Buttons 4,9,14
+        GPIO_NUM_23   // COL5 - Buttons 5,10,15
+    },
+};
+
+/* Extended button behaviour in memory (num_buttons used entries) */
+static armdeck_button_ext_t current_ext[ARMDECK_MAX_BUTTONS];
+
+/* Stored extended button behaviour: header then num_buttons entries */
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t num_buttons;
+    armdeck_button_ext_t ext[ARMDECK_MAX_BUTTONS];
+} button_ext_blob_t;
+
+#define BUTTON_EXT_BLOB_SIZE(n)     (offsetof(button_ext_blob_t, ext) + (n) * sizeof(armdeck_button_ext_t))
+
+/* NVS buffer for the extended button behaviour */
+static button_ext_blob_t ext_buffer;
+
+/* Combo table in memory, NVS read buffer */
+static armdeck_combo_table_t current_combos;
+static armdeck_combo_table_t combo_buffer;
+
+/* Macros in memory, by macro ID */
+static armdeck_macro_t current_macros[ARMDECK_MAX_MACROS];
+
+/* Stored macros: header then the non-empty macros back to back, each ARMDECK_MACRO_SIZE(length) */
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t num_macros;
+    uint8_t data[ARMDECK_MAX_MACROS * sizeof(armdeck_macro_t)];
+} macro_blob_t;
+
+/* NVS buffer for the macros */
+static macro_blob_t macro_buffer;
+
+/* Current device settings in memory */
+static armdeck_settings_t current_settings;
+
+/* Default device settings */
+static const armdeck_settings_t default_settings = {
+    .version = ARMDECK_SETTINGS_VERSION,
+    .scan_mode = 1,                                 // Interrupt wake
+    .debounce_algo = DEBOUNCE_DEFAULT_ALGO,
+    .debounce_press_ms = DEBOUNCE_DEFAULT_PRESS_MS,
+    .debounce_release_ms = DEBOUNCE_DEFAULT_RELEASE_MS,
+    .scan_rate_hz = SCAN_DEFAULT_RATE_HZ,
+    .keyboard_mode = KEYBOARD_MODE_6KRO,
+    .text_layout = TEXT_LAYOUT_US,
+    .keep_alive_s = KEEP_ALIVE_DEFAULT_S,
+};
+
+/* Change listeners */
+#define MAX_CONFIG_LISTENERS 4
+static armdeck_config_listener_t listeners[MAX_CONFIG_LISTENERS];
+static int num_listeners = 0;
+
+/* Default button configuration (buttons past the table default to ACTION_NONE) */
+static const armdeck_button_t default_buttons[] = {
     {0,  ACTION_MEDIA, 0xCD, 0, 0x4C, 0xAF, 0x50, 0, "Play"},    // Play/Pause - Green
     {1,  ACTION_MEDIA, 0xB5, 0, 0x21, 0x96, 0xF3, 0, "Next"},    // Next - Blue
-    {2,  ACTION_MEDIA, 0xB6, 0, 0x21, 0x96, 0xF3, 0, "Prev"},    // Previous - Blue    {3,  ACTION_MEDIA, 0x6F, 0, 0xFF, 0x98, 0x00, 0, "Brightn+"},    // Brightness Up - Orange
-    {4,  ACTION_MEDIA, 0x70, 0, 0xFF, 0x98, 0x00, 0, "Brightn-"},    // Brightness Down - Orange
+    {2,  ACTION_MEDIA, 0xB6, 0, 0x21, 0x96, 0xF3, 0, "Prev"},    // Previous - Blue
+    {3,  ACTION_MEDIA, 0x6F, 0, 0xFF, 0x98, 0x00, 0, "Bright+"}, // Brightness Up - Orange
+    {4,  ACTION_MEDIA, 0x70, 0, 0xFF, 0x98, 0x00, 0, "Bright-"}, // Brightness Down - Orange
     {5,  ACTION_MEDIA, 0xE2, 0, 0xF4, 0x43, 0x36, 0, "Mute"},    // Mute - Red
-    {6,  ACTION_MEDIA, 0xB7, 0, 0x9C, 0x27, 0xB0, 0, "Stop"},    // Stop - Purple    {7,  ACTION_KEY,   0x77, 0, 0x60, 0x7D, 0x8B, 0, "F16"},     // F16 - Blue Grey
+    {6,  ACTION_MEDIA, 0xB7, 0, 0x9C, 0x27, 0xB0, 0, "Stop"},    // Stop - Purple
+    {7,  ACTION_KEY,   0x77, 0, 0x60, 0x7D, 0x8B, 0, "F16"},     // F16 - Blue Grey
     {8,  ACTION_KEY,   0x78, 0, 0x60, 0x7D, 0x8B, 0, "F17"},     // F17
     {9,  ACTION_KEY,   0x71, 0, 0x60, 0x7D, 0x8B, 0, "F22"},     // F22
     {10, ACTION_KEY,   0x72, 0, 0x60, 0x7D, 0x8B, 0, "F23"},     // F23
@@ -27,16 +135,349 @@ static const armdeck_button_t default_buttons[15] = {
     {14, ACTION_KEY,   0x76, 0, 0x3F, 0x51, 0xB5, 0, "F15"},     // F15 - Indigo
 };
 
+static void notify_listeners(armdeck_config_change_t change) {
+    for (int i = 0; i < num_listeners; i++) {
+        listeners[i](change);
+    }
+}
+
+static void default_button(uint8_t button_id, armdeck_button_t* button) {
+    if (button_id < sizeof(default_buttons) / sizeof(default_buttons[0])) {
+        memcpy(button, &default_buttons[button_id], sizeof(armdeck_button_t));
+    } else {
+        memset(button, 0, sizeof(armdeck_button_t));
+        button->button_id = button_id;
+        button->action_type = ACTION_NONE;
+    }
+}
+
+static void load_default_config(void) {
+    memset(&current_config, 0, sizeof(current_config));
+    current_config.version = ARMDECK_PROTOCOL_VERSION;
+    current_config.num_buttons = num_buttons;
+    current_config.reserved = 0;
+    for (int i = 0; i < num_buttons; i++) {
+        default_button(i, &current_config.buttons[i]);
+    }
+}
+
+/* Plain buttons: no gestures, no auto-repeat */
+static void load_default_button_ext(void) {
+    memset(current_ext, 0, sizeof(current_ext));
+    for (int i = 0; i < ARMDECK_MAX_BUTTONS; i++) {
+        current_ext[i].button_id = i;
+    }
+}
+
+/* No combos */
+static void load_default_combos(void) {
+    memset(&current_combos, 0, sizeof(current_combos));
+    current_combos.version = ARMDECK_COMBO_VERSION;
+}
+
+/* No macros */
+static void load_default_macros(void) {
+    memset(current_macros, 0, sizeof(current_macros));
+    for (int i = 0; i < ARMDECK_MAX_MACROS; i++) {
+        current_macros[i].macro_id = i;
+    }
+}
+
+static void load_geometry(void) {
+    memcpy(&current_geometry, &default_geometry, sizeof(current_geometry));
+    
+    nvs_handle_t handle;
+    if (nvs_open(ARMDECK_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        armdeck_geometry_t stored;
+        size_t size = sizeof(stored);
+        esp_err_t ret = nvs_get_blob(handle, ARMDECK_NVS_KEY_GEOMETRY, &stored, &size);
+        nvs_close(handle);
+        
+        if (ret == ESP_OK && size == sizeof(stored) && armdeck_config_validate_geometry(&stored)) {
+            memcpy(&current_geometry, &stored, sizeof(current_geometry));
+        } else if (ret != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Stored geometry invalid or outdated, using default");
+        }
+    }
+    
+    num_buttons = current_geometry.rows * current_geometry.cols;
+    ESP_LOGI(TAG, "Matrix geometry: %d rows x %d cols (%d buttons)",
+             current_geometry.rows, current_geometry.cols, num_buttons);
+}
+
+/* Action type in range and, for ACTION_MEDIA, a usage the consumer report can carry */
+static bool validate_action(uint8_t action_type, uint8_t key_code, uint8_t modifier) {
+    if (action_type > ACTION_LAST) {
+        return false;
+    }
+    if (action_type == ACTION_MEDIA && ACTION_MEDIA_USAGE(key_code, modifier) > ACTION_MEDIA_MAX_USAGE) {
+        return false;
+    }
+    return true;
+}
+
+/* Check one button: the checks a stored configuration must pass at load */
+static bool validate_button(int i, const armdeck_button_t* btn) {
+    /* Check button ID */
+    if (btn->button_id != i) {
+        ESP_LOGW(TAG, "Button %d has wrong ID: %d", i, btn->button_id);
+        return false;
+    }
+    /* Check action type and media usage */
+    if (!validate_action(btn->action_type, btn->key_code, btn->modifier)) {
+        ESP_LOGW(TAG, "Button %d has invalid action: type %d, code 0x%02X, modifier 0x%02X",
+                 i, btn->action_type, btn->key_code, btn->modifier);
+        return false;
+    }
+    
+    /* Check label is null terminated */
+    if (memchr(btn->label, '\0', sizeof(btn->label)) == NULL) {
+        ESP_LOGW(TAG, "Button %d label not null terminated", i);
+        return false;
+    }
+    
+    return true;
+}
+
+/* Check the used buttons of a configuration */
+static bool validate_buttons(const armdeck_config_t* config, uint8_t count) {
+    for (int i = 0; i < count; i++) {
+        if (!validate_button(i, &config->buttons[i])) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+static esp_err_t save_settings(void) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(ARMDECK_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ret = nvs_set_blob(handle, ARMDECK_NVS_KEY_SETTINGS, &current_settings, sizeof(current_settings));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save settings: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static esp_err_t save_button_ext(void) {
+    ext_buffer.version = ARMDECK_BUTTON_EXT_VERSION;
+    ext_buffer.num_buttons = num_buttons;
+    memcpy(ext_buffer.ext, current_ext, num_buttons * sizeof(armdeck_button_ext_t));
+    
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(ARMDECK_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ret = nvs_set_blob(handle, ARMDECK_NVS_KEY_BUTTON_EXT, &ext_buffer, BUTTON_EXT_BLOB_SIZE(num_buttons));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save button gestures: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static void load_button_ext(void) {
+    load_default_button_ext();
+    
+    nvs_handle_t handle;
+    if (nvs_open(ARMDECK_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    
+    size_t size = sizeof(ext_buffer);
+    esp_err_t ret = nvs_get_blob(handle, ARMDECK_NVS_KEY_BUTTON_EXT, &ext_buffer, &size);
+    nvs_close(handle);
+    
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        return;
+    }
+    if (ret != ESP_OK || size < BUTTON_EXT_BLOB_SIZE(0) ||
+        ext_buffer.version != ARMDECK_BUTTON_EXT_VERSION ||
+        ext_buffer.num_buttons > ARMDECK_MAX_BUTTONS ||
+        size != BUTTON_EXT_BLOB_SIZE(ext_buffer.num_buttons)) {
+        ESP_LOGW(TAG, "Stored button gestures invalid or outdated, using defaults");
+        return;
+    }
+    
+    /* Keep the buttons both layouts have, an invalid entry falls back to a plain button */
+    uint8_t count = ext_buffer.num_buttons < num_buttons ? ext_buffer.num_buttons : num_buttons;
+    for (int i = 0; i < count; i++) {
+        if (ext_buffer.ext[i].button_id == i && armdeck_config_validate_button_ext(&ext_buffer.ext[i])) {
+            memcpy(&current_ext[i], &ext_buffer.ext[i], sizeof(armdeck_button_ext_t));
+        }
+    }
+}
+
+static esp_err_t save_combos(void) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(ARMDECK_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ret = nvs_set_blob(handle, ARMDECK_NVS_KEY_COMBOS, &current_combos,
+                       ARMDECK_COMBO_TABLE_SIZE(current_combos.num_combos));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save combos: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static void load_combos(void) {
+    load_default_combos();
+    
+    nvs_handle_t handle;
+    if (nvs_open(ARMDECK_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    
+    size_t size = sizeof(combo_buffer);
+    esp_err_t ret = nvs_get_blob(handle, ARMDECK_NVS_KEY_COMBOS, &combo_buffer, &size);
+    nvs_close(handle);
+    
+    if (ret == ESP_OK && size >= ARMDECK_COMBO_TABLE_SIZE(0) &&
+        size == ARMDECK_COMBO_TABLE_SIZE(combo_buffer.num_combos) &&
+        armdeck_config_validate_combos(&combo_buffer)) {
+        memcpy(&current_combos, &combo_buffer, size);
+        ESP_LOGI(TAG, "Combos loaded: %d", current_combos.num_combos);
+    } else if (ret != ESP_ERR_NVS_NOT_FOUND) {
+        /* Other layout version or members outside the current geometry */
+        ESP_LOGW(TAG, "Stored combos invalid or outdated, using none");
+    }
+}
+
+static esp_err_t save_macros(void) {
+    size_t size = offsetof(macro_blob_t, data);
+    macro_buffer.version = ARMDECK_MACRO_VERSION;
+    macro_buffer.num_macros = 0;
+    for (int i = 0; i < ARMDECK_MAX_MACROS; i++) {
+        if (current_macros[i].length > 0) {
+            size_t macro_size = ARMDECK_MACRO_SIZE(current_macros[i].length);
+            memcpy((uint8_t*)&macro_buffer + size, &current_macros[i], macro_size);
+            size += macro_size;
+            macro_buffer.num_macros++;
+        }
+    }
+    
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(ARMDECK_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ret = nvs_set_blob(handle, ARMDECK_NVS_KEY_MACROS, &macro_buffer, size);
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save macros: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static void load_macros(void) {
+    load_default_macros();
+    
+    nvs_handle_t handle;
+    if (nvs_open(ARMDECK_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    
+    size_t size = sizeof(macro_buffer);
+    esp_err_t ret = nvs_get_blob(handle, ARMDECK_NVS_KEY_MACROS, &macro_buffer, &size);
+    nvs_close(handle);
+    
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        return;
+    }
+    if (ret != ESP_OK || size < offsetof(macro_blob_t, data) || macro_buffer.version != ARMDECK_MACRO_VERSION) {
+        ESP_LOGW(TAG, "Stored macros invalid or outdated, using none");
+        return;
+    }
+    
+    /* Walk the packed macros, an invalid one ends the walk and is dropped with the rest */
+    size_t offset = offsetof(macro_blob_t, data);
+    int loaded = 0;
+    for (int i = 0; i < macro_buffer.num_macros; i++) {
+        const armdeck_macro_t* macro = (const armdeck_macro_t*)((const uint8_t*)&macro_buffer + offset);
+        if (offset + ARMDECK_MACRO_SIZE(0) > size || offset + ARMDECK_MACRO_SIZE(macro->length) > size ||
+            !armdeck_config_validate_macro(macro)) {
+            ESP_LOGW(TAG, "Stored macro %d invalid, dropping the remaining macros", i);
+            break;
+        }
+        memcpy(&current_macros[macro->macro_id], macro, ARMDECK_MACRO_SIZE(macro->length));
+        offset += ARMDECK_MACRO_SIZE(macro->length);
+        loaded++;
+    }
+    ESP_LOGI(TAG, "Macros loaded: %d", loaded);
+}
+
+static void load_settings(void) {
+    memcpy(&current_settings, &default_settings, sizeof(current_settings));
+    
+    nvs_handle_t handle;
+    if (nvs_open(ARMDECK_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+    
+    armdeck_settings_t stored;
+    size_t size = sizeof(stored);
+    esp_err_t ret = nvs_get_blob(handle, ARMDECK_NVS_KEY_SETTINGS, &stored, &size);
+    nvs_close(handle);
+    
+    if (ret == ESP_OK && size == sizeof(stored) && armdeck_config_validate_settings(&stored)) {
+        memcpy(&current_settings, &stored, sizeof(current_settings));
+        ESP_LOGI(TAG, "Settings loaded: scan_mode=%d, scan_rate=%d Hz, debounce=%d (%d/%d ms)",
+                 current_settings.scan_mode, current_settings.scan_rate_hz, current_settings.debounce_algo,
+                 current_settings.debounce_press_ms, current_settings.debounce_release_ms);
+    } else if (ret != ESP_ERR_NVS_NOT_FOUND) {
+        /* Stored settings from another layout version: start over with defaults */
+        ESP_LOGW(TAG, "Stored settings invalid or outdated, using defaults");
+    }
+}
+
 esp_err_t armdeck_config_init(void) {
     ESP_LOGI(TAG, "Initializing configuration system");
+    
+    /* Geometry first: it sizes the button configuration */
+    load_geometry();
       /* Initialize with defaults */
-    current_config.version = ARMDECK_PROTOCOL_VERSION;
-    current_config.num_buttons = 15;
-    current_config.reserved = 0;
-    memcpy(current_config.buttons, default_buttons, sizeof(default_buttons));
+    load_default_config();
     
     config_initialized = true;
     
+    load_settings();
+    load_button_ext();
+    load_combos();
+    load_macros();
+    
     /* Try to load from NVS */
     esp_err_t ret = armdeck_config_load();
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
@@ -60,29 +501,45 @@ esp_err_t armdeck_config_load(void) {
         return ret;
     }
     
-    size_t size = sizeof(armdeck_config_t);
-    ESP_LOGI(TAG, "Looking for blob of size %d bytes", size);
+    /* Read into a scratch buffer: a bad blob must not clobber the configuration in use */
+    size_t size = sizeof(load_buffer);
+    ESP_LOGI(TAG, "Looking for blob of up to %d bytes", size);
     
-    ret = nvs_get_blob(handle, ARMDECK_NVS_KEY_CONFIG, &current_config, &size);
+    ret = nvs_get_blob(handle, ARMDECK_NVS_KEY_CONFIG, &load_buffer, &size);
     
     nvs_close(handle);
     
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "Successfully read %d bytes from NVS", size);
+        
+        /* Validate loaded configuration */
+        if (size < ARMDECK_CONFIG_SIZE(0) ||
+            load_buffer.version != ARMDECK_PROTOCOL_VERSION ||
+            load_buffer.num_buttons > ARMDECK_MAX_BUTTONS ||
+            size != ARMDECK_CONFIG_SIZE(load_buffer.num_buttons) ||
+            !validate_buttons(&load_buffer, load_buffer.num_buttons)) {
+            ESP_LOGE(TAG, "Loaded configuration is invalid, keeping defaults");
+            return ESP_ERR_INVALID_STATE;
+        }
+        
         ESP_LOGI(TAG, "Loaded config version: %d, num_buttons: %d", 
-                 current_config.version, current_config.num_buttons);
+                 load_buffer.version, load_buffer.num_buttons);
+                 
+        /* Keep the buttons both layouts have, the others stay at their defaults */
+        uint8_t count = load_buffer.num_buttons < num_buttons ? load_buffer.num_buttons : num_buttons;
+        memcpy(current_config.buttons, load_buffer.buttons, count * sizeof(armdeck_button_t));
         
         // Log first few buttons for verification
-        for (int i = 0; i < 3 && i < 15; i++) {
+        for (int i = 0; i < 3 && i < count; i++) {
             ESP_LOGI(TAG, "Button %d: action_type=%d, key_code=0x%02X, label='%s'", 
                      i, current_config.buttons[i].action_type, 
                      current_config.buttons[i].key_code, current_config.buttons[i].label);
         }
         
-        /* Validate loaded configuration */
-        if (!armdeck_config_validate(&current_config)) {
-            ESP_LOGE(TAG, "Loaded configuration is invalid, keeping defaults");
-            return ESP_ERR_INVALID_STATE;
+        if (load_buffer.num_buttons != num_buttons) {
+            ESP_LOGW(TAG, "Stored configuration has %d buttons, geometry has %d: resized",
+                     load_buffer.num_buttons, num_buttons);
+            return armdeck_config_save();
         }
         ESP_LOGI(TAG, "Configuration loaded from NVS and validated successfully");
     } else if (ret == ESP_ERR_NVS_NOT_FOUND) {
@@ -105,7 +562,7 @@ esp_err_t armdeck_config_save(void) {
         return ret;
     }
     
-    ret = nvs_set_blob(handle, ARMDECK_NVS_KEY_CONFIG, &current_config, sizeof(current_config));
+    ret = nvs_set_blob(handle, ARMDECK_NVS_KEY_CONFIG, &current_config, ARMDECK_CONFIG_SIZE(current_config.num_buttons));
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to save configuration: %s", esp_err_to_name(ret));
         nvs_close(handle);
@@ -125,13 +582,23 @@ esp_err_t armdeck_config_save(void) {
 esp_err_t armdeck_config_reset(void) {
     ESP_LOGI(TAG, "Resetting configuration to factory defaults");
       /* Reset to defaults */
-    current_config.version = ARMDECK_PROTOCOL_VERSION;
-    current_config.num_buttons = 15;
-    current_config.reserved = 0;
-    memcpy(current_config.buttons, default_buttons, sizeof(default_buttons));
+    load_default_config();
+    load_default_button_ext();
+    load_default_combos();
+    load_default_macros();
     
     /* Save to NVS */
-    return armdeck_config_save();
+    esp_err_t ret = armdeck_config_save();
+    esp_err_t ext_ret = save_button_ext();
+    esp_err_t combo_ret = save_combos();
+    esp_err_t macro_ret = save_macros();
+    if (ret == ESP_OK) {
+        ret = ext_ret != ESP_OK ? ext_ret : combo_ret != ESP_OK ? combo_ret : macro_ret;
+    }
+    notify_listeners(ARMDECK_CONFIG_CHANGED_BUTTONS);
+    notify_listeners(ARMDECK_CONFIG_CHANGED_COMBOS);
+    notify_listeners(ARMDECK_CONFIG_CHANGED_MACROS);
+    return ret;
 }
 
 const armdeck_config_t* armdeck_config_get(void) {
@@ -150,24 +617,200 @@ esp_err_t armdeck_config_set(const armdeck_config_t* config) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    memcpy(&current_config, config, sizeof(current_config));
-    return armdeck_config_save();
+    memcpy(&current_config, config, ARMDECK_CONFIG_SIZE(config->num_buttons));
+    esp_err_t ret = armdeck_config_save();
+    notify_listeners(ARMDECK_CONFIG_CHANGED_BUTTONS);
+    return ret;
 }
 
 const armdeck_button_t* armdeck_config_get_button(uint8_t button_id) {
-    if (!config_initialized || button_id >= 15) {
+    if (!config_initialized || button_id >= num_buttons) {
         return NULL;
     }
     return &current_config.buttons[button_id];
 }
 
 esp_err_t armdeck_config_set_button(uint8_t button_id, const armdeck_button_t* button) {
-    if (!config_initialized || !button || button_id >= 15) {
+    if (!config_initialized || !button || button_id >= num_buttons || !validate_button(button_id, button)) {
         return ESP_ERR_INVALID_ARG;
     }
     
     memcpy(&current_config.buttons[button_id], button, sizeof(armdeck_button_t));
-    return armdeck_config_save();
+    esp_err_t ret = armdeck_config_save();
+    notify_listeners(ARMDECK_CONFIG_CHANGED_BUTTONS);
+    return ret;
+}
+
+const armdeck_button_ext_t* armdeck_config_get_button_ext(uint8_t button_id) {
+    if (!config_initialized || button_id >= num_buttons) {
+        return NULL;
+    }
+    return &current_ext[button_id];
+}
+
+esp_err_t armdeck_config_set_button_ext(uint8_t button_id, const armdeck_button_ext_t* ext) {
+    if (!config_initialized || !ext || button_id >= num_buttons || ext->button_id != button_id ||
+        !armdeck_config_validate_button_ext(ext)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    memcpy(&current_ext[button_id], ext, sizeof(armdeck_button_ext_t));
+    esp_err_t ret = save_button_ext();
+    notify_listeners(ARMDECK_CONFIG_CHANGED_BUTTONS);
+    return ret;
+}
+
+bool armdeck_config_validate_button_ext(const armdeck_button_ext_t* ext) {
+    if (!ext) {
+        return false;
+    }
+    
+    if (ext->gesture_flags & ~GESTURE_FLAGS_ALL) {
+        ESP_LOGW(TAG, "Button %d has invalid gesture flags: 0x%02X", ext->button_id, ext->gesture_flags);
+        return false;
+    }
+    if (ext->hold_ms > GESTURE_MAX_MS || ext->double_tap_ms > GESTURE_MAX_MS) {
+        ESP_LOGW(TAG, "Button %d gesture timings out of range: hold=%d ms, double tap=%d ms",
+                 ext->button_id, ext->hold_ms, ext->double_tap_ms);
+        return false;
+    }
+    if (!validate_action(ext->hold.action_type, ext->hold.key_code, ext->hold.modifier) ||
+        !validate_action(ext->double_tap.action_type, ext->double_tap.key_code, ext->double_tap.modifier)) {
+        ESP_LOGW(TAG, "Button %d has invalid gesture action", ext->button_id);
+        return false;
+    }
+    if (ext->repeat_delay_ms > REPEAT_MAX_MS || ext->repeat_interval_ms > REPEAT_MAX_MS ||
+        (ext->repeat_interval_ms != 0 && ext->repeat_interval_ms < REPEAT_MIN_INTERVAL_MS)) {
+        ESP_LOGW(TAG, "Button %d repeat timings out of range: delay=%d ms, interval=%d ms",
+                 ext->button_id, ext->repeat_delay_ms, ext->repeat_interval_ms);
+        return false;
+    }
+    
+    return true;
+}
+
+const armdeck_combo_table_t* armdeck_config_get_combos(void) {
+    return &current_combos;
+}
+
+esp_err_t armdeck_config_set_combos(const armdeck_combo_table_t* table) {
+    if (!table || !armdeck_config_validate_combos(table)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    memcpy(&current_combos, table, ARMDECK_COMBO_TABLE_SIZE(table->num_combos));
+    esp_err_t ret = save_combos();
+    notify_listeners(ARMDECK_CONFIG_CHANGED_COMBOS);
+    return ret;
+}
+
+bool armdeck_config_validate_combos(const armdeck_combo_table_t* table) {
+    if (!table) {
+        return false;
+    }
+    
+    if (table->version != ARMDECK_COMBO_VERSION) {
+        ESP_LOGW(TAG, "Combo version mismatch: %d != %d", table->version, ARMDECK_COMBO_VERSION);
+        return false;
+    }
+    if (table->num_combos > ARMDECK_MAX_COMBOS || table->window_ms > COMBO_MAX_WINDOW_MS) {
+        ESP_LOGW(TAG, "Invalid combo table: %d combos, window %d ms", table->num_combos, table->window_ms);
+        return false;
+    }
+    
+    uint64_t valid_buttons = num_buttons >= 64 ? UINT64_MAX : (1ULL << num_buttons) - 1;
+    for (int i = 0; i < table->num_combos; i++) {
+        const armdeck_combo_t* combo = &table->combos[i];
+        
+        /* At least two members, all of them on the matrix */
+        if (__builtin_popcountll(combo->buttons) < 2 || (combo->buttons & ~valid_buttons)) {
+            ESP_LOGW(TAG, "Combo %d has invalid buttons: 0x%llx", i, combo->buttons);
+            return false;
+        }
+        if (!validate_action(combo->action.action_type, combo->action.key_code, combo->action.modifier)) {
+            ESP_LOGW(TAG, "Combo %d has invalid action: type %d, code 0x%02X, modifier 0x%02X", i,
+                     combo->action.action_type, combo->action.key_code, combo->action.modifier);
+            return false;
+        }
+        for (int j = 0; j < i; j++) {
+            if (table->combos[j].buttons == combo->buttons) {
+                ESP_LOGW(TAG, "Combos %d and %d use the same buttons", j, i);
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
+const armdeck_macro_t* armdeck_config_get_macro(uint8_t macro_id) {
+    if (macro_id >= ARMDECK_MAX_MACROS) {
+        return NULL;
+    }
+    return &current_macros[macro_id];
+}
+
+esp_err_t armdeck_config_set_macro(const armdeck_macro_t* macro) {
+    if (!macro || !armdeck_config_validate_macro(macro)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    memset(&current_macros[macro->macro_id], 0, sizeof(armdeck_macro_t));
+    memcpy(&current_macros[macro->macro_id], macro, ARMDECK_MACRO_SIZE(macro->length));
+    esp_err_t ret = save_macros();
+    notify_listeners(ARMDECK_CONFIG_CHANGED_MACROS);
+    return ret;
+}
+
+/* Operand bytes of each opcode, -1 = invalid opcode */
+static int macro_operand_len(uint8_t op) {
+    switch (op) {
+        case MACRO_OP_END:      return 0;
+        case MACRO_OP_PRESS:
+        case MACRO_OP_RELEASE:
+        case MACRO_OP_TAP:
+        case MACRO_OP_DELAY:
+        case MACRO_OP_CONSUMER: return 2;
+        case MACRO_OP_REPEAT:   return 1;
+        case MACRO_OP_TEXT:     return 1;   // Length byte, the text follows
+        default:                return -1;
+    }
+}
+
+bool armdeck_config_validate_macro(const armdeck_macro_t* macro) {
+    if (!macro) {
+        return false;
+    }
+    
+    if (macro->macro_id >= ARMDECK_MAX_MACROS || macro->length > ARMDECK_MACRO_MAX_LEN) {
+        ESP_LOGW(TAG, "Invalid macro %d: %d bytes", macro->macro_id, macro->length);
+        return false;
+    }
+    
+    /* Every step complete, so the player never reads past the bytecode */
+    for (int pc = 0; pc < macro->length; ) {
+        int operands = macro_operand_len(macro->code[pc]);
+        if (macro->code[pc] == MACRO_OP_TEXT && pc + 1 < macro->length) {
+            operands += macro->code[pc + 1];
+        }
+        if (operands < 0 || pc + 1 + operands > macro->length) {
+            ESP_LOGW(TAG, "Macro %d: invalid step 0x%02X at %d", macro->macro_id, macro->code[pc], pc);
+            return false;
+        }
+        if (macro->code[pc] == MACRO_OP_DELAY &&
+            (macro->code[pc + 1] | (macro->code[pc + 2] << 8)) > MACRO_MAX_DELAY_MS) {
+            ESP_LOGW(TAG, "Macro %d: delay over %d ms at %d", macro->macro_id, MACRO_MAX_DELAY_MS, pc);
+            return false;
+        }
+        if (macro->code[pc] == MACRO_OP_CONSUMER &&
+            !validate_action(ACTION_MEDIA, macro->code[pc + 1], macro->code[pc + 2])) {
+            ESP_LOGW(TAG, "Macro %d: consumer usage over 0x%03X at %d", macro->macro_id, ACTION_MEDIA_MAX_USAGE, pc);
+            return false;
+        }
+        pc += 1 + operands;
+    }
+    
+    return true;
 }
 
 bool armdeck_config_validate(const armdeck_config_t* config) {
@@ -181,39 +824,177 @@ bool armdeck_config_validate(const armdeck_config_t* config) {
         return false;
     }
       /* Check number of buttons */
-    if (config->num_buttons != 15) {
-        ESP_LOGW(TAG, "Invalid number of buttons: %d", config->num_buttons);
+    if (config->num_buttons != num_buttons) {
+        ESP_LOGW(TAG, "Invalid number of buttons: %d (geometry has %d)", config->num_buttons, num_buttons);
         return false;
     }
     
     /* Validate each button */
-    for (int i = 0; i < 15; i++) {
-        const armdeck_button_t* btn = &config->buttons[i];
+    return validate_buttons(config, config->num_buttons);
+}
+
+uint8_t armdeck_config_get_num_buttons(void) {
+    return num_buttons;
+}
+
+const armdeck_geometry_t* armdeck_config_get_geometry(void) {
+    return &current_geometry;
+}
+
+esp_err_t armdeck_config_set_geometry(const armdeck_geometry_t* geometry) {
+    if (!geometry || !armdeck_config_validate_geometry(geometry)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(ARMDECK_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ret = nvs_set_blob(handle, ARMDECK_NVS_KEY_GEOMETRY, geometry, sizeof(armdeck_geometry_t));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save geometry: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    /* Pins are claimed at boot: the new geometry takes effect after a restart */
+    ESP_LOGI(TAG, "Geometry %d rows x %d cols saved, applied after restart", geometry->rows, geometry->cols);
+    return ESP_OK;
+}
+
+bool armdeck_config_validate_geometry(const armdeck_geometry_t* geometry) {
+    if (!geometry) {
+        return false;
+    }
+    
+    if (geometry->version != ARMDECK_GEOMETRY_VERSION) {
+        ESP_LOGW(TAG, "Geometry version mismatch: %d != %d", geometry->version, ARMDECK_GEOMETRY_VERSION);
+        return false;
+    }
+    
+    if (geometry->rows == 0 || geometry->rows > ARMDECK_MAX_ROWS ||
+        geometry->cols == 0 || geometry->cols > ARMDECK_MAX_COLS ||
+        geometry->rows * geometry->cols > ARMDECK_MAX_BUTTONS) {
+        ESP_LOGW(TAG, "Invalid geometry: %d rows x %d cols", geometry->rows, geometry->cols);
+        return false;
+    }
+    
+    /* Every used pin must exist, rows must be able to drive, columns need the internal
+     * pull-up the scan relies on (input-only pins have none), and no pin may be used twice.
+     * The pins come from the host: bound them before any shift or GPIO macro. */
+    uint64_t used = 1ULL << POWER_SWITCH_GPIO;
+    for (int i = 0; i < geometry->rows + geometry->cols; i++) {
+        bool is_row = i < geometry->rows;
+        uint8_t pin = is_row ? geometry->row_pins[i] : geometry->col_pins[i - geometry->rows];
         
-        /* Check button ID */
-        if (btn->button_id != i) {
-            ESP_LOGW(TAG, "Button %d has wrong ID: %d", i, btn->button_id);
+        if (pin >= SOC_GPIO_PIN_COUNT) {
+            ESP_LOGW(TAG, "Invalid %s GPIO: %d", is_row ? "row" : "column", pin);
             return false;
         }
-          /* Check action type */
-        if (btn->action_type < ACTION_NONE || btn->action_type > ACTION_CUSTOM) {
-            ESP_LOGW(TAG, "Button %d has invalid action type: %d", i, btn->action_type);
+        if (GEOMETRY_FLASH_PINS & (1ULL << pin)) {
+            ESP_LOGW(TAG, "GPIO %d is wired to the SPI flash", pin);
             return false;
         }
-        
-        /* Check label is null terminated */
-        bool null_found = false;
-        for (int j = 0; j < 8; j++) {
-            if (btn->label[j] == '\0') {
-                null_found = true;
-                break;
+        if (GEOMETRY_STRAPPING_PINS & (1ULL << pin)) {
+            ESP_LOGW(TAG, "GPIO %d is a strapping pin: a %s held at reset may change the boot mode",
+                     pin, is_row ? "row" : "column");
+        }
+        if (!GPIO_IS_VALID_GPIO(pin)) {
+            ESP_LOGW(TAG, "Invalid %s GPIO: %d", is_row ? "row" : "column", pin);
+            return false;
+        }
+        if (!GPIO_IS_VALID_OUTPUT_GPIO(pin)) {
+            if (is_row) {
+                ESP_LOGW(TAG, "Row GPIO %d is input-only", pin);
+            } else {
+                ESP_LOGW(TAG, "Column GPIO %d has no internal pull-up", pin);
             }
+            return false;
         }
-        if (!null_found) {
-            ESP_LOGW(TAG, "Button %d label not null terminated", i);
+        if (used & (1ULL << pin)) {
+            ESP_LOGW(TAG, "GPIO %d used twice", pin);
             return false;
         }
+        used |= 1ULL << pin;
     }
     
     return true;
+}
+
+const armdeck_settings_t* armdeck_config_get_settings(void) {
+    return &current_settings;
+}
+
+esp_err_t armdeck_config_set_settings(const armdeck_settings_t* settings) {
+    if (!settings || !armdeck_config_validate_settings(settings)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    memcpy(&current_settings, settings, sizeof(current_settings));
+    esp_err_t ret = save_settings();
+    notify_listeners(ARMDECK_CONFIG_CHANGED_SETTINGS);
+    return ret;
+}
+
+bool armdeck_config_validate_settings(const armdeck_settings_t* settings) {
+    if (!settings) {
+        return false;
+    }
+    
+    if (settings->version != ARMDECK_SETTINGS_VERSION) {
+        ESP_LOGW(TAG, "Settings version mismatch: %d != %d", settings->version, ARMDECK_SETTINGS_VERSION);
+        return false;
+    }
+    
+    /* 0 = polling, 1 = interrupt */
+    if (settings->scan_mode > 1) {
+        ESP_LOGW(TAG, "Invalid scan mode: %d", settings->scan_mode);
+        return false;
+    }
+    
+    /* 0 keeps the firmware default (settings stored before the field existed) */
+    if (settings->scan_rate_hz != 0 &&
+        (settings->scan_rate_hz < SCAN_MIN_RATE_HZ || settings->scan_rate_hz > SCAN_MAX_RATE_HZ)) {
+        ESP_LOGW(TAG, "Invalid scan rate: %d Hz", settings->scan_rate_hz);
+        return false;
+    }
+    
+    if (settings->keyboard_mode > KEYBOARD_MODE_NKRO) {
+        ESP_LOGW(TAG, "Invalid keyboard mode: %d", settings->keyboard_mode);
+        return false;
+    }
+    
+    if (settings->text_layout >= TEXT_LAYOUT_COUNT) {
+        ESP_LOGW(TAG, "Invalid text layout: %d", settings->text_layout);
+        return false;
+    }
+    
+    debounce_config_t debounce = {
+        .algo = settings->debounce_algo,
+        .press_ms = settings->debounce_press_ms,
+        .release_ms = settings->debounce_release_ms
+    };
+    if (!debounce_config_valid(&debounce)) {
+        ESP_LOGW(TAG, "Invalid debounce settings: algo=%d, %d/%d ms", settings->debounce_algo,
+                 settings->debounce_press_ms, settings->debounce_release_ms);
+        return false;
+    }
+    
+    return true;
+}
+
+esp_err_t armdeck_config_register_listener(armdeck_config_listener_t listener) {
+    if (!listener || num_listeners >= MAX_CONFIG_LISTENERS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    listeners[num_listeners++] = listener;
+    return ESP_OK;
 }
\ No newline at end of file
@@ -12,6 +12,22 @@
 #define ARMDECK_NVS_NAMESPACE       "armdeck"
 #define ARMDECK_NVS_KEY_CONFIG      "config"
 #define ARMDECK_NVS_KEY_VERSION     "version"
+#define ARMDECK_NVS_KEY_SETTINGS    "settings"
+#define ARMDECK_NVS_KEY_GEOMETRY    "geometry"
+#define ARMDECK_NVS_KEY_BUTTON_EXT  "button_ext"
+#define ARMDECK_NVS_KEY_COMBOS      "combos"
+#define ARMDECK_NVS_KEY_MACROS      "macros"
+
+/* What changed, passed to configuration listeners */
+typedef enum {
+    ARMDECK_CONFIG_CHANGED_BUTTONS,
+    ARMDECK_CONFIG_CHANGED_SETTINGS,
+    ARMDECK_CONFIG_CHANGED_COMBOS,
+    ARMDECK_CONFIG_CHANGED_MACROS,
+} armdeck_config_change_t;
+
+/* Configuration change listener */
+typedef void (*armdeck_config_listener_t)(armdeck_config_change_t change);
 
 /* Initialize configuration system */
 esp_err_t armdeck_config_init(void);
@@ -37,7 +53,58 @@ const armdeck_button_t* armdeck_config_get_button(uint8_t button_id);
 /* Set single button configuration */
 esp_err_t armdeck_config_set_button(uint8_t button_id, const armdeck_button_t* button);
 
+/* Get single button gestures */
+const armdeck_button_ext_t* armdeck_config_get_button_ext(uint8_t button_id);
+
+/* Set single button gestures (validated and saved to NVS) */
+esp_err_t armdeck_config_set_button_ext(uint8_t button_id, const armdeck_button_ext_t* ext);
+
+/* Validate single button gestures */
+bool armdeck_config_validate_button_ext(const armdeck_button_ext_t* ext);
+
+/* Get combo table */
+const armdeck_combo_table_t* armdeck_config_get_combos(void);
+
+/* Set combo table (validated and saved to NVS) */
+esp_err_t armdeck_config_set_combos(const armdeck_combo_table_t* table);
+
+/* Validate combo table */
+bool armdeck_config_validate_combos(const armdeck_combo_table_t* table);
+
+/* Get one macro (empty macros have length 0) */
+const armdeck_macro_t* armdeck_config_get_macro(uint8_t macro_id);
+
+/* Set one macro (validated and saved to NVS) */
+esp_err_t armdeck_config_set_macro(const armdeck_macro_t* macro);
+
+/* Validate one macro and its bytecode */
+bool armdeck_config_validate_macro(const armdeck_macro_t* macro);
+
 /* Validate configuration */
 bool armdeck_config_validate(const armdeck_config_t* config);
 
+/* Get number of buttons (from the matrix geometry) */
+uint8_t armdeck_config_get_num_buttons(void);
+
+/* Get matrix geometry in use */
+const armdeck_geometry_t* armdeck_config_get_geometry(void);
+
+/* Set matrix geometry (validated and saved to NVS, applied after restart) */
+esp_err_t armdeck_config_set_geometry(const armdeck_geometry_t* geometry);
+
+/* Validate matrix geometry */
+bool armdeck_config_validate_geometry(const armdeck_geometry_t* geometry);
+
+/* Get device settings */
+const armdeck_settings_t* armdeck_config_get_settings(void);
+
+/* Set device settings (validated and saved to NVS) */
+esp_err_t armdeck_config_set_settings(const armdeck_settings_t* settings);
+
+/* Validate device settings */
+bool armdeck_config_validate_settings(const armdeck_settings_t* settings);
+
+/* Register a listener called after the configuration or settings change */
+esp_err_t armdeck_config_register_listener(armdeck_config_listener_t listener);
+
 #endif /* ARMDECK_CONFIG_H */
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "armdeck_debounce.h"
+#include <stddef.h>
+
+/* Symmetric defer: the raw input must be stable for press_ms / release_ms */
+static bool defer_update(debounce_key_t* key, bool raw, uint32_t now_ms, const debounce_config_t* cfg) {
+    if (raw != key->raw) {
+        key->raw = raw;
+        key->since_ms = now_ms;
+        return false;
+    }
+    
+    if (raw == key->state) {
+        return false;
+    }
+    
+    uint32_t hold_ms = raw ? cfg->press_ms : cfg->release_ms;
+    if ((now_ms - key->since_ms) >= hold_ms) {
+        key->state = raw;
+        return true;
+    }
+    return false;
+}
+
+/* Eager press: the first edge goes out, bounce is masked by a lockout.
+ * Release is still deferred so release chatter never produces ghost presses. */
+static bool eager_update(debounce_key_t* key, bool raw, uint32_t now_ms, const debounce_config_t* cfg) {
+    if (raw != key->raw) {
+        key->raw = raw;
+        key->since_ms = now_ms;
+    }
+    
+    /* Ignore everything during the post-press lockout */
+    if ((int32_t)(now_ms - key->lock_until_ms) < 0) {
+        return false;
+    }
+    
+    if (raw == key->state) {
+        return false;
+    }
+    
+    if (raw) {
+        key->state = true;
+        key->lock_until_ms = now_ms + cfg->press_ms;
+        return true;
+    }
+    
+    if ((now_ms - key->since_ms) >= cfg->release_ms) {
+        key->state = false;
+        return true;
+    }
+    return false;
+}
+
+/* Integrator: level moves towards the raw input by the elapsed time.
+ * Released keys flip at press_ms, pressed keys flip back once the level drains to 0. */
+static bool integrator_update(debounce_key_t* key, bool raw, uint32_t now_ms, const debounce_config_t* cfg) {
+    uint32_t dt = now_ms - key->since_ms;
+    key->since_ms = now_ms;
+    key->raw = raw;
+    
+    if (dt > UINT16_MAX) {
+        dt = UINT16_MAX;
+    }
+    
+    if (!key->state) {
+        uint32_t level = raw ? key->level_ms + dt : (key->level_ms > dt ? key->level_ms - dt : 0);
+        if (raw && level >= cfg->press_ms) {
+            key->state = true;
+            key->level_ms = cfg->release_ms;
+            return true;
+        }
+        key->level_ms = level;
+    } else {
+        uint32_t level = raw ? key->level_ms + dt : (key->level_ms > dt ? key->level_ms - dt : 0);
+        if (level > cfg->release_ms) {
+            level = cfg->release_ms;
+        }
+        if (level == 0) {
+            key->state = false;
+            return true;
+        }
+        key->level_ms = level;
+    }
+    return false;
+}
+
+static const debounce_strategy_t strategies[DEBOUNCE_ALGO_COUNT] = {
+    [DEBOUNCE_DEFER]      = { "defer",      defer_update },
+    [DEBOUNCE_EAGER]      = { "eager",      eager_update },
+    [DEBOUNCE_INTEGRATOR] = { "integrator", integrator_update },
+};
+
+const debounce_strategy_t* debounce_get_strategy(uint8_t algo) {
+    if (algo >= DEBOUNCE_ALGO_COUNT) {
+        algo = DEBOUNCE_DEFER;
+    }
+    return &strategies[algo];
+}
+
+void debounce_key_reset(debounce_key_t* key, uint32_t now_ms) {
+    key->state = false;
+    key->raw = false;
+    key->since_ms = now_ms;
+    key->lock_until_ms = now_ms;
+    key->level_ms = 0;
+}
+
+void debounce_key_resume(debounce_key_t* key, uint32_t now_ms) {
+    /* Idle keys are not sampled: without this the integrator would count the whole idle gap */
+    key->since_ms = now_ms;
+}
+
+bool debounce_key_busy(const debounce_key_t* key, uint32_t now_ms) {
+    return key->raw != key->state ||
+           (int32_t)(now_ms - key->lock_until_ms) < 0 ||
+           (!key->state && key->level_ms > 0);
+}
+
+bool debounce_config_valid(const debounce_config_t* cfg) {
+    if (!cfg || cfg->algo >= DEBOUNCE_ALGO_COUNT) {
+        return false;
+    }
+    
+    /* Integrator needs a non-zero release threshold to ever report a press */
+    if (cfg->algo == DEBOUNCE_INTEGRATOR && cfg->release_ms == 0) {
+        return false;
+    }
+    return true;
+}
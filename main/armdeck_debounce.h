@@ -0,0 +1,62 @@
+#ifndef ARMDECK_DEBOUNCE_H
+#define ARMDECK_DEBOUNCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Debounce algorithms */
+typedef enum {
+    DEBOUNCE_DEFER = 0,         // Symmetric defer: report once input is stable (legacy behaviour)
+    DEBOUNCE_EAGER,             // Eager press on first edge, deferred release
+    DEBOUNCE_INTEGRATOR,        // Per-key integrator with press/release thresholds
+    DEBOUNCE_ALGO_COUNT
+} debounce_algo_t;
+
+/* Default timings */
+#define DEBOUNCE_DEFAULT_ALGO       DEBOUNCE_EAGER
+#define DEBOUNCE_DEFAULT_PRESS_MS   10
+#define DEBOUNCE_DEFAULT_RELEASE_MS 20
+
+/* Debounce configuration
+ * - DEFER:      press_ms / release_ms of stable input before reporting
+ * - EAGER:      press reported immediately, input ignored for press_ms,
+ *               release reported after release_ms of stable input
+ * - INTEGRATOR: press_ms / release_ms of net integrated input to flip */
+typedef struct {
+    uint8_t algo;
+    uint8_t press_ms;
+    uint8_t release_ms;
+} debounce_config_t;
+
+/* Per-key debounce state */
+typedef struct {
+    bool state;             // Debounced state (true = pressed)
+    bool raw;               // Last raw sample
+    uint32_t since_ms;      // Last raw change (DEFER/EAGER) or last sample (INTEGRATOR)
+    uint32_t lock_until_ms; // EAGER: end of post-press lockout
+    uint16_t level_ms;      // INTEGRATOR: integrated input
+} debounce_key_t;
+
+/* Debounce strategy */
+typedef struct {
+    const char* name;
+    /* Feed one raw sample, returns true when the debounced state changed */
+    bool (*update)(debounce_key_t* key, bool raw, uint32_t now_ms, const debounce_config_t* cfg);
+} debounce_strategy_t;
+
+/* Get strategy for an algorithm (falls back to DEFER for unknown values) */
+const debounce_strategy_t* debounce_get_strategy(uint8_t algo);
+
+/* Reset a key to released */
+void debounce_key_reset(debounce_key_t* key, uint32_t now_ms);
+
+/* Restart the sample clock of a key that was left unsampled while idle */
+void debounce_key_resume(debounce_key_t* key, uint32_t now_ms);
+
+/* True while the key is bouncing or in a lockout window */
+bool debounce_key_busy(const debounce_key_t* key, uint32_t now_ms);
+
+/* Validate a debounce configuration */
+bool debounce_config_valid(const debounce_config_t* cfg);
+
+#endif /* ARMDECK_DEBOUNCE_H */
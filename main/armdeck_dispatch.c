@@ -0,0 +1,195 @@
+#include "armdeck_dispatch.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char* TAG = "ARMDECK_DISPATCH";
+
+/* Scanner -> dispatch task ring */
+static armdeck_event_ring_t ring;
+
+/* Dispatch task */
+static TaskHandle_t dispatch_task_handle = NULL;
+static button_event_cb_t event_handler = NULL;
+static dispatch_poll_cb_t poll_handler = NULL;
+static esp_timer_handle_t deadline_timer = NULL;    // Wakes the task at the poll deadline
+
+/* Keys as last handed to the handler, to resync after an overflow */
+static matrix_mask_t dispatched_mask = 0;
+static uint32_t seen_overflows = 0;
+
+/* Statistics (written by the dispatch task only) */
+static uint32_t dispatched = 0;
+static uint32_t resyncs = 0;
+static uint32_t max_queue_us = 0;
+static uint64_t total_queue_us = 0;
+
+static void dispatch_event(uint8_t button_id, bool pressed) {
+    /* Already in that state: an event at the edge of a resync snapshot, already replayed */
+    if (((dispatched_mask & MATRIX_KEY_BIT(button_id)) != 0) == pressed) {
+        return;
+    }
+    
+    if (pressed) {
+        dispatched_mask |= MATRIX_KEY_BIT(button_id);
+    } else {
+        dispatched_mask &= ~MATRIX_KEY_BIT(button_id);
+    }
+    
+    dispatched++;
+    if (event_handler) {
+        event_handler(button_id, pressed);
+    }
+}
+
+/* Events were dropped: bring the handler back in line with the debounced matrix state.
+ * Returns the snapshot time, events queued before it are part of the snapshot. */
+static int64_t resync_after_overflow(void) {
+    int64_t snapshot_us = esp_timer_get_time();
+    matrix_mask_t diff = armdeck_matrix_get_pressed_mask() ^ dispatched_mask;
+    
+    ESP_LOGW(TAG, "Event ring overflowed, resyncing %d key(s)", __builtin_popcountll(diff));
+    
+    /* Releases first so no stale key stays down */
+    for (matrix_mask_t work = diff & dispatched_mask; work; work &= work - 1) {
+        resyncs++;
+        dispatch_event(__builtin_ctzll(work), false);
+    }
+    for (matrix_mask_t work = diff & ~dispatched_mask; work; work &= work - 1) {
+        resyncs++;
+        dispatch_event(__builtin_ctzll(work), true);
+    }
+    return snapshot_us;
+}
+
+static void deadline_timer_callback(void* arg) {
+    xTaskNotifyGive(dispatch_task_handle);
+}
+
+/* Wake at deadline_us (0 = none) to the microsecond, not rounded up to a FreeRTOS tick */
+static void arm_deadline(int64_t deadline_us) {
+    esp_timer_stop(deadline_timer);
+    if (deadline_us == 0) {
+        return;
+    }
+    
+    int64_t remaining_us = deadline_us - esp_timer_get_time();
+    if (remaining_us <= 0) {
+        xTaskNotifyGive(dispatch_task_handle);
+    } else {
+        esp_timer_start_once(deadline_timer, remaining_us);
+    }
+}
+
+static void dispatch_task(void* pvParameters) {
+    ESP_LOGI(TAG, "Dispatch task started");
+    
+    while (1) {
+        /* Sleep until the next event or the deadline timer */
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        /* Resync before draining: the snapshot must not be older than the events replayed after it */
+        int64_t snapshot_us = INT64_MIN;
+        armdeck_event_ring_stats_t stats;
+        armdeck_event_ring_get_stats(&ring, &stats);
+        if (stats.overflows != seen_overflows) {
+            seen_overflows = stats.overflows;
+            snapshot_us = resync_after_overflow();
+        }
+        
+        armdeck_key_event_t event;
+        while (armdeck_event_ring_pop(&ring, &event)) {
+            if (event.timestamp_us < snapshot_us) {
+                continue;
+            }
+            
+            uint32_t queue_us = (uint32_t)(esp_timer_get_time() - event.timestamp_us);
+            total_queue_us += queue_us;
+            if (queue_us > max_queue_us) {
+                max_queue_us = queue_us;
+            }
+            
+            dispatch_event(event.button_id, event.pressed);
+        }
+        
+        if (poll_handler) {
+            arm_deadline(poll_handler(esp_timer_get_time()));
+        }
+    }
+}
+
+esp_err_t armdeck_dispatch_init(button_event_cb_t handler, dispatch_poll_cb_t poll) {
+    if (dispatch_task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    armdeck_event_ring_init(&ring);
+    event_handler = handler;
+    poll_handler = poll;
+    
+    const esp_timer_create_args_t timer_args = {
+        .callback = deadline_timer_callback,
+        .name = "dispatch_deadline"
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &deadline_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create deadline timer: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    BaseType_t ret = xTaskCreate(dispatch_task, "hid_dispatch", DISPATCH_TASK_STACK, NULL,
+                                 DISPATCH_TASK_PRIORITY, &dispatch_task_handle);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create dispatch task");
+        return ESP_FAIL;
+    }
+    
+    ESP_LOGI(TAG, "Event dispatch initialized (ring: %d events)", ARMDECK_EVENT_RING_SIZE);
+    return ESP_OK;
+}
+
+void armdeck_dispatch_post(uint8_t button_id, bool pressed) {
+    armdeck_key_event_t event = {
+        .timestamp_us = esp_timer_get_time(),
+        .button_id = button_id,
+        .pressed = pressed
+    };
+    
+    /* A full ring drops the event, the dispatch task resyncs from the matrix state */
+    armdeck_event_ring_push(&ring, &event);
+    
+    if (dispatch_task_handle) {
+        xTaskNotifyGive(dispatch_task_handle);
+    }
+}
+
+void armdeck_dispatch_wake(void) {
+    if (dispatch_task_handle) {
+        xTaskNotifyGive(dispatch_task_handle);
+    }
+}
+
+esp_err_t armdeck_dispatch_get_stats(armdeck_dispatch_stats_t* stats) {
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    armdeck_event_ring_get_stats(&ring, &stats->ring);
+    stats->dispatched = dispatched;
+    stats->resyncs = resyncs;
+    stats->max_queue_us = max_queue_us;
+    
+    uint32_t queued = dispatched - resyncs;
+    stats->avg_queue_us = queued ? (uint32_t)(total_queue_us / queued) : 0;
+    return ESP_OK;
+}
+
+void armdeck_dispatch_log_stats(void) {
+    armdeck_dispatch_stats_t stats;
+    armdeck_dispatch_get_stats(&stats);
+    
+    ESP_LOGI(TAG, "Events: queued=%lu dispatched=%lu overflows=%lu high_water=%lu/%d resyncs=%lu queue avg=%lu max=%lu us",
+             stats.ring.pushed, stats.dispatched, stats.ring.overflows, stats.ring.high_water,
+             ARMDECK_EVENT_RING_SIZE, stats.resyncs, stats.avg_queue_us, stats.max_queue_us);
+}
@@ -0,0 +1,42 @@
+#ifndef ARMDECK_DISPATCH_H
+#define ARMDECK_DISPATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "button_matrix.h"
+#include "armdeck_event_ring.h"
+
+/* Dispatch task configuration (below the scan task so scanning always preempts it) */
+#define DISPATCH_TASK_PRIORITY      4
+#define DISPATCH_TASK_STACK         3072
+
+/* Dispatch statistics */
+typedef struct {
+    armdeck_event_ring_stats_t ring;
+    uint32_t dispatched;        // Events handed to the handler
+    uint32_t resyncs;           // Events synthesized after an overflow
+    uint32_t avg_queue_us;      // Detection to dispatch delay
+    uint32_t max_queue_us;
+} armdeck_dispatch_stats_t;
+
+/* Deadline hook, run in the dispatch task after every batch of events and when the
+ * deadline it returned expires. Returns the next deadline (esp_timer time) or 0 for none. */
+typedef int64_t (*dispatch_poll_cb_t)(int64_t now_us);
+
+/* Create the event ring and the dispatch task, handler and poll (optional) run in the dispatch task */
+esp_err_t armdeck_dispatch_init(button_event_cb_t handler, dispatch_poll_cb_t poll);
+
+/* Queue a key event, never blocks (matrix callback, the scan task is the only producer) */
+void armdeck_dispatch_post(uint8_t button_id, bool pressed);
+
+/* Run the poll hook now, without a key event (any task) */
+void armdeck_dispatch_wake(void);
+
+/* Get dispatch statistics */
+esp_err_t armdeck_dispatch_get_stats(armdeck_dispatch_stats_t* stats);
+
+/* Log dispatch statistics */
+void armdeck_dispatch_log_stats(void);
+
+#endif /* ARMDECK_DISPATCH_H */
@@ -0,0 +1,63 @@
+#include "armdeck_event_ring.h"
+
+_Static_assert((ARMDECK_EVENT_RING_SIZE & (ARMDECK_EVENT_RING_SIZE - 1)) == 0,
+               "ARMDECK_EVENT_RING_SIZE must be a power of two");
+
+#define RING_MASK   (ARMDECK_EVENT_RING_SIZE - 1)
+
+void armdeck_event_ring_init(armdeck_event_ring_t* ring) {
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->pushed, 0);
+    atomic_init(&ring->overflows, 0);
+    atomic_init(&ring->high_water, 0);
+}
+
+bool armdeck_event_ring_push(armdeck_event_ring_t* ring, const armdeck_key_event_t* event) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t depth = head - tail;
+    
+    if (depth >= ARMDECK_EVENT_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->overflows, 1, memory_order_relaxed);
+        return false;
+    }
+    
+    ring->events[head & RING_MASK] = *event;
+    
+    /* Publish the slot before moving head */
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    atomic_fetch_add_explicit(&ring->pushed, 1, memory_order_relaxed);
+    
+    /* Only the producer raises high_water, no compare-exchange needed */
+    if (depth + 1 > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, depth + 1, memory_order_relaxed);
+    }
+    return true;
+}
+
+bool armdeck_event_ring_pop(armdeck_event_ring_t* ring, armdeck_key_event_t* event) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    
+    if (head == tail) {
+        return false;
+    }
+    
+    *event = ring->events[tail & RING_MASK];
+    
+    /* Hand the slot back to the producer only once it has been copied */
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+void armdeck_event_ring_get_stats(armdeck_event_ring_t* ring, armdeck_event_ring_stats_t* stats) {
+    /* tail first: head can only be ahead of it */
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    
+    stats->pushed = atomic_load_explicit(&ring->pushed, memory_order_relaxed);
+    stats->overflows = atomic_load_explicit(&ring->overflows, memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&ring->high_water, memory_order_relaxed);
+    stats->depth = head - tail;
+}
@@ -0,0 +1,50 @@
+#ifndef ARMDECK_EVENT_RING_H
+#define ARMDECK_EVENT_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/* Ring capacity, must be a power of two */
+#define ARMDECK_EVENT_RING_SIZE     64
+
+/* Timestamped key event */
+typedef struct {
+    int64_t timestamp_us;   // Time the debounced transition was detected
+    uint8_t button_id;
+    bool pressed;
+} armdeck_key_event_t;
+
+/* Single-producer / single-consumer lock-free ring
+ * - head is only written by the producer, tail only by the consumer
+ * - a full ring drops the new event and counts an overflow, the producer never waits */
+typedef struct {
+    armdeck_key_event_t events[ARMDECK_EVENT_RING_SIZE];
+    atomic_uint_least32_t head;
+    atomic_uint_least32_t tail;
+    atomic_uint_least32_t pushed;
+    atomic_uint_least32_t overflows;
+    atomic_uint_least32_t high_water;
+} armdeck_event_ring_t;
+
+/* Ring statistics */
+typedef struct {
+    uint32_t pushed;
+    uint32_t overflows;
+    uint32_t high_water;    // Highest depth seen
+    uint32_t depth;         // Current depth
+} armdeck_event_ring_stats_t;
+
+/* Reset the ring (no producer or consumer may be running) */
+void armdeck_event_ring_init(armdeck_event_ring_t* ring);
+
+/* Producer side, returns false (and counts an overflow) when full */
+bool armdeck_event_ring_push(armdeck_event_ring_t* ring, const armdeck_key_event_t* event);
+
+/* Consumer side, returns false when empty */
+bool armdeck_event_ring_pop(armdeck_event_ring_t* ring, armdeck_key_event_t* event);
+
+/* Get ring statistics (safe from any task) */
+void armdeck_event_ring_get_stats(armdeck_event_ring_t* ring, armdeck_event_ring_stats_t* stats);
+
+#endif /* ARMDECK_EVENT_RING_H */
@@ -0,0 +1,176 @@
+#include "armdeck_gesture.h"
+#include "armdeck_button_table.h"
+#include "button_matrix.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char* TAG = "ARMDECK_GESTURE";
+
+/* Per-button state machine (buttons with gesture flags only) */
+typedef enum {
+    SLOT_IDLE = 0,
+    SLOT_DOWN,                  // Pressed, hold not reached yet
+    SLOT_HELD,                  // Hold action down
+    SLOT_WAIT_SECOND,           // Released, waiting for a second press
+    SLOT_DOUBLE_DOWN,           // Double tap action down
+} slot_state_t;
+
+typedef struct {
+    uint8_t state;              // slot_state_t
+    uint8_t flags;              // Gesture flags latched at the first press
+    uint16_t hold_ms;
+    uint16_t double_tap_ms;
+    int64_t deadline_us;        // Valid while the button is in pending_mask
+} gesture_slot_t;
+
+static gesture_slot_t slots[MATRIX_MAX_KEYS];
+static matrix_mask_t pending_mask = 0;      // Buttons with a deadline
+static matrix_mask_t passthrough_mask = 0;  // Plain presses sent straight to the output
+
+static armdeck_gesture_cb_t gesture_output = NULL;
+
+static void emit(uint8_t button_id, armdeck_gesture_t gesture, bool pressed) {
+    if (gesture_output) {
+        gesture_output(button_id, gesture, pressed);
+    }
+}
+
+static void emit_tap(uint8_t button_id) {
+    emit(button_id, GESTURE_TAP, true);
+    emit(button_id, GESTURE_TAP, false);
+}
+
+static void set_deadline(uint8_t button_id, int64_t deadline_us) {
+    slots[button_id].deadline_us = deadline_us;
+    pending_mask |= MATRIX_KEY_BIT(button_id);
+}
+
+static void clear_deadline(uint8_t button_id) {
+    pending_mask &= ~MATRIX_KEY_BIT(button_id);
+}
+
+esp_err_t armdeck_gesture_init(armdeck_gesture_cb_t output) {
+    for (int i = 0; i < MATRIX_MAX_KEYS; i++) {
+        slots[i] = (gesture_slot_t){ .state = SLOT_IDLE };
+    }
+    pending_mask = 0;
+    passthrough_mask = 0;
+    gesture_output = output;
+    return ESP_OK;
+}
+
+static void handle_press(uint8_t button_id, int64_t now_us) {
+    gesture_slot_t* slot = &slots[button_id];
+    
+    switch (slot->state) {
+        case SLOT_IDLE: {
+            const armdeck_button_entry_t* entry = armdeck_button_table_get(button_id);
+            const armdeck_button_ext_t* ext = entry ? &entry->ext : NULL;
+            if (!ext || ext->gesture_flags == 0) {
+                /* Plain button: no resolution delay */
+                passthrough_mask |= MATRIX_KEY_BIT(button_id);
+                emit(button_id, GESTURE_TAP, true);
+                return;
+            }
+            
+            /* Latch the timings so a configuration change cannot strand a button mid-gesture */
+            slot->flags = ext->gesture_flags;
+            slot->hold_ms = ext->hold_ms ? ext->hold_ms : GESTURE_DEFAULT_HOLD_MS;
+            slot->double_tap_ms = ext->double_tap_ms ? ext->double_tap_ms : GESTURE_DEFAULT_DOUBLE_TAP_MS;
+            slot->state = SLOT_DOWN;
+            if (slot->flags & GESTURE_FLAG_HOLD) {
+                set_deadline(button_id, now_us + slot->hold_ms * 1000LL);
+            }
+            break;
+        }
+        
+        case SLOT_WAIT_SECOND:
+            clear_deadline(button_id);
+            slot->state = SLOT_DOUBLE_DOWN;
+            emit(button_id, GESTURE_DOUBLE_TAP, true);
+            break;
+            
+        default:
+            /* Press while already down: a release was lost, keep the current gesture */
+            ESP_LOGW(TAG, "Button %d pressed in state %d", button_id + 1, slot->state);
+            break;
+    }
+}
+
+static void handle_release(uint8_t button_id, int64_t now_us) {
+    gesture_slot_t* slot = &slots[button_id];
+    
+    if (passthrough_mask & MATRIX_KEY_BIT(button_id)) {
+        passthrough_mask &= ~MATRIX_KEY_BIT(button_id);
+        emit(button_id, GESTURE_TAP, false);
+        return;
+    }
+    
+    switch (slot->state) {
+        case SLOT_DOWN:
+            clear_deadline(button_id);
+            if (slot->flags & GESTURE_FLAG_DOUBLE_TAP) {
+                slot->state = SLOT_WAIT_SECOND;
+                set_deadline(button_id, now_us + slot->double_tap_ms * 1000LL);
+            } else {
+                slot->state = SLOT_IDLE;
+                emit_tap(button_id);
+            }
+            break;
+            
+        case SLOT_HELD:
+            slot->state = SLOT_IDLE;
+            emit(button_id, GESTURE_HOLD, false);
+            break;
+            
+        case SLOT_DOUBLE_DOWN:
+            slot->state = SLOT_IDLE;
+            emit(button_id, GESTURE_DOUBLE_TAP, false);
+            break;
+            
+        default:
+            break;
+    }
+}
+
+void armdeck_gesture_handle_event(uint8_t button_id, bool pressed) {
+    if (button_id >= MATRIX_MAX_KEYS) {
+        return;
+    }
+    
+    int64_t now_us = esp_timer_get_time();
+    if (pressed) {
+        handle_press(button_id, now_us);
+    } else {
+        handle_release(button_id, now_us);
+    }
+}
+
+int64_t armdeck_gesture_poll(int64_t now_us) {
+    int64_t next_us = 0;
+    
+    for (matrix_mask_t work = pending_mask; work; work &= work - 1) {
+        uint8_t button_id = __builtin_ctzll(work);
+        gesture_slot_t* slot = &slots[button_id];
+        
+        if (now_us < slot->deadline_us) {
+            if (next_us == 0 || slot->deadline_us < next_us) {
+                next_us = slot->deadline_us;
+            }
+            continue;
+        }
+        
+        clear_deadline(button_id);
+        if (slot->state == SLOT_DOWN) {
+            /* Still down at the hold threshold */
+            slot->state = SLOT_HELD;
+            emit(button_id, GESTURE_HOLD, true);
+        } else if (slot->state == SLOT_WAIT_SECOND) {
+            /* No second press in time: it was a single tap */
+            slot->state = SLOT_IDLE;
+            emit_tap(button_id);
+        }
+    }
+    
+    return next_us;
+}
@@ -0,0 +1,30 @@
+#ifndef ARMDECK_GESTURE_H
+#define ARMDECK_GESTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* Gesture resolved from a button's press/release stream */
+typedef enum {
+    GESTURE_TAP = 0,            // Button action (plain buttons always resolve to this)
+    GESTURE_HOLD,               // Held past hold_ms
+    GESTURE_DOUBLE_TAP,         // Second press within double_tap_ms
+    GESTURE_COUNT
+} armdeck_gesture_t;
+
+/* Resolved gesture output: the action of the gesture goes down or up */
+typedef void (*armdeck_gesture_cb_t)(uint8_t button_id, armdeck_gesture_t gesture, bool pressed);
+
+/* Reset all gesture state and set the output (before armdeck_dispatch_init) */
+esp_err_t armdeck_gesture_init(armdeck_gesture_cb_t output);
+
+/* Feed a debounced key event (dispatch task). Buttons without gesture flags
+ * go straight to the output, the others start or advance their state machine. */
+void armdeck_gesture_handle_event(uint8_t button_id, bool pressed);
+
+/* Resolve expired gestures (dispatch task). Returns the next deadline
+ * (esp_timer time) or 0 when no button is waiting. */
+int64_t armdeck_gesture_poll(int64_t now_us);
+
+#endif /* ARMDECK_GESTURE_H */
@@ -1,11 +1,15 @@
 #include "armdeck_hid.h"
 #include "armdeck_common.h"
+#include "armdeck_ble.h"
 #include "esp_log.h"
 #include "hid_dev.h"
 #include <string.h>
 
 static const char* TAG = "ARMDECK_HID";
 
+/* Earliest time the link can take the next paced report (dispatch task) */
+static int64_t link_free_us = 0;
+
 /* HID connection state */
 static bool hid_connected = false;
 
@@ -28,13 +32,18 @@ static void hid_event_handler(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *pa
             hid_connected = true;
             ESP_LOGI(TAG, "HID connected, conn_id=%d", hid_conn_id);
             
-            /* Send initial empty report */
-            armdeck_hid_send_empty();
+            /* Update global connection state for monitoring */
+            armdeck_main_set_connected(true, hid_conn_id);
+            
+            /* New host state: nothing sent to it yet. The dispatch task sends the tracked
+             * state (armdeck_keyboard_resync), an empty report here would release held keys. */
+            esp_hidd_resync_reports();
             break;
               case ESP_HIDD_EVENT_BLE_DISCONNECT:
             ESP_LOGI(TAG, "HID disconnected");
             hid_connected = false;
             hid_conn_id = 0;
+            esp_hidd_resync_reports();
             
             /* Update global connection state for monitoring */
             armdeck_main_set_connected(false, 0);
@@ -59,41 +68,62 @@ esp_err_t armdeck_hid_init(void) {
         return ret;
     }
     
-    /* Register our internal callback */
-    esp_hidd_register_callbacks(hid_event_handler);
+    /* Register our internal callback; the profile's GATTS applications go through
+     * the BLE dispatcher so they receive their own events */
+    ret = esp_hidd_register_callbacks(hid_event_handler, armdeck_ble_register_gatts_app);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register HID callbacks: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t armdeck_hid_send_keyboard(uint8_t modifiers, const uint8_t* keys, uint8_t num_keys) {
+    if (!hid_connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    esp_hidd_send_keyboard_value(hid_conn_id, modifiers, (uint8_t*)keys, num_keys);
+    
+    ESP_LOGD(TAG, "Keyboard report: %d key(s) (mod:0x%02x)", num_keys, modifiers);
     
     return ESP_OK;
 }
 
-esp_err_t armdeck_hid_send_key(uint8_t key_code, uint8_t modifiers, bool pressed) {
+esp_err_t armdeck_hid_send_keyboard_bitmap(uint8_t modifiers, const uint8_t* bitmap) {
     if (!hid_connected) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    if (pressed) {
-        // Send key press
-        uint8_t key_codes[1] = {key_code};
-        esp_hidd_send_keyboard_value(hid_conn_id, modifiers, key_codes, 1);
-    } else {
-        // Send key release (empty report)
-        esp_hidd_send_keyboard_value(hid_conn_id, 0, NULL, 0);
+    esp_hidd_send_keyboard_bitmap(hid_conn_id, modifiers, bitmap);
+    
+    ESP_LOGD(TAG, "NKRO report (mod:0x%02x)", modifiers);
+    
+    return ESP_OK;
+}
+
+esp_err_t armdeck_hid_send_consumer(const uint16_t* usages, uint8_t num_usages) {
+    if (!hid_connected) {
+        ESP_LOGW(TAG, "Cannot send consumer - not connected (hid_conn_id=%d)", hid_conn_id);
+        return ESP_ERR_INVALID_STATE;
     }
     
-    ESP_LOGD(TAG, "Key %s: 0x%02x (mod:0x%02x)", 
-            pressed ? "press" : "release", key_code, modifiers);
+    esp_hidd_send_consumer_usages(hid_conn_id, usages, num_usages);
+    
+    ESP_LOGD(TAG, "Consumer report: %d usage(s)", num_usages);
     
     return ESP_OK;
 }
 
-esp_err_t armdeck_hid_send_consumer(uint16_t usage_code, bool pressed) {
-    ESP_LOGD(TAG, "send_consumer: hid_connected=%s, hid_conn_id=%d", 
-             hid_connected ? "true" : "false", hid_conn_id);
+esp_err_t armdeck_hid_send_mouse(uint8_t buttons, int8_t x, int8_t y, int8_t wheel) {
     if (!hid_connected) {
-        ESP_LOGW(TAG, "Cannot send consumer - not connected (hid_connected=%s, hid_conn_id=%d)", 
-                 hid_connected ? "true" : "false", hid_conn_id);
         return ESP_ERR_INVALID_STATE;
     }
-      esp_hidd_send_consumer_value(hid_conn_id, (uint8_t)(usage_code & 0xFF), pressed);
+    
+    esp_hidd_send_mouse_value(hid_conn_id, buttons, x, y, wheel);
+    
+    ESP_LOGD(TAG, "Mouse report (buttons:0x%02x, %d/%d, wheel %d)", buttons, x, y, wheel);
     
     return ESP_OK;
 }
@@ -108,20 +138,56 @@ esp_err_t armdeck_hid_send_empty(void) {
     return ESP_OK;
 }
 
-bool armdeck_hid_is_connected(void) {
-    return hid_connected;
+esp_err_t armdeck_hid_send_keep_alive(void) {
+    if (!hid_connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    /* The host already has this state: resending it keeps held keys held */
+    esp_hidd_send_keep_alive(hid_conn_id);
+    return ESP_OK;
 }
 
-// Force HID connection state when custom service connects
-void armdeck_hid_force_connected(uint16_t conn_id) {
-    hid_connected = true;
-    hid_conn_id = conn_id;
-    
-    /* Update global connection state for monitoring */
-    armdeck_main_set_connected(true, conn_id);
+void armdeck_hid_resync(void) {
+    esp_hidd_resync_reports();
+}
+
+uint8_t armdeck_hid_get_queued_reports(void) {
+    esp_hidd_report_stats_t stats;
+    esp_hidd_get_report_stats(&stats);
+    return stats.queued;
+}
+
+int64_t armdeck_hid_link_free_us(int64_t now_us) {
+    int64_t conn_us = armdeck_ble_get_conn_interval_us();
+    if (armdeck_hid_get_queued_reports() > 0 && link_free_us < now_us + conn_us) {
+        link_free_us = now_us + conn_us;
+    }
+    return link_free_us;
+}
+
+void armdeck_hid_link_take(int64_t now_us, uint8_t reports) {
+    link_free_us = now_us + (int64_t)armdeck_ble_get_conn_interval_us() * reports;
+}
+
+int64_t armdeck_hid_get_last_report_us(void) {
+    esp_hidd_report_stats_t stats;
+    esp_hidd_get_report_stats(&stats);
+    return stats.last_sent_us;
+}
+
+void armdeck_hid_log_stats(void) {
+    esp_hidd_report_stats_t stats;
+    esp_hidd_get_report_stats(&stats);
     
-    /* Send initial empty report */
-    armdeck_hid_send_empty();
+    ESP_LOGI(TAG, "Input reports: sent=%lu suppressed=%lu keep-alive=%lu resyncs=%lu",
+             stats.sent, stats.suppressed, stats.resent, stats.resyncs);
+    ESP_LOGI(TAG, "Report queue: depth=%d max=%d retries=%lu collapsed=%lu dropped=%lu congestions=%lu",
+             stats.queued, stats.max_queued, stats.retries, stats.collapsed, stats.dropped, stats.congestions);
+}
+
+bool armdeck_hid_is_connected(void) {
+    return hid_connected;
 }
 
 uint16_t armdeck_hid_get_conn_id(void) {
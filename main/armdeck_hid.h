@@ -15,21 +15,49 @@ typedef enum {
 /* Initialize HID profile */
 esp_err_t armdeck_hid_init(void);
 
-/* Send keyboard key */
-esp_err_t armdeck_hid_send_key(uint8_t key_code, uint8_t modifiers, bool pressed);
+/* Send a 6-key keyboard report (modifiers and up to 6 key codes) */
+esp_err_t armdeck_hid_send_keyboard(uint8_t modifiers, const uint8_t* keys, uint8_t num_keys);
 
-/* Send consumer control (media keys) */
-esp_err_t armdeck_hid_send_consumer(uint16_t usage_code, bool pressed);
+/* Send an NKRO keyboard report (modifiers and HID_NKRO_BITMAP_LEN bytes of key bits) */
+esp_err_t armdeck_hid_send_keyboard_bitmap(uint8_t modifiers, const uint8_t* bitmap);
 
-/* Send empty report (for keep-alive) */
+/* Send a consumer control report (up to HID_CC_IN_USAGES 16-bit Consumer Page usages) */
+esp_err_t armdeck_hid_send_consumer(const uint16_t* usages, uint8_t num_usages);
+
+/* Send a mouse report: held buttons (MOUSE_BUTTON_* bits) and relative X, Y and wheel motion */
+esp_err_t armdeck_hid_send_mouse(uint8_t buttons, int8_t x, int8_t y, int8_t wheel);
+
+/* Send empty keyboard report (at connection) */
 esp_err_t armdeck_hid_send_empty(void);
 
+/* Send the last input report again (keep-alive) */
+esp_err_t armdeck_hid_send_keep_alive(void);
+
+/* Reports identical to the last one of their ID are not sent: after this,
+ * the next report of every ID is sent anyway */
+void armdeck_hid_resync(void);
+
+/* Reports waiting in the output queue for the link */
+uint8_t armdeck_hid_get_queued_reports(void);
+
+/* Link budget shared by the engines that pace reports to the connection interval
+ * (repeat, macros, mouse motion), dispatch task only: earliest esp_timer time the next
+ * paced report can go. Never earlier than one interval away while reports still wait
+ * in the output queue. */
+int64_t armdeck_hid_link_free_us(int64_t now_us);
+
+/* Reserve the link for reports sent now, one connection interval each */
+void armdeck_hid_link_take(int64_t now_us, uint8_t reports);
+
+/* esp_timer time of the last report handed to the link, keep-alives included, 0 if none */
+int64_t armdeck_hid_get_last_report_us(void);
+
+/* Log report counts and output queue statistics */
+void armdeck_hid_log_stats(void);
+
 /* Check if HID is connected */
 bool armdeck_hid_is_connected(void);
 
-/* TEMPORARY WORKAROUND: Force HID connection state */
-void armdeck_hid_force_connected(uint16_t conn_id);
-
 /* Get connection ID */
 uint16_t armdeck_hid_get_conn_id(void);
 
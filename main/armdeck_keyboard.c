@@ -0,0 +1,281 @@
+#include "armdeck_keyboard.h"
+#include "armdeck_hid.h"
+#include "armdeck_protocol.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char* TAG = "ARMDECK_KEYBOARD";
+
+/* Keyboard page usages with a special meaning in the reports */
+#define KEY_ERROR_ROLLOVER          0x01    // Fills all 6 slots when more keys are held
+#define KEY_MODIFIER_FIRST          0xE0    // Left Control, modifier bit 0
+#define KEY_MODIFIER_LAST           0xE7    // Right GUI, modifier bit 7
+
+/* Key slots of the 6KRO report */
+#define KEYBOARD_6KRO_SLOTS         6
+
+/* Held state (dispatch task), counted per key and per modifier bit */
+static uint8_t key_counts[256];
+static uint8_t modifier_counts[8];
+static uint8_t held_keys[KEYBOARD_MAX_HELD_KEYS];  // Distinct held keys, in press order
+static uint8_t num_held = 0;
+
+/* Held consumer usages, in press order */
+static uint16_t held_usages[CONSUMER_MAX_HELD_USAGES];
+static uint8_t usage_counts[CONSUMER_MAX_HELD_USAGES];
+static uint8_t num_usages = 0;
+
+/* Changes since the last flush. Keyboard usages (modifiers as 0xE0-0xE7) touched in the
+ * batch are kept so a second change of the same key sends the first one before applying. */
+static uint8_t keyboard_touched[256 / 8];
+static bool keyboard_dirty = false;
+static uint16_t consumer_touched[CONSUMER_MAX_HELD_USAGES];
+static uint8_t num_consumer_touched = 0;
+
+/* Report format in use and the one requested by the settings */
+static uint8_t mode = KEYBOARD_MODE_6KRO;
+static volatile uint8_t requested_mode = KEYBOARD_MODE_6KRO;
+
+/* Full state resend requested (any task), applied at the next flush */
+static volatile bool resync_requested = false;
+
+/* Statistics (written by the dispatch task only) */
+static armdeck_keyboard_stats_t stats;
+static armdeck_keyboard_stats_t logged_stats;
+static int64_t logged_us = 0;
+
+static uint8_t modifier_mask(void) {
+    uint8_t mask = 0;
+    for (int i = 0; i < 8; i++) {
+        if (modifier_counts[i]) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+static bool is_modifier_key(uint8_t key_code) {
+    return key_code >= KEY_MODIFIER_FIRST && key_code <= KEY_MODIFIER_LAST;
+}
+
+/* Switching format: clear the report of the old one so no key stays down there */
+static void apply_requested_mode(void) {
+    uint8_t new_mode = requested_mode;
+    if (new_mode == mode) {
+        return;
+    }
+    
+    if (mode == KEYBOARD_MODE_NKRO) {
+        uint8_t bitmap[HID_NKRO_BITMAP_LEN] = {0};
+        armdeck_hid_send_keyboard_bitmap(0, bitmap);
+    } else {
+        armdeck_hid_send_keyboard(0, NULL, 0);
+    }
+    
+    mode = new_mode;
+    keyboard_dirty = true;
+    ESP_LOGI(TAG, "Keyboard reports: %s", mode == KEYBOARD_MODE_NKRO ? "NKRO" : "6KRO");
+}
+
+/* One notification carrying every held key and modifier */
+static void send_keyboard_report(void) {
+    uint8_t modifiers = modifier_mask();
+    
+    memset(keyboard_touched, 0, sizeof(keyboard_touched));
+    keyboard_dirty = false;
+    stats.keyboard_reports++;
+    
+    if (mode == KEYBOARD_MODE_NKRO) {
+        uint8_t bitmap[HID_NKRO_BITMAP_LEN] = {0};
+        for (int i = 0; i < num_held; i++) {
+            if (held_keys[i] <= HID_NKRO_MAX_USAGE) {
+                bitmap[held_keys[i] >> 3] |= 1 << (held_keys[i] & 7);
+            }
+        }
+        armdeck_hid_send_keyboard_bitmap(modifiers, bitmap);
+        return;
+    }
+    
+    /* Boot protocol rule: more keys than slots reports a rollover error, not a random subset */
+    uint8_t keys[KEYBOARD_6KRO_SLOTS];
+    uint8_t num_keys = num_held;
+    if (num_held > KEYBOARD_6KRO_SLOTS) {
+        memset(keys, KEY_ERROR_ROLLOVER, sizeof(keys));
+        num_keys = KEYBOARD_6KRO_SLOTS;
+    } else {
+        memcpy(keys, held_keys, num_held);
+    }
+    armdeck_hid_send_keyboard(modifiers, keys, num_keys);
+}
+
+/* One notification carrying the HID_CC_IN_USAGES oldest held usages */
+static void send_consumer_report(void) {
+    num_consumer_touched = 0;
+    stats.consumer_reports++;
+    armdeck_hid_send_consumer(held_usages, num_usages < HID_CC_IN_USAGES ? num_usages : HID_CC_IN_USAGES);
+}
+
+/* Record a change of a keyboard usage, sending the pending report first if it already changed */
+static void touch_key(uint8_t usage) {
+    uint8_t bit = 1 << (usage & 7);
+    if (keyboard_touched[usage >> 3] & bit) {
+        send_keyboard_report();
+    }
+    keyboard_touched[usage >> 3] |= bit;
+    keyboard_dirty = true;
+    stats.changes++;
+}
+
+static void touch_usage(uint16_t usage) {
+    bool seen = false;
+    for (int i = 0; i < num_consumer_touched; i++) {
+        if (consumer_touched[i] == usage) {
+            seen = true;
+            break;
+        }
+    }
+    if (seen || num_consumer_touched >= CONSUMER_MAX_HELD_USAGES) {
+        send_consumer_report();
+    }
+    consumer_touched[num_consumer_touched++] = usage;
+    stats.changes++;
+}
+
+void armdeck_keyboard_set_mode(uint8_t new_mode) {
+    requested_mode = new_mode == KEYBOARD_MODE_NKRO ? KEYBOARD_MODE_NKRO : KEYBOARD_MODE_6KRO;
+}
+
+void armdeck_keyboard_press(uint8_t key_code, uint8_t modifiers) {
+    for (int i = 0; i < 8; i++) {
+        if (modifiers & (1 << i)) {
+            touch_key(KEY_MODIFIER_FIRST + i);
+            modifier_counts[i]++;
+        }
+    }
+    
+    if (is_modifier_key(key_code)) {
+        touch_key(key_code);
+        modifier_counts[key_code - KEY_MODIFIER_FIRST]++;
+    } else if (key_code != 0) {
+        if (key_counts[key_code] == 0) {
+            if (num_held >= KEYBOARD_MAX_HELD_KEYS) {
+                ESP_LOGW(TAG, "Too many keys held, ignoring 0x%02x", key_code);
+                return;
+            }
+            touch_key(key_code);
+            held_keys[num_held++] = key_code;
+            if (key_code > HID_NKRO_MAX_USAGE && requested_mode == KEYBOARD_MODE_NKRO) {
+                ESP_LOGW(TAG, "Key 0x%02x is outside the NKRO bitmap", key_code);
+            }
+        }
+        key_counts[key_code]++;
+    }
+}
+
+void armdeck_keyboard_release(uint8_t key_code, uint8_t modifiers) {
+    for (int i = 0; i < 8; i++) {
+        if ((modifiers & (1 << i)) && modifier_counts[i]) {
+            touch_key(KEY_MODIFIER_FIRST + i);
+            modifier_counts[i]--;
+        }
+    }
+    
+    if (is_modifier_key(key_code)) {
+        if (modifier_counts[key_code - KEY_MODIFIER_FIRST]) {
+            touch_key(key_code);
+            modifier_counts[key_code - KEY_MODIFIER_FIRST]--;
+        }
+    } else if (key_code != 0 && key_counts[key_code] && --key_counts[key_code] == 0) {
+        /* Last holder gone: drop it, keeping the press order of the others */
+        touch_key(key_code);
+        for (int i = 0; i < num_held; i++) {
+            if (held_keys[i] == key_code) {
+                memmove(&held_keys[i], &held_keys[i + 1], num_held - i - 1);
+                num_held--;
+                break;
+            }
+        }
+    }
+}
+
+void armdeck_keyboard_consumer(uint16_t usage, bool pressed) {
+    int slot = -1;
+    for (int i = 0; i < num_usages; i++) {
+        if (held_usages[i] == usage) {
+            slot = i;
+            break;
+        }
+    }
+    
+    if (pressed) {
+        if (slot >= 0) {
+            usage_counts[slot]++;
+        } else if (num_usages < CONSUMER_MAX_HELD_USAGES) {
+            touch_usage(usage);
+            held_usages[num_usages] = usage;
+            usage_counts[num_usages++] = 1;
+        } else {
+            ESP_LOGW(TAG, "Too many consumer usages held, ignoring 0x%03x", usage);
+        }
+    } else if (slot >= 0 && --usage_counts[slot] == 0) {
+        touch_usage(usage);
+        num_usages--;
+        memmove(&held_usages[slot], &held_usages[slot + 1], (num_usages - slot) * sizeof(held_usages[0]));
+        memmove(&usage_counts[slot], &usage_counts[slot + 1], num_usages - slot);
+    }
+}
+
+void armdeck_keyboard_resync(void) {
+    resync_requested = true;
+}
+
+void armdeck_keyboard_flush(void) {
+    apply_requested_mode();
+    
+    if (resync_requested) {
+        resync_requested = false;
+        armdeck_hid_resync();
+        keyboard_dirty = true;
+        send_consumer_report();
+    }
+    
+    if (keyboard_dirty) {
+        send_keyboard_report();
+    }
+    if (num_consumer_touched) {
+        send_consumer_report();
+    }
+}
+
+bool armdeck_keyboard_is_idle(void) {
+    return num_held == 0 && num_usages == 0 && modifier_mask() == 0;
+}
+
+esp_err_t armdeck_keyboard_get_stats(armdeck_keyboard_stats_t* out) {
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    *out = stats;
+    return ESP_OK;
+}
+
+void armdeck_keyboard_log_stats(void) {
+    armdeck_keyboard_stats_t now;
+    armdeck_keyboard_get_stats(&now);
+    
+    int64_t now_us = esp_timer_get_time();
+    uint32_t reports = (now.keyboard_reports - logged_stats.keyboard_reports) +
+                       (now.consumer_reports - logged_stats.consumer_reports);
+    uint32_t changes = now.changes - logged_stats.changes;
+    uint32_t elapsed_ms = logged_us ? (uint32_t)((now_us - logged_us) / 1000) : 0;
+    
+    ESP_LOGI(TAG, "Reports: keyboard=%lu consumer=%lu for %lu changes | last %lu ms: %lu changes -> %lu notifications (%lu.%02lu/s)",
+             now.keyboard_reports, now.consumer_reports, now.changes, elapsed_ms, changes, reports,
+             elapsed_ms ? reports * 1000 / elapsed_ms : 0,
+             elapsed_ms ? (reports * 100000 / elapsed_ms) % 100 : 0);
+             
+    logged_stats = now;
+    logged_us = now_us;
+}
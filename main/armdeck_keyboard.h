@@ -0,0 +1,49 @@
+#ifndef ARMDECK_KEYBOARD_H
+#define ARMDECK_KEYBOARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/* Most distinct non-modifier keys and consumer usages held at once */
+#define KEYBOARD_MAX_HELD_KEYS      64
+#define CONSUMER_MAX_HELD_USAGES    8
+
+/* Report statistics */
+typedef struct {
+    uint32_t changes;               // Key, modifier and usage changes
+    uint32_t keyboard_reports;      // Keyboard notifications (6KRO or NKRO)
+    uint32_t consumer_reports;      // Consumer notifications
+} armdeck_keyboard_stats_t;
+
+/* Select the report format, KEYBOARD_MODE_* (any task, applied at the next flush) */
+void armdeck_keyboard_set_mode(uint8_t mode);
+
+/* Press a key and/or modifiers (dispatch task). Keys and modifiers are counted, so a key
+ * held by two buttons stays down until both are up. Sent by the next armdeck_keyboard_flush. */
+void armdeck_keyboard_press(uint8_t key_code, uint8_t modifiers);
+
+/* Release a key and/or modifiers pressed with armdeck_keyboard_press (dispatch task) */
+void armdeck_keyboard_release(uint8_t key_code, uint8_t modifiers);
+
+/* Press or release a Consumer Page usage (dispatch task), counted like keys */
+void armdeck_keyboard_consumer(uint16_t usage, bool pressed);
+
+/* Send what changed since the last flush: at most one keyboard and one consumer report
+ * (dispatch task, after each batch of events). A key that changes twice in a batch
+ * flushes its first change right away so no transition is lost. */
+void armdeck_keyboard_flush(void);
+
+/* Send the whole held state at the next flush even if the host should have it (any task) */
+void armdeck_keyboard_resync(void);
+
+/* True when no key, modifier or usage is held */
+bool armdeck_keyboard_is_idle(void);
+
+/* Get report statistics */
+esp_err_t armdeck_keyboard_get_stats(armdeck_keyboard_stats_t* stats);
+
+/* Log report statistics and the notification rate since the last call */
+void armdeck_keyboard_log_stats(void);
+
+#endif /* ARMDECK_KEYBOARD_H */
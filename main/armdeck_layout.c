@@ -0,0 +1,394 @@
+#include "armdeck_layout.h"
+#include <stddef.h>
+
+/* Modifier bits of the keyboard report */
+#define SHIFT                       0x02    // Left Shift
+#define ALTGR                       0x40    // Right Alt
+
+/* HID usages of the control characters */
+#define KEY_ENTER                   0x28
+#define KEY_TAB                     0x2B
+
+/* Dead keys typed before a key, indexes in the layout dead key table */
+#define DEAD_CIRCUMFLEX             1
+#define DEAD_DIAERESIS              2
+#define DEAD_TILDE                  3
+#define DEAD_GRAVE                  4
+#define DEAD_COUNT                  5
+
+/* Key of a character: usage, modifiers, and the dead key typed first (0 = none) */
+typedef struct {
+    uint8_t key_code;
+    uint8_t modifier;
+    uint8_t dead;
+} layout_key_t;
+
+/* Character above the printable ASCII range */
+typedef struct {
+    uint16_t codepoint;
+    layout_key_t key;
+} layout_extra_t;
+
+/* Host layout: printable ASCII (0x20-0x7E) indexed directly, then a sorted extra list */
+typedef struct {
+    const layout_key_t* ascii;
+    const layout_extra_t* extra;
+    uint8_t num_extra;
+    layout_key_t dead_keys[DEAD_COUNT];
+} layout_t;
+
+/* US QWERTY */
+static const layout_key_t us_ascii[0x7F - 0x20] = {
+    [' ' - 0x20] = { 0x2C, 0, 0 },
+    ['!' - 0x20] = { 0x1E, SHIFT, 0 },
+    ['"' - 0x20] = { 0x34, SHIFT, 0 },
+    ['#' - 0x20] = { 0x20, SHIFT, 0 },
+    ['$' - 0x20] = { 0x21, SHIFT, 0 },
+    ['%' - 0x20] = { 0x22, SHIFT, 0 },
+    ['&' - 0x20] = { 0x24, SHIFT, 0 },
+    ['\'' - 0x20] = { 0x34, 0, 0 },
+    ['(' - 0x20] = { 0x26, SHIFT, 0 },
+    [')' - 0x20] = { 0x27, SHIFT, 0 },
+    ['*' - 0x20] = { 0x25, SHIFT, 0 },
+    ['+' - 0x20] = { 0x2E, SHIFT, 0 },
+    [',' - 0x20] = { 0x36, 0, 0 },
+    ['-' - 0x20] = { 0x2D, 0, 0 },
+    ['.' - 0x20] = { 0x37, 0, 0 },
+    ['/' - 0x20] = { 0x38, 0, 0 },
+    ['0' - 0x20] = { 0x27, 0, 0 },
+    ['1' - 0x20] = { 0x1E, 0, 0 },
+    ['2' - 0x20] = { 0x1F, 0, 0 },
+    ['3' - 0x20] = { 0x20, 0, 0 },
+    ['4' - 0x20] = { 0x21, 0, 0 },
+    ['5' - 0x20] = { 0x22, 0, 0 },
+    ['6' - 0x20] = { 0x23, 0, 0 },
+    ['7' - 0x20] = { 0x24, 0, 0 },
+    ['8' - 0x20] = { 0x25, 0, 0 },
+    ['9' - 0x20] = { 0x26, 0, 0 },
+    [':' - 0x20] = { 0x33, SHIFT, 0 },
+    [';' - 0x20] = { 0x33, 0, 0 },
+    ['<' - 0x20] = { 0x36, SHIFT, 0 },
+    ['=' - 0x20] = { 0x2E, 0, 0 },
+    ['>' - 0x20] = { 0x37, SHIFT, 0 },
+    ['?' - 0x20] = { 0x38, SHIFT, 0 },
+    ['@' - 0x20] = { 0x1F, SHIFT, 0 },
+    ['A' - 0x20] = { 0x04, SHIFT, 0 },
+    ['B' - 0x20] = { 0x05, SHIFT, 0 },
+    ['C' - 0x20] = { 0x06, SHIFT, 0 },
+    ['D' - 0x20] = { 0x07, SHIFT, 0 },
+    ['E' - 0x20] = { 0x08, SHIFT, 0 },
+    ['F' - 0x20] = { 0x09, SHIFT, 0 },
+    ['G' - 0x20] = { 0x0A, SHIFT, 0 },
+    ['H' - 0x20] = { 0x0B, SHIFT, 0 },
+    ['I' - 0x20] = { 0x0C, SHIFT, 0 },
+    ['J' - 0x20] = { 0x0D, SHIFT, 0 },
+    ['K' - 0x20] = { 0x0E, SHIFT, 0 },
+    ['L' - 0x20] = { 0x0F, SHIFT, 0 },
+    ['M' - 0x20] = { 0x10, SHIFT, 0 },
+    ['N' - 0x20] = { 0x11, SHIFT, 0 },
+    ['O' - 0x20] = { 0x12, SHIFT, 0 },
+    ['P' - 0x20] = { 0x13, SHIFT, 0 },
+    ['Q' - 0x20] = { 0x14, SHIFT, 0 },
+    ['R' - 0x20] = { 0x15, SHIFT, 0 },
+    ['S' - 0x20] = { 0x16, SHIFT, 0 },
+    ['T' - 0x20] = { 0x17, SHIFT, 0 },
+    ['U' - 0x20] = { 0x18, SHIFT, 0 },
+    ['V' - 0x20] = { 0x19, SHIFT, 0 },
+    ['W' - 0x20] = { 0x1A, SHIFT, 0 },
+    ['X' - 0x20] = { 0x1B, SHIFT, 0 },
+    ['Y' - 0x20] = { 0x1C, SHIFT, 0 },
+    ['Z' - 0x20] = { 0x1D, SHIFT, 0 },
+    ['[' - 0x20] = { 0x2F, 0, 0 },
+    ['\\' - 0x20] = { 0x31, 0, 0 },
+    [']' - 0x20] = { 0x30, 0, 0 },
+    ['^' - 0x20] = { 0x23, SHIFT, 0 },
+    ['_' - 0x20] = { 0x2D, SHIFT, 0 },
+    ['`' - 0x20] = { 0x35, 0, 0 },
+    ['a' - 0x20] = { 0x04, 0, 0 },
+    ['b' - 0x20] = { 0x05, 0, 0 },
+    ['c' - 0x20] = { 0x06, 0, 0 },
+    ['d' - 0x20] = { 0x07, 0, 0 },
+    ['e' - 0x20] = { 0x08, 0, 0 },
+    ['f' - 0x20] = { 0x09, 0, 0 },
+    ['g' - 0x20] = { 0x0A, 0, 0 },
+    ['h' - 0x20] = { 0x0B, 0, 0 },
+    ['i' - 0x20] = { 0x0C, 0, 0 },
+    ['j' - 0x20] = { 0x0D, 0, 0 },
+    ['k' - 0x20] = { 0x0E, 0, 0 },
+    ['l' - 0x20] = { 0x0F, 0, 0 },
+    ['m' - 0x20] = { 0x10, 0, 0 },
+    ['n' - 0x20] = { 0x11, 0, 0 },
+    ['o' - 0x20] = { 0x12, 0, 0 },
+    ['p' - 0x20] = { 0x13, 0, 0 },
+    ['q' - 0x20] = { 0x14, 0, 0 },
+    ['r' - 0x20] = { 0x15, 0, 0 },
+    ['s' - 0x20] = { 0x16, 0, 0 },
+    ['t' - 0x20] = { 0x17, 0, 0 },
+    ['u' - 0x20] = { 0x18, 0, 0 },
+    ['v' - 0x20] = { 0x19, 0, 0 },
+    ['w' - 0x20] = { 0x1A, 0, 0 },
+    ['x' - 0x20] = { 0x1B, 0, 0 },
+    ['y' - 0x20] = { 0x1C, 0, 0 },
+    ['z' - 0x20] = { 0x1D, 0, 0 },
+    ['{' - 0x20] = { 0x2F, SHIFT, 0 },
+    ['|' - 0x20] = { 0x31, SHIFT, 0 },
+    ['}' - 0x20] = { 0x30, SHIFT, 0 },
+    ['~' - 0x20] = { 0x35, SHIFT, 0 },
+};
+
+/* French AZERTY (Windows and Linux "fr"). Backquote and tilde are dead keys
+ * followed by a space; positions are named by their US QWERTY usage. */
+static const layout_key_t fr_ascii[0x7F - 0x20] = {
+    [' ' - 0x20] = { 0x2C, 0, 0 },
+    ['!' - 0x20] = { 0x38, 0, 0 },
+    ['"' - 0x20] = { 0x20, 0, 0 },
+    ['#' - 0x20] = { 0x20, ALTGR, 0 },
+    ['$' - 0x20] = { 0x30, 0, 0 },
+    ['%' - 0x20] = { 0x34, SHIFT, 0 },
+    ['&' - 0x20] = { 0x1E, 0, 0 },
+    ['\'' - 0x20] = { 0x21, 0, 0 },
+    ['(' - 0x20] = { 0x22, 0, 0 },
+    [')' - 0x20] = { 0x2D, 0, 0 },
+    ['*' - 0x20] = { 0x32, 0, 0 },
+    ['+' - 0x20] = { 0x2E, SHIFT, 0 },
+    [',' - 0x20] = { 0x10, 0, 0 },
+    ['-' - 0x20] = { 0x23, 0, 0 },
+    ['.' - 0x20] = { 0x36, SHIFT, 0 },
+    ['/' - 0x20] = { 0x37, SHIFT, 0 },
+    ['0' - 0x20] = { 0x27, SHIFT, 0 },
+    ['1' - 0x20] = { 0x1E, SHIFT, 0 },
+    ['2' - 0x20] = { 0x1F, SHIFT, 0 },
+    ['3' - 0x20] = { 0x20, SHIFT, 0 },
+    ['4' - 0x20] = { 0x21, SHIFT, 0 },
+    ['5' - 0x20] = { 0x22, SHIFT, 0 },
+    ['6' - 0x20] = { 0x23, SHIFT, 0 },
+    ['7' - 0x20] = { 0x24, SHIFT, 0 },
+    ['8' - 0x20] = { 0x25, SHIFT, 0 },
+    ['9' - 0x20] = { 0x26, SHIFT, 0 },
+    [':' - 0x20] = { 0x37, 0, 0 },
+    [';' - 0x20] = { 0x36, 0, 0 },
+    ['<' - 0x20] = { 0x64, 0, 0 },
+    ['=' - 0x20] = { 0x2E, 0, 0 },
+    ['>' - 0x20] = { 0x64, SHIFT, 0 },
+    ['?' - 0x20] = { 0x10, SHIFT, 0 },
+    ['@' - 0x20] = { 0x27, ALTGR, 0 },
+    ['A' - 0x20] = { 0x14, SHIFT, 0 },
+    ['B' - 0x20] = { 0x05, SHIFT, 0 },
+    ['C' - 0x20] = { 0x06, SHIFT, 0 },
+    ['D' - 0x20] = { 0x07, SHIFT, 0 },
+    ['E' - 0x20] = { 0x08, SHIFT, 0 },
+    ['F' - 0x20] = { 0x09, SHIFT, 0 },
+    ['G' - 0x20] = { 0x0A, SHIFT, 0 },
+    ['H' - 0x20] = { 0x0B, SHIFT, 0 },
+    ['I' - 0x20] = { 0x0C, SHIFT, 0 },
+    ['J' - 0x20] = { 0x0D, SHIFT, 0 },
+    ['K' - 0x20] = { 0x0E, SHIFT, 0 },
+    ['L' - 0x20] = { 0x0F, SHIFT, 0 },
+    ['M' - 0x20] = { 0x33, SHIFT, 0 },
+    ['N' - 0x20] = { 0x11, SHIFT, 0 },
+    ['O' - 0x20] = { 0x12, SHIFT, 0 },
+    ['P' - 0x20] = { 0x13, SHIFT, 0 },
+    ['Q' - 0x20] = { 0x04, SHIFT, 0 },
+    ['R' - 0x20] = { 0x15, SHIFT, 0 },
+    ['S' - 0x20] = { 0x16, SHIFT, 0 },
+    ['T' - 0x20] = { 0x17, SHIFT, 0 },
+    ['U' - 0x20] = { 0x18, SHIFT, 0 },
+    ['V' - 0x20] = { 0x19, SHIFT, 0 },
+    ['W' - 0x20] = { 0x1D, SHIFT, 0 },
+    ['X' - 0x20] = { 0x1B, SHIFT, 0 },
+    ['Y' - 0x20] = { 0x1C, SHIFT, 0 },
+    ['Z' - 0x20] = { 0x1A, SHIFT, 0 },
+    ['[' - 0x20] = { 0x22, ALTGR, 0 },
+    ['\\' - 0x20] = { 0x25, ALTGR, 0 },
+    [']' - 0x20] = { 0x2D, ALTGR, 0 },
+    ['^' - 0x20] = { 0x26, ALTGR, 0 },
+    ['_' - 0x20] = { 0x25, 0, 0 },
+    ['`' - 0x20] = { 0x2C, 0, DEAD_GRAVE },
+    ['a' - 0x20] = { 0x14, 0, 0 },
+    ['b' - 0x20] = { 0x05, 0, 0 },
+    ['c' - 0x20] = { 0x06, 0, 0 },
+    ['d' - 0x20] = { 0x07, 0, 0 },
+    ['e' - 0x20] = { 0x08, 0, 0 },
+    ['f' - 0x20] = { 0x09, 0, 0 },
+    ['g' - 0x20] = { 0x0A, 0, 0 },
+    ['h' - 0x20] = { 0x0B, 0, 0 },
+    ['i' - 0x20] = { 0x0C, 0, 0 },
+    ['j' - 0x20] = { 0x0D, 0, 0 },
+    ['k' - 0x20] = { 0x0E, 0, 0 },
+    ['l' - 0x20] = { 0x0F, 0, 0 },
+    ['m' - 0x20] = { 0x33, 0, 0 },
+    ['n' - 0x20] = { 0x11, 0, 0 },
+    ['o' - 0x20] = { 0x12, 0, 0 },
+    ['p' - 0x20] = { 0x13, 0, 0 },
+    ['q' - 0x20] = { 0x04, 0, 0 },
+    ['r' - 0x20] = { 0x15, 0, 0 },
+    ['s' - 0x20] = { 0x16, 0, 0 },
+    ['t' - 0x20] = { 0x17, 0, 0 },
+    ['u' - 0x20] = { 0x18, 0, 0 },
+    ['v' - 0x20] = { 0x19, 0, 0 },
+    ['w' - 0x20] = { 0x1D, 0, 0 },
+    ['x' - 0x20] = { 0x1B, 0, 0 },
+    ['y' - 0x20] = { 0x1C, 0, 0 },
+    ['z' - 0x20] = { 0x1A, 0, 0 },
+    ['{' - 0x20] = { 0x21, ALTGR, 0 },
+    ['|' - 0x20] = { 0x23, ALTGR, 0 },
+    ['}' - 0x20] = { 0x2E, ALTGR, 0 },
+    ['~' - 0x20] = { 0x2C, 0, DEAD_TILDE },
+};
+
+static const layout_extra_t fr_extra[] = {
+    { 0x00A3, { 0x30, SHIFT, 0 } },  // £
+    { 0x00A4, { 0x30, ALTGR, 0 } },  // ¤
+    { 0x00A7, { 0x38, SHIFT, 0 } },  // §
+    { 0x00A8, { 0x2C, 0, DEAD_DIAERESIS } },  // ¨
+    { 0x00B0, { 0x2D, SHIFT, 0 } },  // °
+    { 0x00B2, { 0x35, 0, 0 } },  // ²
+    { 0x00B5, { 0x32, SHIFT, 0 } },  // µ
+    { 0x00C2, { 0x14, SHIFT, DEAD_CIRCUMFLEX } },  // Â
+    { 0x00C4, { 0x14, SHIFT, DEAD_DIAERESIS } },  // Ä
+    { 0x00CA, { 0x08, SHIFT, DEAD_CIRCUMFLEX } },  // Ê
+    { 0x00CB, { 0x08, SHIFT, DEAD_DIAERESIS } },  // Ë
+    { 0x00CE, { 0x0C, SHIFT, DEAD_CIRCUMFLEX } },  // Î
+    { 0x00CF, { 0x0C, SHIFT, DEAD_DIAERESIS } },  // Ï
+    { 0x00D4, { 0x12, SHIFT, DEAD_CIRCUMFLEX } },  // Ô
+    { 0x00D6, { 0x12, SHIFT, DEAD_DIAERESIS } },  // Ö
+    { 0x00DB, { 0x18, SHIFT, DEAD_CIRCUMFLEX } },  // Û
+    { 0x00DC, { 0x18, SHIFT, DEAD_DIAERESIS } },  // Ü
+    { 0x00E0, { 0x27, 0, 0 } },  // à
+    { 0x00E2, { 0x14, 0, DEAD_CIRCUMFLEX } },  // â
+    { 0x00E4, { 0x14, 0, DEAD_DIAERESIS } },  // ä
+    { 0x00E7, { 0x26, 0, 0 } },  // ç
+    { 0x00E8, { 0x24, 0, 0 } },  // è
+    { 0x00E9, { 0x1F, 0, 0 } },  // é
+    { 0x00EA, { 0x08, 0, DEAD_CIRCUMFLEX } },  // ê
+    { 0x00EB, { 0x08, 0, DEAD_DIAERESIS } },  // ë
+    { 0x00EE, { 0x0C, 0, DEAD_CIRCUMFLEX } },  // î
+    { 0x00EF, { 0x0C, 0, DEAD_DIAERESIS } },  // ï
+    { 0x00F4, { 0x12, 0, DEAD_CIRCUMFLEX } },  // ô
+    { 0x00F6, { 0x12, 0, DEAD_DIAERESIS } },  // ö
+    { 0x00F9, { 0x34, 0, 0 } },  // ù
+    { 0x00FB, { 0x18, 0, DEAD_CIRCUMFLEX } },  // û
+    { 0x00FC, { 0x18, 0, DEAD_DIAERESIS } },  // ü
+    { 0x00FF, { 0x1C, 0, DEAD_DIAERESIS } },  // ÿ
+    { 0x20AC, { 0x08, ALTGR, 0 } },  // €
+};
+
+static const layout_t layouts[TEXT_LAYOUT_COUNT] = {
+    [TEXT_LAYOUT_US] = {
+        .ascii = us_ascii,
+    },
+    [TEXT_LAYOUT_FR] = {
+        .ascii = fr_ascii,
+        .extra = fr_extra,
+        .num_extra = sizeof(fr_extra) / sizeof(fr_extra[0]),
+        .dead_keys = {
+            [DEAD_CIRCUMFLEX] = { 0x2F, 0, 0 },
+            [DEAD_DIAERESIS] = { 0x2F, SHIFT, 0 },
+            [DEAD_TILDE] = { 0x1F, ALTGR, 0 },
+            [DEAD_GRAVE] = { 0x24, ALTGR, 0 },
+        },
+    },
+};
+
+uint32_t armdeck_layout_decode_utf8(const uint8_t* text, uint8_t len, uint8_t* pos) {
+    uint8_t lead = text[*pos];
+    int extra;
+    uint32_t codepoint;
+    uint32_t min;
+    
+    if (lead < 0x80) {
+        (*pos)++;
+        return lead;
+    } else if ((lead & 0xE0) == 0xC0) {
+        extra = 1;
+        codepoint = lead & 0x1F;
+        min = 0x80;
+    } else if ((lead & 0xF0) == 0xE0) {
+        extra = 2;
+        codepoint = lead & 0x0F;
+        min = 0x800;
+    } else if ((lead & 0xF8) == 0xF0) {
+        extra = 3;
+        codepoint = lead & 0x07;
+        min = 0x10000;
+    } else {
+        (*pos)++;
+        return 0xFFFD;
+    }
+    
+    if (*pos + extra >= len) {
+        (*pos)++;
+        return 0xFFFD;
+    }
+    for (int i = 1; i <= extra; i++) {
+        uint8_t next = text[*pos + i];
+        if ((next & 0xC0) != 0x80) {
+            (*pos)++;
+            return 0xFFFD;
+        }
+        codepoint = (codepoint << 6) | (next & 0x3F);
+    }
+    
+    /* Overlong forms and surrogates are not characters */
+    if (codepoint < min || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        (*pos)++;
+        return 0xFFFD;
+    }
+    *pos += 1 + extra;
+    return codepoint;
+}
+
+static const layout_key_t* find_key(const layout_t* layout, uint32_t codepoint) {
+    static const layout_key_t enter = { KEY_ENTER, 0, 0 };
+    static const layout_key_t tab = { KEY_TAB, 0, 0 };
+    
+    if (codepoint == '\n') {
+        return &enter;
+    }
+    if (codepoint == '\t') {
+        return &tab;
+    }
+    if (codepoint >= 0x20 && codepoint < 0x7F) {
+        return &layout->ascii[codepoint - 0x20];
+    }
+    
+    /* Binary search of the extra characters */
+    int low = 0;
+    int high = layout->num_extra - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (layout->extra[mid].codepoint == codepoint) {
+            return &layout->extra[mid].key;
+        }
+        if (layout->extra[mid].codepoint < codepoint) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return NULL;
+}
+
+bool armdeck_layout_translate(uint8_t layout_id, uint32_t codepoint, armdeck_layout_keys_t* keys) {
+    keys->count = 0;
+    if (layout_id >= TEXT_LAYOUT_COUNT) {
+        return false;
+    }
+    
+    const layout_t* layout = &layouts[layout_id];
+    const layout_key_t* key = find_key(layout, codepoint);
+    if (!key || key->key_code == 0) {
+        return false;
+    }
+    
+    if (key->dead) {
+        const layout_key_t* dead = &layout->dead_keys[key->dead];
+        keys->strokes[keys->count++] = (armdeck_action_def_t){
+            .action_type = ACTION_KEY, .key_code = dead->key_code, .modifier = dead->modifier
+        };
+    }
+    keys->strokes[keys->count++] = (armdeck_action_def_t){
+        .action_type = ACTION_KEY, .key_code = key->key_code, .modifier = key->modifier
+    };
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef ARMDECK_LAYOUT_H
+#define ARMDECK_LAYOUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "armdeck_protocol.h"
+
+/* Most keystrokes typing one character: a dead key, then the key itself */
+#define LAYOUT_MAX_STROKES          2
+
+/* Keystrokes typing one character, each an ACTION_KEY tapped in order */
+typedef struct {
+    uint8_t count;                              // 0 = not on the layout
+    armdeck_action_def_t strokes[LAYOUT_MAX_STROKES];
+} armdeck_layout_keys_t;
+
+/* Decode the UTF-8 character at text[*pos] and move *pos past it. Invalid
+ * or truncated sequences decode to U+FFFD, one byte at a time. */
+uint32_t armdeck_layout_decode_utf8(const uint8_t* text, uint8_t len, uint8_t* pos);
+
+/* Keystrokes typing a Unicode character on a TEXT_LAYOUT_* host layout.
+ * Returns false when the layout has no key for it. */
+bool armdeck_layout_translate(uint8_t layout_id, uint32_t codepoint, armdeck_layout_keys_t* keys);
+
+#endif /* ARMDECK_LAYOUT_H */
@@ -0,0 +1,200 @@
+#include "armdeck_link.h"
+#include "esp_gap_ble_api.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char* TAG = "ARMDECK_LINK";
+
+/* Controller units */
+#define LINK_INTERVAL_UNIT_US       1250
+#define LINK_TIMEOUT_UNIT_MS        10
+
+/* Poll period while an update is in progress and the wanted mode changed */
+#define LINK_RECHECK_US             100000
+
+typedef struct {
+    uint16_t min_interval;
+    uint16_t max_interval;
+    uint16_t latency;
+    uint16_t timeout;
+} link_params_t;
+
+static const link_params_t mode_params[] = {
+    [LINK_MODE_ACTIVE] = { LINK_ACTIVE_MIN_INTERVAL, LINK_ACTIVE_MAX_INTERVAL, LINK_ACTIVE_LATENCY, LINK_ACTIVE_TIMEOUT },
+    [LINK_MODE_IDLE] = { LINK_IDLE_MIN_INTERVAL, LINK_IDLE_MAX_INTERVAL, LINK_IDLE_LATENCY, LINK_IDLE_TIMEOUT },
+};
+
+/* Connection, set by the BLE stack task */
+static esp_bd_addr_t peer_bda;
+static volatile bool connected = false;
+static volatile bool connect_seen = false;  // New connection, not picked up by the policy yet
+static volatile bool pending = false;       // Update asked, no answer yet
+static volatile bool refused = false;       // Last update refused, not picked up yet
+static volatile uint16_t interval = 0;
+static volatile uint16_t latency = 0;
+static volatile uint16_t timeout = 0;
+static volatile uint32_t requests = 0;
+static volatile uint32_t accepted = 0;
+static volatile uint32_t rejected = 0;
+
+/* Policy state (dispatch task) */
+static uint8_t mode = LINK_MODE_NONE;
+static int64_t last_activity_us = 0;
+static int64_t retry_at_us = 0;             // No request before this
+static int64_t pending_since_us = 0;
+
+/* Connection events the device attends per second, peripheral latency skipping the others */
+static uint32_t wakeups_per_s(void) {
+    uint32_t period_us = interval * LINK_INTERVAL_UNIT_US * (1 + latency);
+    return period_us ? 1000000 / period_us : 0;
+}
+
+static void request_mode(uint8_t want, int64_t now_us) {
+    const link_params_t* params = &mode_params[want];
+    esp_ble_conn_update_params_t update = {
+        .min_int = params->min_interval,
+        .max_int = params->max_interval,
+        .latency = params->latency,
+        .timeout = params->timeout,
+    };
+    memcpy(update.bda, peer_bda, sizeof(esp_bd_addr_t));
+    
+    requests++;
+    esp_err_t ret = esp_ble_gap_update_conn_params(&update);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot ask for %s parameters: %s", want == LINK_MODE_ACTIVE ? "active" : "idle",
+                 esp_err_to_name(ret));
+        rejected++;
+        retry_at_us = now_us + LINK_RETRY_MS * 1000LL;
+        return;
+    }
+    
+    ESP_LOGI(TAG, "Asking for %s parameters: interval %lu-%lu us, latency %d",
+             want == LINK_MODE_ACTIVE ? "active" : "idle",
+             (uint32_t)params->min_interval * LINK_INTERVAL_UNIT_US,
+             (uint32_t)params->max_interval * LINK_INTERVAL_UNIT_US, params->latency);
+    mode = want;
+    pending = true;
+    pending_since_us = now_us;
+}
+
+void armdeck_link_activity(int64_t now_us) {
+    last_activity_us = now_us;
+}
+
+int64_t armdeck_link_poll(int64_t now_us) {
+    if (!connected) {
+        mode = LINK_MODE_NONE;
+        return 0;
+    }
+    
+    if (connect_seen) {
+        connect_seen = false;
+        mode = LINK_MODE_NONE;
+        retry_at_us = now_us + LINK_SETTLE_MS * 1000LL;
+    }
+    if (refused) {
+        /* The host keeps its parameters: leave it alone for a while */
+        refused = false;
+        mode = LINK_MODE_NONE;
+        retry_at_us = now_us + LINK_RETRY_MS * 1000LL;
+    }
+    if (pending && now_us - pending_since_us > LINK_PENDING_TIMEOUT_MS * 1000LL) {
+        ESP_LOGW(TAG, "Parameter update unanswered");
+        pending = false;
+        mode = LINK_MODE_NONE;
+    }
+    
+    uint8_t want = now_us - last_activity_us < LINK_IDLE_AFTER_MS * 1000LL ? LINK_MODE_ACTIVE : LINK_MODE_IDLE;
+    if (want != mode && !pending && now_us >= retry_at_us) {
+        request_mode(want, now_us);
+    }
+    
+    /* Wake up to go idle, and until the wanted mode is asked for */
+    int64_t next_us = want == LINK_MODE_ACTIVE ? last_activity_us + LINK_IDLE_AFTER_MS * 1000LL : 0;
+    if (want != mode) {
+        int64_t retry_us = pending ? now_us + LINK_RECHECK_US : retry_at_us;
+        if (next_us == 0 || retry_us < next_us) {
+            next_us = retry_us;
+        }
+    }
+    return next_us;
+}
+
+void armdeck_link_connected(const esp_bd_addr_t bda, uint16_t conn_interval, uint16_t conn_latency,
+                            uint16_t conn_timeout) {
+    memcpy(peer_bda, bda, sizeof(esp_bd_addr_t));
+    interval = conn_interval;
+    latency = conn_latency;
+    timeout = conn_timeout;
+    pending = false;
+    refused = false;
+    connect_seen = true;
+    connected = true;
+    armdeck_link_log_stats();
+}
+
+void armdeck_link_disconnected(void) {
+    connected = false;
+    pending = false;
+    interval = 0;
+    latency = 0;
+    timeout = 0;
+}
+
+void armdeck_link_params_updated(bool success, uint16_t conn_interval, uint16_t conn_latency,
+                                 uint16_t conn_timeout) {
+    /* Host initiated updates come here too, with no request pending */
+    if (!success) {
+        rejected++;
+        refused = pending;
+        pending = false;
+        ESP_LOGW(TAG, "Parameter update refused");
+        return;
+    }
+    
+    interval = conn_interval;
+    latency = conn_latency;
+    timeout = conn_timeout;
+    pending = false;
+    accepted++;
+    armdeck_link_log_stats();
+}
+
+esp_err_t armdeck_link_get_info(armdeck_link_info_t* info) {
+    if (!info) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    *info = (armdeck_link_info_t){
+        .connected = connected,
+        .mode = mode,
+        .pending = pending,
+        .interval_us = interval * LINK_INTERVAL_UNIT_US,
+        .latency = latency,
+        .timeout_ms = timeout * LINK_TIMEOUT_UNIT_MS,
+        .wakeups_per_s = wakeups_per_s(),
+        .requests = requests,
+        .accepted = accepted,
+        .rejected = rejected,
+    };
+    return ESP_OK;
+}
+
+void armdeck_link_log_stats(void) {
+    if (!connected) {
+        ESP_LOGI(TAG, "Link: not connected | updates asked=%lu accepted=%lu rejected=%lu",
+                 requests, accepted, rejected);
+        return;
+    }
+    
+    /* A report waits at most one interval for its connection event; peripheral latency
+     * only lets the device skip events with nothing to send, so it costs no key latency */
+    uint32_t interval_us = interval * LINK_INTERVAL_UNIT_US;
+    ESP_LOGI(TAG, "Link: %s | interval %lu.%02lu ms, latency %d, timeout %d ms -> key latency up to %lu.%02lu ms, %lu wake-ups/s idle | updates asked=%lu accepted=%lu rejected=%lu",
+             mode == LINK_MODE_ACTIVE ? "active" : (mode == LINK_MODE_IDLE ? "idle" : "host"),
+             interval_us / 1000, (interval_us % 1000) / 10, latency, timeout * LINK_TIMEOUT_UNIT_MS,
+             interval_us / 1000, (interval_us % 1000) / 10, wakeups_per_s(),
+             requests, accepted, rejected);
+}
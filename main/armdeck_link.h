@@ -0,0 +1,44 @@
+#ifndef ARMDECK_LINK_H
+#define ARMDECK_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_bt_defs.h"
+#include "armdeck_protocol.h"
+
+/* Connection parameters asked per mode, in controller units (1.25 ms intervals, 10 ms timeouts) */
+#define LINK_ACTIVE_MIN_INTERVAL    6       // 7.5 ms, the BLE minimum
+#define LINK_ACTIVE_MAX_INTERVAL    12      // 15 ms, for hosts that refuse 7.5 ms
+#define LINK_ACTIVE_LATENCY         0
+#define LINK_ACTIVE_TIMEOUT         400     // 4 s
+#define LINK_IDLE_MIN_INTERVAL      48      // 60 ms
+#define LINK_IDLE_MAX_INTERVAL      64      // 80 ms
+#define LINK_IDLE_LATENCY           4       // Up to 4 skipped events: a wake-up every 400 ms at most
+#define LINK_IDLE_TIMEOUT           600     // 6 s, above (1 + latency) * interval * 2
+
+/* Policy timings */
+#define LINK_IDLE_AFTER_MS          2000    // No key, macro or motion for this long: go idle
+#define LINK_SETTLE_MS              5000    // No request this soon after connecting (discovery, pairing)
+#define LINK_RETRY_MS               30000   // Wait after a refused update before asking again
+#define LINK_PENDING_TIMEOUT_MS     5000    // Update with no answer, considered lost
+
+/* Key or engine activity (dispatch task): keeps or brings the link to LINK_MODE_ACTIVE */
+void armdeck_link_activity(int64_t now_us);
+
+/* Ask for the parameters of the mode activity calls for (dispatch task, after each
+ * batch of events). Returns the next deadline (esp_timer time) or 0 for none. */
+int64_t armdeck_link_poll(int64_t now_us);
+
+/* Connection events (BLE stack task), parameters in controller units */
+void armdeck_link_connected(const esp_bd_addr_t bda, uint16_t interval, uint16_t latency, uint16_t timeout);
+void armdeck_link_disconnected(void);
+void armdeck_link_params_updated(bool success, uint16_t interval, uint16_t latency, uint16_t timeout);
+
+/* Get negotiated parameters, policy mode and update counters */
+esp_err_t armdeck_link_get_info(armdeck_link_info_t* info);
+
+/* Log negotiated parameters and their latency and power cost */
+void armdeck_link_log_stats(void);
+
+#endif /* ARMDECK_LINK_H */
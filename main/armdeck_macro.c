@@ -0,0 +1,268 @@
+#include "armdeck_macro.h"
+#include "armdeck_config.h"
+#include "armdeck_hid.h"
+#include "armdeck_layout.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char* TAG = "ARMDECK_MACRO";
+
+
+/* Keys and usages a macro can hold down at once, released if it is cancelled */
+#define MACRO_MAX_HELD                      8
+
+/* No REPEAT in progress */
+#define MACRO_NO_LOOP                       0xFF
+
+typedef struct {
+    bool active;
+    uint8_t owner;
+    uint8_t macro_id;
+    uint8_t length;
+    uint8_t code[ARMDECK_MACRO_MAX_LEN];    // Bytecode latched at the start
+    uint8_t pc;                             // Next step
+    bool tap_down;                          // TAP or CONSUMER step: down sent, up next
+    uint8_t loop_start;                     // First step repeated by the next REPEAT
+    uint8_t loop_pc;                        // REPEAT in progress, MACRO_NO_LOOP if none
+    uint8_t loop_left;                      // Repeats left for it
+    uint8_t layout;                         // TEXT_LAYOUT_* latched at the start
+    uint8_t text_pos;                       // TEXT step: next text byte to decode
+    armdeck_layout_keys_t text_keys;        // TEXT step: keystrokes of the current character
+    uint8_t text_stroke;                    // TEXT step: next of them
+    armdeck_action_def_t text_down;         // TEXT step: keystroke down, ACTION_NONE if none
+    int64_t deadline_us;                    // Next step
+    armdeck_action_def_t held[MACRO_MAX_HELD];  // Pressed by this macro, not released yet
+    uint8_t num_held;
+} macro_player_t;
+
+static macro_player_t players[MACRO_MAX_PLAYERS];
+static uint8_t next_player = 0;             // Round robin start, so no macro starves the others
+
+static armdeck_macro_cb_t macro_output = NULL;
+
+esp_err_t armdeck_macro_init(armdeck_macro_cb_t output) {
+    memset(players, 0, sizeof(players));
+    next_player = 0;
+    macro_output = output;
+    return ESP_OK;
+}
+
+static void press(macro_player_t* player, const armdeck_action_def_t* action) {
+    if (player->num_held >= MACRO_MAX_HELD) {
+        ESP_LOGW(TAG, "Macro %d holds too many keys, step ignored", player->macro_id);
+        return;
+    }
+    player->held[player->num_held++] = *action;
+    macro_output(action, true);
+}
+
+static void release(macro_player_t* player, const armdeck_action_def_t* action) {
+    for (int i = 0; i < player->num_held; i++) {
+        if (memcmp(&player->held[i], action, sizeof(*action)) == 0) {
+            player->num_held--;
+            memmove(&player->held[i], &player->held[i + 1], (player->num_held - i) * sizeof(*action));
+            macro_output(action, false);
+            return;
+        }
+    }
+}
+
+/* Release what the macro still holds and free the player */
+static void stop(macro_player_t* player) {
+    while (player->num_held > 0) {
+        macro_output(&player->held[--player->num_held], false);
+    }
+    player->active = false;
+}
+
+void armdeck_macro_trigger(uint8_t owner, uint8_t macro_id) {
+    for (int i = 0; i < MACRO_MAX_PLAYERS; i++) {
+        if (players[i].active && players[i].owner == owner) {
+            ESP_LOGI(TAG, "Macro %d cancelled", players[i].macro_id);
+            stop(&players[i]);
+            return;
+        }
+    }
+    
+    const armdeck_macro_t* macro = armdeck_config_get_macro(macro_id);
+    if (!macro || macro->length == 0) {
+        ESP_LOGW(TAG, "Macro %d is empty", macro_id);
+        return;
+    }
+    if (!armdeck_hid_is_connected()) {
+        return;
+    }
+    
+    for (int i = 0; i < MACRO_MAX_PLAYERS; i++) {
+        macro_player_t* player = &players[i];
+        if (!player->active) {
+            *player = (macro_player_t){
+                .active = true,
+                .owner = owner,
+                .macro_id = macro_id,
+                .length = macro->length,
+                .loop_pc = MACRO_NO_LOOP,
+                .layout = armdeck_config_get_settings()->text_layout,
+                .deadline_us = esp_timer_get_time(),
+            };
+            memcpy(player->code, macro->code, macro->length);
+            ESP_LOGI(TAG, "Macro %d started (%d bytes)", macro_id, macro->length);
+            return;
+        }
+    }
+    
+    ESP_LOGW(TAG, "All %d macro players busy, macro %d not started", MACRO_MAX_PLAYERS, macro_id);
+}
+
+/* Next keystroke of the TEXT step at pc, decoding the text as needed. Characters
+ * the layout has no key for are skipped. Returns NULL once the text is typed. */
+static const armdeck_action_def_t* next_text_stroke(macro_player_t* player) {
+    const uint8_t* text = &player->code[player->pc + 2];
+    uint8_t len = player->code[player->pc + 1];
+    
+    while (player->text_stroke >= player->text_keys.count) {
+        if (player->text_pos >= len) {
+            return NULL;
+        }
+        uint32_t codepoint = armdeck_layout_decode_utf8(text, len, &player->text_pos);
+        player->text_stroke = 0;
+        if (!armdeck_layout_translate(player->layout, codepoint, &player->text_keys)) {
+            ESP_LOGW(TAG, "Macro %d: U+%04lX has no key on layout %d, skipped",
+                     player->macro_id, codepoint, player->layout);
+        }
+    }
+    return &player->text_keys.strokes[player->text_stroke];
+}
+
+/* Run steps up to the first one that sends a report. Returns true if it sent one. */
+static bool run_steps(macro_player_t* player, int64_t now_us) {
+    while (player->active && player->pc < player->length) {
+        const uint8_t* step = &player->code[player->pc];
+        armdeck_action_def_t action = { .action_type = ACTION_KEY, .key_code = step[1], .modifier = step[2] };
+        
+        switch (step[0]) {
+            case MACRO_OP_PRESS:
+                player->pc += 3;
+                press(player, &action);
+                return true;
+                
+            case MACRO_OP_RELEASE:
+                player->pc += 3;
+                release(player, &action);
+                return true;
+                
+            case MACRO_OP_CONSUMER:
+                action.action_type = ACTION_MEDIA;
+                /* fall through: a consumer usage is a tap of its ACTION_MEDIA action */
+            case MACRO_OP_TAP:
+                /* Down and up go in separate reports so the host sees the press */
+                if (!player->tap_down) {
+                    player->tap_down = true;
+                    press(player, &action);
+                } else {
+                    player->tap_down = false;
+                    player->pc += 3;
+                    release(player, &action);
+                }
+                return true;
+                
+            case MACRO_OP_TEXT: {
+                /* One report per keystroke: the previous key goes up in the report that
+                 * presses the next one, unless they share a key or modifier, which would
+                 * hide the transition from the host and takes a report of its own */
+                const armdeck_action_def_t* next = next_text_stroke(player);
+                bool sent = false;
+                if (player->text_down.action_type != ACTION_NONE) {
+                    armdeck_action_def_t down = player->text_down;
+                    player->text_down.action_type = ACTION_NONE;
+                    release(player, &down);
+                    sent = true;
+                    if (next && (next->key_code == down.key_code || (next->modifier & down.modifier))) {
+                        return true;
+                    }
+                }
+                if (next) {
+                    player->text_down = *next;
+                    player->text_stroke++;
+                    press(player, next);
+                    return true;
+                }
+                
+                player->pc += 2 + step[1];
+                player->text_pos = 0;
+                player->text_stroke = 0;
+                player->text_keys.count = 0;
+                if (sent) {
+                    return true;
+                }
+                break;
+            }
+                
+            case MACRO_OP_DELAY:
+                player->pc += 3;
+                player->deadline_us = now_us + (step[1] | (step[2] << 8)) * 1000LL;
+                return false;
+                
+            case MACRO_OP_REPEAT:
+                if (player->loop_pc != player->pc) {
+                    player->loop_pc = player->pc;
+                    player->loop_left = step[1];
+                }
+                if (player->loop_left > 0) {
+                    player->loop_left--;
+                    player->pc = player->loop_start;
+                } else {
+                    player->pc += 2;
+                    player->loop_start = player->pc;
+                    player->loop_pc = MACRO_NO_LOOP;
+                }
+                break;
+                
+            default:    /* MACRO_OP_END */
+                player->pc = player->length;
+                break;
+        }
+    }
+    
+    ESP_LOGI(TAG, "Macro %d done", player->macro_id);
+    stop(player);
+    return false;
+}
+
+int64_t armdeck_macro_poll(int64_t now_us) {
+    /* One report per connection event, and none while reports still wait for the link */
+    int64_t link_free_us = armdeck_hid_link_free_us(now_us);
+    
+    bool connected = armdeck_hid_is_connected();
+    int64_t next_us = 0;
+    for (int n = 0; n < MACRO_MAX_PLAYERS; n++) {
+        uint8_t i = (next_player + n) % MACRO_MAX_PLAYERS;
+        macro_player_t* player = &players[i];
+        if (!player->active) {
+            continue;
+        }
+        if (!connected) {
+            ESP_LOGI(TAG, "Macro %d stopped, link lost", player->macro_id);
+            stop(player);
+            continue;
+        }
+        
+        if (now_us >= player->deadline_us && now_us >= link_free_us) {
+            if (run_steps(player, now_us)) {
+                armdeck_hid_link_take(now_us, 1);
+                link_free_us = armdeck_hid_link_free_us(now_us);
+                next_player = (i + 1) % MACRO_MAX_PLAYERS;
+            }
+        }
+        
+        if (player->active) {
+            int64_t due_us = player->deadline_us > link_free_us ? player->deadline_us : link_free_us;
+            if (next_us == 0 || due_us < next_us) {
+                next_us = due_us;
+            }
+        }
+    }
+    
+    return next_us;
+}
@@ -0,0 +1,30 @@
+#ifndef ARMDECK_MACRO_H
+#define ARMDECK_MACRO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "armdeck_protocol.h"
+
+/* Macros running at once, each on its own player */
+#define MACRO_MAX_PLAYERS           4
+
+/* Macro owners: buttons use their ID, combos MACRO_OWNER_COMBO + combo ID */
+#define MACRO_OWNER_COMBO           ARMDECK_MAX_BUTTONS
+
+/* Macro output: a step presses or releases an ACTION_KEY or ACTION_MEDIA action */
+typedef void (*armdeck_macro_cb_t)(const armdeck_action_def_t* action, bool pressed);
+
+/* Stop all players and set the output (before armdeck_dispatch_init) */
+esp_err_t armdeck_macro_init(armdeck_macro_cb_t output);
+
+/* An ACTION_MACRO went down (dispatch task): starts the macro on a free player, or
+ * cancels the owner's macro if it is still running. The macro plays to its end
+ * whatever the owner does next. */
+void armdeck_macro_trigger(uint8_t owner, uint8_t macro_id);
+
+/* Run due macro steps (dispatch task). Returns the next step time
+ * (esp_timer time) or 0 when no macro runs. */
+int64_t armdeck_macro_poll(int64_t now_us);
+
+#endif /* ARMDECK_MACRO_H */
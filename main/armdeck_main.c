@@ -19,8 +19,17 @@
 #include "armdeck_config.h"
 #include "armdeck_ble.h"
 #include "armdeck_hid.h"
+#include "armdeck_keyboard.h"
+#include "armdeck_button_table.h"
 #include "armdeck_service.h"
 #include "button_matrix.h"
+#include "armdeck_dispatch.h"
+#include "armdeck_gesture.h"
+#include "armdeck_combo.h"
+#include "armdeck_repeat.h"
+#include "armdeck_macro.h"
+#include "armdeck_mouse.h"
+#include "armdeck_link.h"
 #include "armdeck_protocol.h"
 #include "power_button.h"
 
@@ -34,19 +43,41 @@ bool ble_connected = false;
 uint16_t hid_conn_id = 0;
 esp_timer_handle_t keep_alive_timer = NULL;
 
-/* Keep-alive timer period (15 seconds) */
-#define KEEP_ALIVE_PERIOD_US (15ULL * 1000 * 1000)
+/* Keep-alive idle period from the settings, 0 = off */
+static volatile uint64_t keep_alive_period_us = KEEP_ALIVE_DEFAULT_S * 1000000ULL;
+
+/* Keep-alive counters (keep-alive timer only) */
+static uint32_t keep_alives_sent = 0;
+static uint32_t keep_alives_avoided = 0;    // Expiries that found real traffic and sent nothing
 
 /* Keep-alive implementation */
 void send_hid_keep_alive(void) {
+    /* Resends the cached last report: held keys stay held on the host */
     if (armdeck_hid_is_connected()) {
-        armdeck_hid_send_empty();
+        armdeck_hid_send_keep_alive();
+        keep_alives_sent++;
         ESP_LOGD(TAG, "Keep-alive sent");
     }
 }
 
+/* One-shot timer: a keep-alive only goes out after a whole period without any report.
+ * Reports sent meanwhile push the next expiry back instead of restarting the timer
+ * on every report. */
 static void keep_alive_timer_callback(void *arg) {
+    uint64_t period_us = keep_alive_period_us;
+    if (period_us == 0) {
+        return;
+    }
+    
+    int64_t idle_us = esp_timer_get_time() - armdeck_hid_get_last_report_us();
+    if (idle_us >= 0 && (uint64_t)idle_us < period_us) {
+        keep_alives_avoided++;
+        esp_timer_start_once(keep_alive_timer, period_us - idle_us);
+        return;
+    }
+    
     send_hid_keep_alive();
+    esp_timer_start_once(keep_alive_timer, period_us);
 }
 
 void start_keep_alive(void) {
@@ -59,8 +90,12 @@ void start_keep_alive(void) {
     }
     
     esp_timer_stop(keep_alive_timer);
-    esp_timer_start_periodic(keep_alive_timer, KEEP_ALIVE_PERIOD_US);
-    ESP_LOGI(TAG, "Keep-alive timer started");
+    if (keep_alive_period_us == 0) {
+        ESP_LOGI(TAG, "Keep-alive off");
+        return;
+    }
+    esp_timer_start_once(keep_alive_timer, keep_alive_period_us);
+    ESP_LOGI(TAG, "Keep-alive timer started (%llu s idle)", keep_alive_period_us / 1000000);
 }
 
 void stop_keep_alive(void) {
@@ -96,51 +131,182 @@ void armdeck_main_set_connected(bool connected, uint16_t conn_id) {
     }
 }
 
-/* Button event handler */
-static void handle_button_event(uint8_t button_id, bool pressed) {
-    const armdeck_button_t* button = armdeck_protocol_get_button_config(button_id);
-    if (!button) {
-        ESP_LOGE(TAG, "Invalid button ID: %d", button_id);
-        return;
-    }
+/* Push stored scan/debounce settings to the matrix and the keyboard report mode */
+static void apply_settings(void) {
+    const armdeck_settings_t* settings = armdeck_config_get_settings();
     
-    ESP_LOGI(TAG, "Button %d (%s) %s", 
-             button_id + 1, button->label, pressed ? "pressed" : "released");
+    debounce_config_t debounce = {
+        .algo = settings->debounce_algo,
+        .press_ms = settings->debounce_press_ms,
+        .release_ms = settings->debounce_release_ms
+    };
     
+    armdeck_matrix_set_scan_mode(settings->scan_mode);
+    armdeck_matrix_set_scan_rate(settings->scan_rate_hz ? settings->scan_rate_hz : SCAN_DEFAULT_RATE_HZ);
+    if (armdeck_matrix_set_debounce(&debounce) != ESP_OK) {
+        ESP_LOGW(TAG, "Invalid debounce settings, keeping current ones");
+    }
+    armdeck_keyboard_set_mode(settings->keyboard_mode);
+    
+    uint64_t period_us = settings->keep_alive_s * 1000000ULL;
+    if (period_us != keep_alive_period_us) {
+        keep_alive_period_us = period_us;
+        if (ble_connected) {
+            start_keep_alive();
+        }
+    }
+}
+
+/* Log keep-alives sent and the transmissions a fixed period would have added */
+static void log_keep_alive_stats(void) {
+    ESP_LOGI(TAG, "Keep-alive: %s | sent=%lu avoided=%lu",
+             keep_alive_period_us ? "on" : "off", keep_alives_sent, keep_alives_avoided);
+}
+
+/* Configuration change handler */
+static void config_changed_handler(armdeck_config_change_t change) {
+    if (change == ARMDECK_CONFIG_CHANGED_SETTINGS) {
+        apply_settings();
+    } else if (change == ARMDECK_CONFIG_CHANGED_BUTTONS) {
+        armdeck_button_table_reload();
+    } else if (change == ARMDECK_CONFIG_CHANGED_COMBOS) {
+        armdeck_combo_reload();
+    }
+}
+
+/* Send the HID report of an action (dispatch task) */
+static void run_action(const armdeck_action_def_t* action, bool pressed) {
     if (!armdeck_hid_is_connected()) {
         ESP_LOGW(TAG, "HID not connected, ignoring button event");
+        
+        /* Still drop released keys from the held state so they do not come back on reconnect */
+        if (action->action_type == ACTION_KEY && !pressed) {
+            armdeck_keyboard_release(action->key_code, action->modifier);
+        } else if (action->action_type == ACTION_MEDIA && !pressed) {
+            armdeck_keyboard_consumer(ACTION_MEDIA_USAGE(action->key_code, action->modifier), false);
+        } else if (action->action_type >= ACTION_MOUSE_BUTTON && !pressed) {
+            armdeck_mouse_release(action);
+        }
         return;
     }
       /* Send HID report based on action type */
-    switch (button->action_type) {
+    switch (action->action_type) {
         case ACTION_NONE:
             ESP_LOGI(TAG, "Button disabled (ACTION_NONE), ignoring");
             break;
             
         case ACTION_KEY:
-            armdeck_hid_send_key(button->key_code, button->modifier, pressed);
+            if (pressed) {
+                armdeck_keyboard_press(action->key_code, action->modifier);
+            } else {
+                armdeck_keyboard_release(action->key_code, action->modifier);
+            }
             break;
             
         case ACTION_MEDIA:
-            armdeck_hid_send_consumer(button->key_code, pressed);
+            armdeck_keyboard_consumer(ACTION_MEDIA_USAGE(action->key_code, action->modifier), pressed);
             break;
             
         case ACTION_MACRO:
-            /* TODO: Implement macro support */
-            ESP_LOGW(TAG, "Macro not implemented yet");
+            /* Started by the button and combo handlers, which know the macro owner */
+            break;
+            
+        case ACTION_MOUSE_BUTTON:
+        case ACTION_MOUSE_MOVE:
+        case ACTION_MOUSE_WHEEL:
+            if (pressed) {
+                armdeck_mouse_press(action);
+            } else {
+                armdeck_mouse_release(action);
+            }
             break;
             
         default:
-            ESP_LOGW(TAG, "Unknown action type: %d", button->action_type);
+            ESP_LOGW(TAG, "Unknown action type: %d", action->action_type);
             break;
     }
 }
 
+/* Button gesture handler (runs in the dispatch task, off the scan path) */
+static void handle_button_event(uint8_t button_id, armdeck_gesture_t gesture, bool pressed) {
+    static const char* gesture_names[] = { "tap", "hold", "double tap" };
+    const armdeck_button_entry_t* entry = armdeck_button_table_get(button_id);
+    if (!entry) {
+        ESP_LOGE(TAG, "Invalid button ID: %d", button_id);
+        return;
+    }
+    
+    /* Tap, hold and double tap actions are compiled per button on config changes */
+    const armdeck_action_def_t* action = &entry->actions[gesture];
+    
+    ESP_LOGI(TAG, "Button %d (%s) %s %s", 
+             button_id + 1, entry->label, gesture_names[gesture], pressed ? "pressed" : "released");
+    
+    if (action->action_type == ACTION_MACRO && pressed) {
+        armdeck_macro_trigger(button_id, action->key_code);
+    }
+    run_action(action, pressed);
+    
+    /* The action held down (tap, hold or double tap) can auto-repeat, combos do not */
+    if (pressed) {
+        armdeck_repeat_start(button_id, action, &entry->ext);
+    } else {
+        armdeck_repeat_stop(button_id);
+    }
+}
+
+/* Combo handler (dispatch task) */
+static void handle_combo_event(uint8_t combo_id, const armdeck_action_def_t* action, bool pressed) {
+    ESP_LOGI(TAG, "Combo %d %s", combo_id + 1, pressed ? "pressed" : "released");
+    if (action->action_type == ACTION_MACRO && pressed) {
+        armdeck_macro_trigger(MACRO_OWNER_COMBO + combo_id, action->key_code);
+    }
+    run_action(action, pressed);
+}
+
+/* Matrix events (dispatch task): every key change is link activity */
+static void handle_matrix_event(uint8_t button_id, bool pressed) {
+    armdeck_link_activity(esp_timer_get_time());
+    armdeck_combo_handle_event(button_id, pressed);
+}
+
+/* Earliest of two deadlines, 0 = none */
+static int64_t earliest_deadline(int64_t a_us, int64_t b_us) {
+    if (a_us == 0 || (b_us != 0 && b_us < a_us)) {
+        return b_us;
+    }
+    return a_us;
+}
+
+/* Deadlines of the key engines, earliest first (dispatch task). Runs after every
+ * batch of events, so the key changes of the batch leave as one report per type. */
+static int64_t poll_key_engines(int64_t now_us) {
+    /* Combos first: a resolved combo window can start gestures, which can start repeats */
+    int64_t next_us = armdeck_combo_poll(now_us);
+    next_us = earliest_deadline(next_us, armdeck_gesture_poll(now_us));
+    next_us = earliest_deadline(next_us, armdeck_repeat_poll(now_us));
+    next_us = earliest_deadline(next_us, armdeck_macro_poll(now_us));
+    next_us = earliest_deadline(next_us, armdeck_mouse_poll(now_us));
+    
+    armdeck_keyboard_flush();
+    
+    /* Running engines and held keys keep the link fast like key events do. After the
+     * flush, so a parameter request never delays the batch's reports. */
+    if (next_us != 0 || !armdeck_keyboard_is_idle()) {
+        armdeck_link_activity(now_us);
+    }
+    next_us = earliest_deadline(next_us, armdeck_link_poll(now_us));
+    return next_us;
+}
+
 /* HID event handler */
 static void hid_event_handler(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *param) {
     switch(event) {
         case ESP_HIDD_EVENT_BLE_CONNECT:
             armdeck_main_set_connected(true, param->connect.conn_id);
+            /* The held state goes out at once, keys held across the reconnect stay held */
+            armdeck_keyboard_resync();
+            armdeck_dispatch_wake();
             ESP_LOGI(TAG, "Device connected and ready!");
             break;
               case ESP_HIDD_EVENT_BLE_DISCONNECT:
@@ -157,55 +323,6 @@ static void hid_event_handler(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *pa
     }
 }
 
-/* GATTS event handler for custom service */
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, 
-                               esp_ble_gatts_cb_param_t *param) {
-    static uint16_t command_handle = 0;
-    
-    switch (event) {
-        case ESP_GATTS_WRITE_EVT:
-            if (param->write.handle == command_handle && param->write.len > 0) {
-                ESP_LOGI(TAG, "Command received (%d bytes)", param->write.len);
-                
-                uint8_t response[256];
-                uint16_t response_len = 0;
-                
-                /* Handle command using protocol module */
-                esp_err_t ret = armdeck_protocol_handle_command(
-                    param->write.value, param->write.len,
-                    response, &response_len
-                );
-                
-                if (ret == ESP_OK && response_len > 0) {
-                    /* Send response via notification */
-                    esp_ble_gatts_send_indicate(gatts_if, param->write.conn_id, 
-                                               command_handle, response_len, 
-                                               response, false);
-                }
-            }
-            
-            if (param->write.need_rsp) {
-                esp_ble_gatts_send_response(gatts_if, param->write.conn_id, 
-                                           param->write.trans_id, ESP_GATT_OK, NULL);
-            }
-            break;
-            
-        case ESP_GATTS_ADD_CHAR_EVT:
-            /* Store command characteristic handle */
-            if (param->add_char.char_uuid.len == ESP_UUID_LEN_128) {
-                uint8_t command_uuid[16] = ARMDECK_COMMAND_CHAR_UUID128;
-                if (memcmp(param->add_char.char_uuid.uuid.uuid128, command_uuid, 16) == 0) {
-                    command_handle = param->add_char.attr_handle;
-                    ESP_LOGI(TAG, "Command characteristic handle: %d", command_handle);
-                }
-            }
-            break;
-            
-        default:
-            break;
-    }
-}
-
 /* GAP event handler */
 static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
     switch (event) {
@@ -248,6 +365,15 @@ static void status_task(void *pvParameters) {
             armdeck_ble_start_advertising();
         }
         
+        /* Matrix press-to-callback latency per scan mode, scan cost and timing */
+        armdeck_matrix_log_latency();
+        armdeck_dispatch_log_stats();
+        armdeck_keyboard_log_stats();
+        armdeck_hid_log_stats();
+        log_keep_alive_stats();
+        armdeck_link_log_stats();
+        armdeck_service_log_stats();
+        
         /* Check power switch state */
         power_button_check_state();
         
@@ -259,7 +385,6 @@ void app_main(void) {
     esp_err_t ret;
       ESP_LOGI(TAG, "=== ArmDeck Stream Deck Starting ===");
     ESP_LOGI(TAG, "Version: 1.2.0");
-    ESP_LOGI(TAG, "Buttons: 5x3 matrix (15 total)");
     
     /* Initialize NVS */
     ret = nvs_flash_init();
@@ -295,16 +420,38 @@ void app_main(void) {
     esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(uint8_t));
       /* Initialize modules */
     ESP_ERROR_CHECK(armdeck_config_init());
-    ESP_ERROR_CHECK(armdeck_matrix_init());
+    
+    const armdeck_geometry_t* geometry = armdeck_config_get_geometry();
+    ESP_LOGI(TAG, "Buttons: %dx%d matrix (%d total)",
+             geometry->cols, geometry->rows, armdeck_config_get_num_buttons());
+    ESP_ERROR_CHECK(armdeck_matrix_init(geometry->rows, geometry->cols,
+                                        geometry->row_pins, geometry->col_pins));
     ESP_ERROR_CHECK(armdeck_hid_init());
     ESP_ERROR_CHECK(armdeck_ble_init());
     ESP_ERROR_CHECK(power_button_init());
+    ESP_ERROR_CHECK(armdeck_button_table_init());
+    ESP_ERROR_CHECK(armdeck_repeat_init(run_action));
+    ESP_ERROR_CHECK(armdeck_macro_init(run_action));
+    ESP_ERROR_CHECK(armdeck_gesture_init(handle_button_event));
+    ESP_ERROR_CHECK(armdeck_combo_init(armdeck_gesture_handle_event, handle_combo_event));
+    ESP_ERROR_CHECK(armdeck_dispatch_init(handle_matrix_event, poll_key_engines));
     
+    /* Apply stored settings */
+    apply_settings();
+
+#ifdef ARMDECK_MATRIX_BENCHMARK
+    armdeck_matrix_benchmark(1000);
+#endif
+#ifdef ARMDECK_PRESS_BENCHMARK
+    armdeck_button_table_benchmark(1000);
+    esp_hidd_benchmark_report_lookup(1000);
+#endif
+
     /* Register callbacks */
-    armdeck_matrix_set_callback(handle_button_event);
+    armdeck_config_register_listener(config_changed_handler);
+    armdeck_matrix_set_callback(armdeck_dispatch_post);
     armdeck_hid_register_callback(hid_event_handler);
     armdeck_ble_register_gap_callback(gap_event_handler);
-    armdeck_ble_register_gatts_callback(gatts_event_handler);
     power_button_set_callback(power_button_event_handler);    /* Start services selon l'état du switch power */
     if (power_button_get_state() == POWER_STATE_ON) {
         ESP_LOGI(TAG, "Switch ON - Démarrage des services");
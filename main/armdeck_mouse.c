@@ -0,0 +1,192 @@
+#include "armdeck_mouse.h"
+#include "armdeck_ble.h"
+#include "armdeck_hid.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char* TAG = "ARMDECK_MOUSE";
+
+/* Motion time one report can catch up after the link was busy, in connection intervals.
+ * Longer stalls drop the motion instead of jumping the pointer. */
+#define MOUSE_MAX_CATCH_UP_INTERVALS        2
+
+/* Fixed point: motion is accumulated in 1/65536 counts */
+#define Q16_ONE                             65536
+
+/* Report motion range */
+#define MOUSE_MAX_COUNTS                    127
+
+/* Motion axes */
+enum { AXIS_X, AXIS_Y, AXIS_WHEEL, AXIS_COUNT };
+
+typedef struct {
+    armdeck_action_def_t action;
+    int64_t pressed_us;                     // Start of its acceleration curve
+} mouse_motion_t;
+
+/* Held state (dispatch task) */
+static uint8_t button_counts[3];
+static mouse_motion_t motions[MOUSE_MAX_HELD_MOTIONS];
+static uint8_t num_motions = 0;
+
+static uint8_t reported_buttons = 0;        // Buttons in the last report
+static uint8_t touched_buttons = 0;         // Buttons changed since the last report
+static int32_t remainder_q16[AXIS_COUNT];   // Sub-count motion carried to the next report
+static int64_t motion_us = 0;               // Time motion is accounted up to
+
+static uint8_t button_mask(void) {
+    uint8_t mask = 0;
+    for (int i = 0; i < 3; i++) {
+        if (button_counts[i]) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
+
+/* A button changing twice before the poll (a tap within one batch) would cancel out:
+ * send the pending state first so the host sees both edges */
+static void touch_button(int button) {
+    uint8_t bit = 1 << button;
+    if (touched_buttons & bit) {
+        reported_buttons = button_mask();
+        armdeck_hid_send_mouse(reported_buttons, 0, 0, 0);
+        touched_buttons = 0;
+    }
+    touched_buttons |= bit;
+}
+
+void armdeck_mouse_press(const armdeck_action_def_t* action) {
+    if (action->action_type == ACTION_MOUSE_BUTTON) {
+        for (int i = 0; i < 3; i++) {
+            if (action->key_code & (1 << i)) {
+                if (button_counts[i] == 0) {
+                    touch_button(i);
+                }
+                button_counts[i]++;
+            }
+        }
+        return;
+    }
+    
+    if (num_motions >= MOUSE_MAX_HELD_MOTIONS) {
+        ESP_LOGW(TAG, "Too many pointer and wheel actions held, ignoring");
+        return;
+    }
+    
+    int64_t now_us = esp_timer_get_time();
+    if (num_motions == 0) {
+        /* Moving from rest: no leftover fraction, first report at the next poll */
+        memset(remainder_q16, 0, sizeof(remainder_q16));
+        motion_us = now_us;
+    }
+    motions[num_motions++] = (mouse_motion_t){ .action = *action, .pressed_us = now_us };
+}
+
+void armdeck_mouse_release(const armdeck_action_def_t* action) {
+    if (action->action_type == ACTION_MOUSE_BUTTON) {
+        for (int i = 0; i < 3; i++) {
+            if ((action->key_code & (1 << i)) && button_counts[i]) {
+                if (button_counts[i] == 1) {
+                    touch_button(i);
+                }
+                button_counts[i]--;
+            }
+        }
+        return;
+    }
+    
+    for (int i = 0; i < num_motions; i++) {
+        if (memcmp(&motions[i].action, action, sizeof(*action)) == 0) {
+            num_motions--;
+            memmove(&motions[i], &motions[i + 1], (num_motions - i) * sizeof(motions[0]));
+            return;
+        }
+    }
+}
+
+/* Fraction of the full speed after held_us, Q16: quadratic from MOUSE_START_PERCENT
+ * to all of it at accel_ms */
+static int64_t speed_fraction_q16(int64_t held_us, uint32_t accel_ms) {
+    const int64_t start_q16 = MOUSE_START_PERCENT * Q16_ONE / 100;
+    int64_t accel_us = accel_ms * 1000LL;
+    if (held_us >= accel_us) {
+        return Q16_ONE;
+    }
+    
+    int64_t ramp_q16 = held_us * Q16_ONE / accel_us;
+    return start_q16 + (((Q16_ONE - start_q16) * ((ramp_q16 * ramp_q16) >> 16)) >> 16);
+}
+
+/* Add elapsed_us of motion at counts_per_s, scaled by the curve, to an axis */
+static void accumulate(int axis, int32_t counts_per_s, int64_t fraction_q16, int64_t elapsed_us) {
+    remainder_q16[axis] += (int32_t)(counts_per_s * fraction_q16 * elapsed_us / 1000000);
+}
+
+/* Whole counts of an axis for this report, the fraction stays for the next one */
+static int8_t take_counts(int axis) {
+    int32_t counts = remainder_q16[axis] / Q16_ONE;
+    if (counts > MOUSE_MAX_COUNTS) {
+        counts = MOUSE_MAX_COUNTS;
+    } else if (counts < -MOUSE_MAX_COUNTS) {
+        counts = -MOUSE_MAX_COUNTS;
+    }
+    
+    /* Motion past the report range is dropped rather than owed */
+    remainder_q16[axis] -= counts * Q16_ONE;
+    if (remainder_q16[axis] >= Q16_ONE || remainder_q16[axis] <= -Q16_ONE) {
+        remainder_q16[axis] %= Q16_ONE;
+    }
+    return (int8_t)counts;
+}
+
+int64_t armdeck_mouse_poll(int64_t now_us) {
+    uint8_t buttons = button_mask();
+    if (num_motions == 0 && buttons == reported_buttons) {
+        touched_buttons = 0;
+        return 0;
+    }
+    
+    int8_t counts[AXIS_COUNT] = {0};
+    int64_t next_us = 0;
+    
+    if (num_motions > 0) {
+        /* One motion report per connection event, and none while reports still wait for the link */
+        int64_t link_free_us = armdeck_hid_link_free_us(now_us);
+        if (now_us >= link_free_us) {
+            int64_t step_cost_us = armdeck_ble_get_conn_interval_us();
+            int64_t elapsed_us = now_us - motion_us;
+            if (elapsed_us > step_cost_us * MOUSE_MAX_CATCH_UP_INTERVALS) {
+                elapsed_us = step_cost_us * MOUSE_MAX_CATCH_UP_INTERVALS;
+            }
+            motion_us = now_us;
+            
+            for (int i = 0; i < num_motions; i++) {
+                const armdeck_action_def_t* action = &motions[i].action;
+                int64_t held_us = now_us - motions[i].pressed_us;
+                if (action->action_type == ACTION_MOUSE_MOVE) {
+                    int64_t fraction_q16 = speed_fraction_q16(held_us, MOUSE_MOVE_ACCEL_MS);
+                    accumulate(AXIS_X, (int8_t)action->key_code * MOUSE_MOVE_UNIT_CPS, fraction_q16, elapsed_us);
+                    accumulate(AXIS_Y, (int8_t)action->modifier * MOUSE_MOVE_UNIT_CPS, fraction_q16, elapsed_us);
+                } else {
+                    int64_t fraction_q16 = speed_fraction_q16(held_us, MOUSE_WHEEL_ACCEL_MS);
+                    accumulate(AXIS_WHEEL, (int8_t)action->key_code, fraction_q16, elapsed_us);
+                }
+            }
+            for (int axis = 0; axis < AXIS_COUNT; axis++) {
+                counts[axis] = take_counts(axis);
+            }
+            armdeck_hid_link_take(now_us, 1);
+            link_free_us = armdeck_hid_link_free_us(now_us);
+        }
+        next_us = link_free_us;
+    }
+    
+    if (buttons != reported_buttons || counts[AXIS_X] || counts[AXIS_Y] || counts[AXIS_WHEEL]) {
+        armdeck_hid_send_mouse(buttons, counts[AXIS_X], counts[AXIS_Y], counts[AXIS_WHEEL]);
+        reported_buttons = buttons;
+    }
+    touched_buttons = 0;
+    return next_us;
+}
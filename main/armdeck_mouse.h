@@ -0,0 +1,26 @@
+#ifndef ARMDECK_MOUSE_H
+#define ARMDECK_MOUSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "armdeck_protocol.h"
+
+/* Most pointer and wheel actions held at once */
+#define MOUSE_MAX_HELD_MOTIONS      8
+
+/* Press an ACTION_MOUSE_BUTTON, ACTION_MOUSE_MOVE or ACTION_MOUSE_WHEEL action (dispatch
+ * task). Buttons are counted like keys; pointer and wheel actions move while held,
+ * speeding up on the MOUSE_* acceleration curve. Sent by the next armdeck_mouse_poll,
+ * except a button changing twice before it: the pending state goes out first. */
+void armdeck_mouse_press(const armdeck_action_def_t* action);
+
+/* Release an action pressed with armdeck_mouse_press (dispatch task) */
+void armdeck_mouse_release(const armdeck_action_def_t* action);
+
+/* Send button changes and due motion (dispatch task, after each batch of events).
+ * Motion goes out at most once per connection interval and waits while reports are
+ * queued for the link. Returns the next motion time (esp_timer time) or 0 when
+ * nothing moves. */
+int64_t armdeck_mouse_poll(int64_t now_us);
+
+#endif /* ARMDECK_MOUSE_H */
@@ -1,5 +1,7 @@
 #include "armdeck_protocol.h"
 #include "armdeck_config.h"
+#include "armdeck_link.h"
+#include "armdeck_bulk.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "esp_timer.h"
@@ -9,34 +11,6 @@
 
 static const char* TAG = "ARMDECK_PROTOCOL";
 
-/* Default button configuration */
-static const armdeck_button_t default_buttons[15] = {
-    {0,  ACTION_MEDIA, 0xCD, 0, 0x4C, 0xAF, 0x50, 0, "Play"},    // Play/Pause - Green
-    {1,  ACTION_MEDIA, 0xB5, 0, 0x21, 0x96, 0xF3, 0, "Next"},    // Next - Blue
-    {2,  ACTION_MEDIA, 0xB6, 0, 0x21, 0x96, 0xF3, 0, "Prev"},    // Previous - Blue
-    {3,  ACTION_MEDIA, 0xE9, 0, 0xFF, 0x98, 0x00, 0, "Vol+"},    // Volume Up - Orange
-    {4,  ACTION_MEDIA, 0xEA, 0, 0xFF, 0x98, 0x00, 0, "Vol-"},    // Volume Down - Orange
-    {5,  ACTION_MEDIA, 0xE2, 0, 0xF4, 0x43, 0x36, 0, "Mute"},    // Mute - Red
-    {6,  ACTION_MEDIA, 0xB7, 0, 0x9C, 0x27, 0xB0, 0, "Stop"},    // Stop - Purple
-    {7,  ACTION_KEY,   0x6F, 0, 0x60, 0x7D, 0x8B, 0, "F20"},     // F20 - Blue Grey
-    {8,  ACTION_KEY,   0x70, 0, 0x60, 0x7D, 0x8B, 0, "F21"},     // F21
-    {9,  ACTION_KEY,   0x71, 0, 0x60, 0x7D, 0x8B, 0, "F22"},     // F22
-    {10, ACTION_KEY,   0x72, 0, 0x60, 0x7D, 0x8B, 0, "F23"},     // F23
-    {11, ACTION_KEY,   0x73, 0, 0x60, 0x7D, 0x8B, 0, "F24"},     // F24
-    {12, ACTION_KEY,   0x74, 0, 0x3F, 0x51, 0xB5, 0, "F13"},     // F13 - Indigo
-    {13, ACTION_KEY,   0x75, 0, 0x3F, 0x51, 0xB5, 0, "F14"},     // F14 - Indigo
-    {14, ACTION_KEY,   0x76, 0, 0x3F, 0x51, 0xB5, 0, "F15"},     // F15 - Indigo
-};
-
-/* Current configuration in memory */
-static armdeck_config_t current_config = {
-    .version = ARMDECK_PROTOCOL_VERSION,
-    .num_buttons = 15,
-    .reserved = 0
-};
-
-static bool config_initialized = false;
-
 uint8_t armdeck_protocol_checksum(const uint8_t* data, uint16_t len) {
     uint8_t checksum = 0;
     for (uint16_t i = 0; i < len; i++) {
@@ -89,7 +63,7 @@ esp_err_t armdeck_protocol_parse(const uint8_t* data, uint16_t len,
 }
 
 uint16_t armdeck_protocol_build_response(uint8_t cmd, uint8_t error, 
-                                         const void* payload, uint8_t payload_len,
+                                         const void* payload, uint16_t payload_len,
                                          uint8_t* output, uint16_t max_len) {
     uint16_t total_len = sizeof(armdeck_header_t) + 1 + payload_len + 1;  // +1 for error, +1 for checksum
     
@@ -103,7 +77,8 @@ uint16_t armdeck_protocol_build_response(uint8_t cmd, uint8_t error,
         .magic1 = ARMDECK_MAGIC_BYTE1,
         .magic2 = ARMDECK_MAGIC_BYTE2,
         .command = cmd,
-        .length = 1 + payload_len  // Error code + payload
+        .length = payload_len < 0xFF ? 1 + payload_len : 0xFF  // Error code + payload, saturates
+                                                              // for bulk reads (header not sent)
     };
     
     // Copy to output
@@ -127,26 +102,17 @@ uint16_t armdeck_protocol_build_response(uint8_t cmd, uint8_t error,
     return pos;
 }
 
-static void load_config_from_nvs(void) {
-    // Initialize with defaults
-    memcpy(current_config.buttons, default_buttons, sizeof(default_buttons));
-    
-    // TODO: Load from NVS if exists
-    // For now, just use defaults
-    
-    config_initialized = true;
-    ESP_LOGI(TAG, "Configuration loaded (using defaults for now)");
-}
-
 static esp_err_t handle_get_info(uint8_t* output, uint16_t* output_len) {
     armdeck_device_info_t info = {
         .protocol_version = ARMDECK_PROTOCOL_VERSION,
         .firmware_major = 1,
         .firmware_minor = 2,        .firmware_patch = 0,
-        .num_buttons = 15,
+        .num_buttons = armdeck_config_get_num_buttons(),
         .battery_level = 100,  // TODO: Read actual battery
         .uptime_seconds = esp_timer_get_time() / 1000000,
-        .free_heap = esp_get_free_heap_size()
+        .free_heap = esp_get_free_heap_size(),
+        .matrix_rows = armdeck_config_get_geometry()->rows,
+        .matrix_cols = armdeck_config_get_geometry()->cols
     };
     
     strncpy(info.device_name, "ArmDeck", sizeof(info.device_name) - 1);
@@ -157,7 +123,7 @@ static esp_err_t handle_get_info(uint8_t* output, uint16_t* output_len) {
     return ESP_OK;
 }
 
-static esp_err_t handle_get_config(uint8_t* output, uint16_t* output_len) {
+static esp_err_t handle_get_config(uint8_t* output, uint16_t* output_len, uint16_t max_len) {
     // Use the proper configuration system instead of local config
     const armdeck_config_t* config = armdeck_config_get();
     if (!config) {
@@ -167,33 +133,137 @@ static esp_err_t handle_get_config(uint8_t* output, uint16_t* output_len) {
         return ESP_ERR_INVALID_STATE;
     }
     
+    /* Only used buttons are sent. Beyond one packet, read it with CMD_BULK_READ. */
+    size_t config_size = ARMDECK_CONFIG_SIZE(config->num_buttons);
     *output_len = armdeck_protocol_build_response(CMD_GET_CONFIG, ERR_NONE,
-                                                  config, sizeof(armdeck_config_t),
-                                                  output, 256);
+                                                  config, config_size,
+                                                  output, max_len);
+    if (*output_len == 0) {
+        ESP_LOGW(TAG, "Configuration too large for one packet: %d bytes", config_size);
+        *output_len = armdeck_protocol_build_response(CMD_GET_CONFIG, ERR_LENGTH,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_SIZE;
+    }
     return ESP_OK;
 }
 
-static esp_err_t handle_set_config(const uint8_t* payload, uint8_t payload_len,
+static esp_err_t handle_set_config(const uint8_t* payload, uint16_t payload_len,
                                   uint8_t* output, uint16_t* output_len) {
-    if (payload_len != sizeof(armdeck_config_t)) {
+    /* Only used buttons are sent: header then num_buttons entries */
+    static armdeck_config_t config;
+    if (payload_len < ARMDECK_CONFIG_SIZE(0) ||
+        payload_len != ARMDECK_CONFIG_SIZE(((const armdeck_config_t*)payload)->num_buttons) ||
+        payload_len > sizeof(config)) {
         *output_len = armdeck_protocol_build_response(CMD_SET_CONFIG, ERR_INVALID_PARAM,
                                                       NULL, 0, output, 256);
         return ESP_ERR_INVALID_SIZE;
     }
     
     // Copy new configuration
-    memcpy(&current_config, payload, sizeof(current_config));
+    memset(&config, 0, sizeof(config));
+    memcpy(&config, payload, payload_len);
     
-    // TODO: Save to NVS
+    esp_err_t ret = armdeck_config_set(&config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to apply configuration: %s", esp_err_to_name(ret));
+        *output_len = armdeck_protocol_build_response(CMD_SET_CONFIG,
+                                                      ret == ESP_ERR_INVALID_ARG ? ERR_INVALID_PARAM : ERR_MEMORY,
+                                                      NULL, 0, output, 256);
+        return ret;
+    }
     
-    ESP_LOGI(TAG, "Configuration updated");
+    ESP_LOGI(TAG, "Configuration updated and saved");
     
     *output_len = armdeck_protocol_build_response(CMD_SET_CONFIG, ERR_NONE,
                                                   NULL, 0, output, 256);
     return ESP_OK;
 }
 
-static esp_err_t handle_get_button(const uint8_t* payload, uint8_t payload_len,
+static esp_err_t handle_get_settings(uint8_t* output, uint16_t* output_len) {
+    const armdeck_settings_t* settings = armdeck_config_get_settings();
+    
+    *output_len = armdeck_protocol_build_response(CMD_GET_SETTINGS, ERR_NONE,
+                                                  settings, sizeof(armdeck_settings_t),
+                                                  output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_set_settings(const uint8_t* payload, uint16_t payload_len,
+                                    uint8_t* output, uint16_t* output_len) {
+    if (payload_len != sizeof(armdeck_settings_t)) {
+        ESP_LOGE(TAG, "Invalid settings length: %d, expected: %d", payload_len, sizeof(armdeck_settings_t));
+        *output_len = armdeck_protocol_build_response(CMD_SET_SETTINGS, ERR_INVALID_PARAM,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    armdeck_settings_t settings;
+    memcpy(&settings, payload, sizeof(settings));
+    
+    esp_err_t ret = armdeck_config_set_settings(&settings);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to apply settings: %s", esp_err_to_name(ret));
+        *output_len = armdeck_protocol_build_response(CMD_SET_SETTINGS,
+                                                      ret == ESP_ERR_INVALID_ARG ? ERR_INVALID_PARAM : ERR_MEMORY,
+                                                      NULL, 0, output, 256);
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Settings updated and saved");
+    
+    *output_len = armdeck_protocol_build_response(CMD_SET_SETTINGS, ERR_NONE,
+                                                  NULL, 0, output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_get_geometry(uint8_t* output, uint16_t* output_len) {
+    const armdeck_geometry_t* geometry = armdeck_config_get_geometry();
+    
+    *output_len = armdeck_protocol_build_response(CMD_GET_GEOMETRY, ERR_NONE,
+                                                  geometry, sizeof(armdeck_geometry_t),
+                                                  output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_set_geometry(const uint8_t* payload, uint16_t payload_len,
+                                    uint8_t* output, uint16_t* output_len) {
+    if (payload_len != sizeof(armdeck_geometry_t)) {
+        ESP_LOGE(TAG, "Invalid geometry length: %d, expected: %d", payload_len, sizeof(armdeck_geometry_t));
+        *output_len = armdeck_protocol_build_response(CMD_SET_GEOMETRY, ERR_INVALID_PARAM,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    armdeck_geometry_t geometry;
+    memcpy(&geometry, payload, sizeof(geometry));
+    
+    esp_err_t ret = armdeck_config_set_geometry(&geometry);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save geometry: %s", esp_err_to_name(ret));
+        *output_len = armdeck_protocol_build_response(CMD_SET_GEOMETRY,
+                                                      ret == ESP_ERR_INVALID_ARG ? ERR_INVALID_PARAM : ERR_MEMORY,
+                                                      NULL, 0, output, 256);
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Geometry saved, restart to apply");
+    
+    *output_len = armdeck_protocol_build_response(CMD_SET_GEOMETRY, ERR_NONE,
+                                                  NULL, 0, output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_get_link(uint8_t* output, uint16_t* output_len) {
+    armdeck_link_info_t info;
+    armdeck_link_get_info(&info);
+    
+    *output_len = armdeck_protocol_build_response(CMD_GET_LINK, ERR_NONE,
+                                                  &info, sizeof(info),
+                                                  output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_get_button(const uint8_t* payload, uint16_t payload_len,
                                   uint8_t* output, uint16_t* output_len) {
     ESP_LOGI(TAG, "handle_get_button: payload_len=%d", payload_len);
     
@@ -208,7 +278,7 @@ static esp_err_t handle_get_button(const uint8_t* payload, uint8_t payload_len,
     // L'ID du bouton est directement dans payload[0]
     uint8_t button_id = payload[0];
     
-    if (button_id >= 15) {
+    if (button_id >= armdeck_config_get_num_buttons()) {
         ESP_LOGE(TAG, "Invalid button ID: %d", button_id);
         *output_len = armdeck_protocol_build_response(CMD_GET_BUTTON, ERR_INVALID_PARAM,
                                                       NULL, 0, output, 256);
@@ -232,7 +302,7 @@ static esp_err_t handle_get_button(const uint8_t* payload, uint8_t payload_len,
     return ESP_OK;
 }
 
-static esp_err_t handle_set_button(const uint8_t* payload, uint8_t payload_len,
+static esp_err_t handle_set_button(const uint8_t* payload, uint16_t payload_len,
                                   uint8_t* output, uint16_t* output_len) {
     if (payload_len != sizeof(armdeck_button_t)) {
         *output_len = armdeck_protocol_build_response(CMD_SET_BUTTON, ERR_INVALID_PARAM,
@@ -251,22 +321,20 @@ static esp_err_t handle_set_button(const uint8_t* payload, uint8_t payload_len,
              button->button_id, button->action_type, button->key_code, button->modifier);
     ESP_LOGI(TAG, "Button colors: R=%d, G=%d, B=%d, reserved=%d", 
              button->color_r, button->color_g, button->color_b, button->reserved);
-    ESP_LOGI(TAG, "Button label: '%s'", button->label);
+    ESP_LOGI(TAG, "Button label: '%.*s'", (int)sizeof(button->label), button->label);
     
-      if (button->button_id >= 15) {
+      if (button->button_id >= armdeck_config_get_num_buttons()) {
         *output_len = armdeck_protocol_build_response(CMD_SET_BUTTON, ERR_INVALID_PARAM,
                                                       NULL, 0, output, 256);
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Update button configuration in both internal config and proper config system
-    memcpy(&current_config.buttons[button->button_id], button, sizeof(armdeck_button_t));
-    
     // Save using the proper configuration system
     esp_err_t ret = armdeck_config_set_button(button->button_id, button);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to save button configuration: %s", esp_err_to_name(ret));
-        *output_len = armdeck_protocol_build_response(CMD_SET_BUTTON, ERR_MEMORY,
+        *output_len = armdeck_protocol_build_response(CMD_SET_BUTTON,
+                                                      ret == ESP_ERR_INVALID_ARG ? ERR_INVALID_PARAM : ERR_MEMORY,
                                                       NULL, 0, output, 256);
         return ret;
     }
@@ -279,7 +347,144 @@ static esp_err_t handle_set_button(const uint8_t* payload, uint8_t payload_len,
     return ESP_OK;
 }
 
-static esp_err_t handle_test_button(const uint8_t* payload, uint8_t payload_len,
+static esp_err_t handle_get_button_ext(const uint8_t* payload, uint16_t payload_len,
+                                      uint8_t* output, uint16_t* output_len) {
+    if (payload_len != 1 || payload[0] >= armdeck_config_get_num_buttons()) {
+        ESP_LOGE(TAG, "Invalid gesture request: len=%d", payload_len);
+        *output_len = armdeck_protocol_build_response(CMD_GET_BUTTON_EXT, ERR_INVALID_PARAM,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    const armdeck_button_ext_t* ext = armdeck_config_get_button_ext(payload[0]);
+    if (!ext) {
+        *output_len = armdeck_protocol_build_response(CMD_GET_BUTTON_EXT, ERR_MEMORY,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    *output_len = armdeck_protocol_build_response(CMD_GET_BUTTON_EXT, ERR_NONE,
+                                                  ext, sizeof(armdeck_button_ext_t),
+                                                  output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_set_button_ext(const uint8_t* payload, uint16_t payload_len,
+                                      uint8_t* output, uint16_t* output_len) {
+    if (payload_len != sizeof(armdeck_button_ext_t)) {
+        ESP_LOGE(TAG, "Invalid gesture length: %d, expected: %d", payload_len, sizeof(armdeck_button_ext_t));
+        *output_len = armdeck_protocol_build_response(CMD_SET_BUTTON_EXT, ERR_INVALID_PARAM,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    armdeck_button_ext_t ext;
+    memcpy(&ext, payload, sizeof(ext));
+    
+    esp_err_t ret = armdeck_config_set_button_ext(ext.button_id, &ext);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to apply button %d gestures: %s", ext.button_id, esp_err_to_name(ret));
+        *output_len = armdeck_protocol_build_response(CMD_SET_BUTTON_EXT,
+                                                      ret == ESP_ERR_INVALID_ARG ? ERR_INVALID_PARAM : ERR_MEMORY,
+                                                      NULL, 0, output, 256);
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Button %d gestures updated and saved (flags=0x%02X)", ext.button_id, ext.gesture_flags);
+    
+    *output_len = armdeck_protocol_build_response(CMD_SET_BUTTON_EXT, ERR_NONE,
+                                                  NULL, 0, output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_get_combos(uint8_t* output, uint16_t* output_len) {
+    const armdeck_combo_table_t* table = armdeck_config_get_combos();
+    
+    *output_len = armdeck_protocol_build_response(CMD_GET_COMBOS, ERR_NONE,
+                                                  table, ARMDECK_COMBO_TABLE_SIZE(table->num_combos),
+                                                  output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_set_combos(const uint8_t* payload, uint16_t payload_len,
+                                  uint8_t* output, uint16_t* output_len) {
+    /* Only used combos are sent: header then num_combos entries */
+    static armdeck_combo_table_t table;
+    if (payload_len < ARMDECK_COMBO_TABLE_SIZE(0) ||
+        payload_len != ARMDECK_COMBO_TABLE_SIZE(((const armdeck_combo_table_t*)payload)->num_combos) ||
+        payload_len > sizeof(table)) {
+        ESP_LOGE(TAG, "Invalid combo table length: %d", payload_len);
+        *output_len = armdeck_protocol_build_response(CMD_SET_COMBOS, ERR_INVALID_PARAM,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    memset(&table, 0, sizeof(table));
+    memcpy(&table, payload, payload_len);
+    
+    esp_err_t ret = armdeck_config_set_combos(&table);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to apply combos: %s", esp_err_to_name(ret));
+        *output_len = armdeck_protocol_build_response(CMD_SET_COMBOS,
+                                                      ret == ESP_ERR_INVALID_ARG ? ERR_INVALID_PARAM : ERR_MEMORY,
+                                                      NULL, 0, output, 256);
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Combos updated and saved (%d)", table.num_combos);
+    
+    *output_len = armdeck_protocol_build_response(CMD_SET_COMBOS, ERR_NONE,
+                                                  NULL, 0, output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_get_macro(const uint8_t* payload, uint16_t payload_len,
+                                 uint8_t* output, uint16_t* output_len) {
+    const armdeck_macro_t* macro = payload_len == 1 ? armdeck_config_get_macro(payload[0]) : NULL;
+    if (!macro) {
+        *output_len = armdeck_protocol_build_response(CMD_GET_MACRO, ERR_INVALID_PARAM,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    *output_len = armdeck_protocol_build_response(CMD_GET_MACRO, ERR_NONE,
+                                                  macro, ARMDECK_MACRO_SIZE(macro->length),
+                                                  output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_set_macro(const uint8_t* payload, uint16_t payload_len,
+                                 uint8_t* output, uint16_t* output_len) {
+    /* Only the used bytecode is sent: macro_id, length, then length bytes */
+    armdeck_macro_t macro = {0};
+    if (payload_len < ARMDECK_MACRO_SIZE(0) ||
+        payload_len != ARMDECK_MACRO_SIZE(((const armdeck_macro_t*)payload)->length) ||
+        payload_len > sizeof(macro)) {
+        ESP_LOGE(TAG, "Invalid macro length: %d", payload_len);
+        *output_len = armdeck_protocol_build_response(CMD_SET_MACRO, ERR_INVALID_PARAM,
+                                                      NULL, 0, output, 256);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    memcpy(&macro, payload, payload_len);
+    
+    esp_err_t ret = armdeck_config_set_macro(&macro);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to apply macro %d: %s", macro.macro_id, esp_err_to_name(ret));
+        *output_len = armdeck_protocol_build_response(CMD_SET_MACRO,
+                                                      ret == ESP_ERR_INVALID_ARG ? ERR_INVALID_PARAM : ERR_MEMORY,
+                                                      NULL, 0, output, 256);
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Macro %d updated and saved (%d bytes)", macro.macro_id, macro.length);
+    
+    *output_len = armdeck_protocol_build_response(CMD_SET_MACRO, ERR_NONE,
+                                                  NULL, 0, output, 256);
+    return ESP_OK;
+}
+
+static esp_err_t handle_test_button(const uint8_t* payload, uint16_t payload_len,
                                    uint8_t* output, uint16_t* output_len) {
     if (payload_len != 1) {
         *output_len = armdeck_protocol_build_response(CMD_TEST_BUTTON, ERR_INVALID_PARAM,
@@ -287,7 +492,7 @@ static esp_err_t handle_test_button(const uint8_t* payload, uint8_t payload_len,
         return ESP_ERR_INVALID_SIZE;
     }
       uint8_t button_id = payload[0];
-    if (button_id >= 15) {
+    if (button_id >= armdeck_config_get_num_buttons()) {
         *output_len = armdeck_protocol_build_response(CMD_TEST_BUTTON, ERR_INVALID_PARAM,
                                                       NULL, 0, output, 256);
         return ESP_ERR_INVALID_ARG;
@@ -303,16 +508,21 @@ static esp_err_t handle_test_button(const uint8_t* payload, uint8_t payload_len,
 
 esp_err_t armdeck_protocol_handle_command(const uint8_t* input, uint16_t input_len,
                                           uint8_t* output, uint16_t* output_len) {
+    /* Bulk segments come back to back: no logging, the bulk layer answers by notification */
+    if (input_len > 0 && input[0] == ARMDECK_SEGMENT_MARKER) {
+        *output_len = 0;
+        return armdeck_bulk_receive_segment(input, input_len);
+    }
     
-    ESP_LOGI(TAG, "=== PROTOCOL HANDLER CALLED ===");
-    ESP_LOGI(TAG, "Input length: %d", input_len);
-    ESP_LOGI(TAG, "Input data:");
-    ESP_LOG_BUFFER_HEX(TAG, input, input_len);
+    ESP_LOGD(TAG, "=== PROTOCOL HANDLER CALLED ===");
+    ESP_LOGD(TAG, "Input length: %d", input_len);
+    ESP_LOGD(TAG, "Input data:");
+    ESP_LOG_BUFFER_HEX_LEVEL(TAG, input, input_len, ESP_LOG_DEBUG);
     
     armdeck_header_t header;
     uint8_t* payload = NULL;
     
-    ESP_LOGI(TAG, "Received command packet: len=%d, data=[0x%02X 0x%02X 0x%02X 0x%02X...]", 
+    ESP_LOGD(TAG, "Received command packet: len=%d, data=[0x%02X 0x%02X 0x%02X 0x%02X...]", 
              input_len, 
              input_len > 0 ? input[0] : 0,
              input_len > 1 ? input[1] : 0, 
@@ -330,31 +540,79 @@ esp_err_t armdeck_protocol_handle_command(const uint8_t* input, uint16_t input_l
     
     ESP_LOGI(TAG, "Parsed command: 0x%02X, payload_len: %d", header.command, header.length);
     
-    // Handle command
-    switch (header.command) {
+    return armdeck_protocol_dispatch(header.command, payload, header.length, output, output_len, 256);
+}
+
+esp_err_t armdeck_protocol_dispatch(uint8_t command, const uint8_t* payload, uint16_t payload_len,
+                                    uint8_t* output, uint16_t* output_len, uint16_t max_len) {
+    switch (command) {
         case CMD_GET_INFO:
             ESP_LOGI(TAG, "Handling CMD_GET_INFO");
             return handle_get_info(output, output_len);
             
         case CMD_GET_CONFIG:
             ESP_LOGI(TAG, "Handling CMD_GET_CONFIG");
-            return handle_get_config(output, output_len);
+            return handle_get_config(output, output_len, max_len);
             
         case CMD_SET_CONFIG:
             ESP_LOGI(TAG, "Handling CMD_SET_CONFIG");
-            return handle_set_config(payload, header.length, output, output_len);
+            return handle_set_config(payload, payload_len, output, output_len);
+            
+        case CMD_GET_SETTINGS:
+            ESP_LOGI(TAG, "Handling CMD_GET_SETTINGS");
+            return handle_get_settings(output, output_len);
+            
+        case CMD_SET_SETTINGS:
+            ESP_LOGI(TAG, "Handling CMD_SET_SETTINGS");
+            return handle_set_settings(payload, payload_len, output, output_len);
+            
+        case CMD_GET_GEOMETRY:
+            ESP_LOGI(TAG, "Handling CMD_GET_GEOMETRY");
+            return handle_get_geometry(output, output_len);
+            
+        case CMD_SET_GEOMETRY:
+            ESP_LOGI(TAG, "Handling CMD_SET_GEOMETRY");
+            return handle_set_geometry(payload, payload_len, output, output_len);
+            
+        case CMD_GET_LINK:
+            ESP_LOGI(TAG, "Handling CMD_GET_LINK");
+            return handle_get_link(output, output_len);
             
         case CMD_GET_BUTTON:
             ESP_LOGI(TAG, "Handling CMD_GET_BUTTON");
-            return handle_get_button(payload, header.length, output, output_len);
+            return handle_get_button(payload, payload_len, output, output_len);
             
         case CMD_SET_BUTTON:
             ESP_LOGI(TAG, "Handling CMD_SET_BUTTON");
-            return handle_set_button(payload, header.length, output, output_len);
+            return handle_set_button(payload, payload_len, output, output_len);
+            
+        case CMD_GET_BUTTON_EXT:
+            ESP_LOGI(TAG, "Handling CMD_GET_BUTTON_EXT");
+            return handle_get_button_ext(payload, payload_len, output, output_len);
+            
+        case CMD_SET_BUTTON_EXT:
+            ESP_LOGI(TAG, "Handling CMD_SET_BUTTON_EXT");
+            return handle_set_button_ext(payload, payload_len, output, output_len);
+            
+        case CMD_GET_COMBOS:
+            ESP_LOGI(TAG, "Handling CMD_GET_COMBOS");
+            return handle_get_combos(output, output_len);
+            
+        case CMD_SET_COMBOS:
+            ESP_LOGI(TAG, "Handling CMD_SET_COMBOS");
+            return handle_set_combos(payload, payload_len, output, output_len);
+            
+        case CMD_GET_MACRO:
+            ESP_LOGI(TAG, "Handling CMD_GET_MACRO");
+            return handle_get_macro(payload, payload_len, output, output_len);
+            
+        case CMD_SET_MACRO:
+            ESP_LOGI(TAG, "Handling CMD_SET_MACRO");
+            return handle_set_macro(payload, payload_len, output, output_len);
             
         case CMD_TEST_BUTTON:
             ESP_LOGI(TAG, "Handling CMD_TEST_BUTTON");
-            return handle_test_button(payload, header.length, output, output_len);
+            return handle_test_button(payload, payload_len, output, output_len);
               case CMD_RESET_CONFIG:
             ESP_LOGI(TAG, "Handling CMD_RESET_CONFIG");
             // Use the proper configuration system to reset and save
@@ -366,13 +624,23 @@ esp_err_t armdeck_protocol_handle_command(const uint8_t* input, uint16_t input_l
                 return reset_ret;
             }
             
-            // Also update local copy for backward compatibility
-            memcpy(current_config.buttons, default_buttons, sizeof(default_buttons));
             ESP_LOGI(TAG, "Configuration reset to defaults and saved");
             *output_len = armdeck_protocol_build_response(CMD_RESET_CONFIG, ERR_NONE,
                                                           NULL, 0, output, 256);
             return ESP_OK;
             
+        case CMD_BULK_WRITE:
+            ESP_LOGI(TAG, "Handling CMD_BULK_WRITE");
+            return armdeck_bulk_open_write(payload, payload_len, output, output_len);
+            
+        case CMD_BULK_READ:
+            ESP_LOGI(TAG, "Handling CMD_BULK_READ");
+            return armdeck_bulk_open_read(payload, payload_len, output, output_len);
+            
+        case CMD_BULK_ACK:
+            *output_len = 0;
+            return armdeck_bulk_receive_ack(payload, payload_len);
+            
         case CMD_RESTART:
             ESP_LOGI(TAG, "Handling CMD_RESTART");
             *output_len = armdeck_protocol_build_response(CMD_RESTART, ERR_NONE,
@@ -382,7 +650,7 @@ esp_err_t armdeck_protocol_handle_command(const uint8_t* input, uint16_t input_l
             return ESP_OK;
             
         default:
-            ESP_LOGW(TAG, "Unknown command: 0x%02X", header.command);
+            ESP_LOGW(TAG, "Unknown command: 0x%02X", command);
             *output_len = armdeck_protocol_build_response(CMD_NACK, ERR_INVALID_CMD,
                                                           NULL, 0, output, 256);
             return ESP_ERR_NOT_FOUND;
@@ -390,7 +658,7 @@ esp_err_t armdeck_protocol_handle_command(const uint8_t* input, uint16_t input_l
 }
 
 const armdeck_button_t* armdeck_protocol_get_button_config(uint8_t button_id) {
-    if (button_id >= 15) {
+    if (button_id >= armdeck_config_get_num_buttons()) {
         return NULL;
     }
     
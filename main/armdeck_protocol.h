@@ -3,11 +3,17 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 /* Protocol version */
 #define ARMDECK_PROTOCOL_VERSION    0x01
 
+/* Matrix limits (the actual geometry is stored in NVS) */
+#define ARMDECK_MAX_BUTTONS         64
+#define ARMDECK_MAX_ROWS            8
+#define ARMDECK_MAX_COLS            16
+
 /* Packet structure:
  * [HEADER][PAYLOAD][CHECKSUM]
  * 
@@ -19,6 +25,8 @@
  * PAYLOAD (variable)
  * 
  * CHECKSUM (1 byte): XOR of all bytes
+ *
+ * Payloads longer than 255 bytes travel as bulk transfers (see CMD_BULK_WRITE)
  */
 
 /* Magic bytes */
@@ -31,10 +39,24 @@ typedef enum {
     CMD_GET_CONFIG      = 0x20,  // Get button configuration
     CMD_SET_CONFIG      = 0x21,  // Set button configuration
     CMD_RESET_CONFIG    = 0x22,  // Reset to default
+    CMD_GET_SETTINGS    = 0x23,  // Get device settings
+    CMD_SET_SETTINGS    = 0x24,  // Set device settings
+    CMD_GET_GEOMETRY    = 0x25,  // Get matrix geometry
+    CMD_SET_GEOMETRY    = 0x26,  // Set matrix geometry (applied after restart)
+    CMD_GET_LINK        = 0x27,  // Get BLE link parameters and policy state
     CMD_GET_BUTTON      = 0x30,  // Get single button config
     CMD_SET_BUTTON      = 0x31,  // Set single button config
+    CMD_GET_BUTTON_EXT  = 0x32,  // Get single button gestures
+    CMD_SET_BUTTON_EXT  = 0x33,  // Set single button gestures
+    CMD_GET_COMBOS      = 0x34,  // Get combo table
+    CMD_SET_COMBOS      = 0x35,  // Set combo table
+    CMD_GET_MACRO       = 0x36,  // Get one macro
+    CMD_SET_MACRO       = 0x37,  // Set one macro
     CMD_TEST_BUTTON     = 0x40,  // Test button press
     CMD_RESTART         = 0x50,  // Restart device
+    CMD_BULK_WRITE      = 0x60,  // Open a segmented upload of one command payload
+    CMD_BULK_READ       = 0x61,  // Run a command and open its response for a segmented download
+    CMD_BULK_ACK        = 0x62,  // Acknowledge segments (sent by the receiving side)
     CMD_ACK             = 0xA0,  // Acknowledge
     CMD_NACK            = 0xA1,  // Not acknowledge
 } armdeck_cmd_t;
@@ -57,8 +79,35 @@ typedef enum {
     ACTION_MEDIA        = 0x02,  // Media control
     ACTION_MACRO        = 0x03,  // Macro sequence
     ACTION_CUSTOM       = 0x04,  // Custom function
+    ACTION_MOUSE_BUTTON = 0x05,  // Mouse buttons held: key_code = MOUSE_BUTTON_* bits
+    ACTION_MOUSE_MOVE   = 0x06,  // Pointer motion while held: key_code = X speed, modifier = Y speed
+    ACTION_MOUSE_WHEEL  = 0x07,  // Wheel motion while held: key_code = speed (positive scrolls up)
 } armdeck_action_t;
 
+/* Highest valid action type */
+#define ACTION_LAST                 ACTION_MOUSE_WHEEL
+
+/* ACTION_MOUSE_BUTTON bits */
+#define MOUSE_BUTTON_LEFT           0x01
+#define MOUSE_BUTTON_RIGHT          0x02
+#define MOUSE_BUTTON_MIDDLE         0x04
+#define MOUSE_BUTTON_ALL            0x07
+
+/* ACTION_MOUSE_MOVE and ACTION_MOUSE_WHEEL speeds are signed bytes. Full speed is
+ * speed * MOUSE_MOVE_UNIT_CPS counts per second for the pointer and speed detents
+ * per second for the wheel, reached after the accel time on a quadratic curve
+ * starting at MOUSE_START_PERCENT of it. */
+#define MOUSE_MOVE_UNIT_CPS         10
+#define MOUSE_MOVE_ACCEL_MS         600
+#define MOUSE_WHEEL_ACCEL_MS        1000
+#define MOUSE_START_PERCENT         20
+
+/* ACTION_MEDIA usage: key_code is the low byte of the Consumer Page usage, modifier the high byte */
+#define ACTION_MEDIA_USAGE(key_code, modifier)  ((uint16_t)((key_code) | ((modifier) << 8)))
+
+/* Highest usage the consumer report carries (its logical maximum) */
+#define ACTION_MEDIA_MAX_USAGE                  0x3FF
+
 /* Packet header structure */
 typedef struct __attribute__((packed)) {
     uint8_t magic1;         // 0xAD
@@ -78,14 +127,16 @@ typedef struct __attribute__((packed)) {
     uint32_t uptime_seconds;
     uint32_t free_heap;
     char device_name[16];
+    uint8_t matrix_rows;
+    uint8_t matrix_cols;
 } armdeck_device_info_t;
 
 /* Button configuration */
 typedef struct __attribute__((packed)) {
-    uint8_t button_id;      // 0-14 for 15 buttons
+    uint8_t button_id;      // 0 to num_buttons - 1
     uint8_t action_type;    // ACTION_KEY, ACTION_MEDIA, etc.
-    uint8_t key_code;       // HID key code
-    uint8_t modifier;       // Modifier keys (Ctrl, Alt, etc.)
+    uint8_t key_code;       // HID key code (ACTION_MEDIA: usage low byte)
+    uint8_t modifier;       // Modifier keys (Ctrl, Alt, etc.), ACTION_MEDIA: usage high byte
     uint8_t color_r;        // Red component
     uint8_t color_g;        // Green component
     uint8_t color_b;        // Blue component
@@ -93,14 +144,226 @@ typedef struct __attribute__((packed)) {
     char label[8];          // Short label (7 chars + null)
 } armdeck_button_t;
 
+/* Extended button behaviour version (bump when the layout changes) */
+#define ARMDECK_BUTTON_EXT_VERSION  0x02
+
+/* Gesture flags */
+#define GESTURE_FLAG_HOLD           0x01    // Hold action once held for hold_ms
+#define GESTURE_FLAG_DOUBLE_TAP     0x02    // Double tap action on a second press within double_tap_ms
+#define GESTURE_FLAGS_ALL           (GESTURE_FLAG_HOLD | GESTURE_FLAG_DOUBLE_TAP)
+
+/* Gesture timings (0 in the button entry = default) */
+#define GESTURE_DEFAULT_HOLD_MS         300
+#define GESTURE_DEFAULT_DOUBLE_TAP_MS   250
+#define GESTURE_MAX_MS                  5000
+
+/* Auto-repeat timings (ACTION_KEY and ACTION_MEDIA actions only) */
+#define REPEAT_DEFAULT_INTERVAL_MS      33      // ~30 repeats per second
+#define REPEAT_MIN_INTERVAL_MS          10
+#define REPEAT_MAX_MS                   5000
+
+/* Action of a gesture */
+typedef struct __attribute__((packed)) {
+    uint8_t action_type;    // ACTION_KEY, ACTION_MEDIA, etc.
+    uint8_t key_code;       // HID key code (ACTION_MEDIA: usage low byte)
+    uint8_t modifier;       // Modifier keys (ACTION_MEDIA: usage high byte)
+} armdeck_action_def_t;
+
+/* Extended button behaviour. The tap action is the armdeck_button_t one, buttons
+ * without gesture flags send it on press and release with no added latency.
+ * With repeat_delay_ms set, whichever action the button holds down repeats. */
+typedef struct __attribute__((packed)) {
+    uint8_t button_id;                  // 0 to num_buttons - 1
+    uint8_t gesture_flags;              // GESTURE_FLAG_*
+    uint16_t hold_ms;                   // Hold threshold, 0 = GESTURE_DEFAULT_HOLD_MS
+    uint16_t double_tap_ms;             // Second press window, 0 = GESTURE_DEFAULT_DOUBLE_TAP_MS
+    armdeck_action_def_t hold;          // Action while held past hold_ms
+    armdeck_action_def_t double_tap;    // Action of the second press
+    uint16_t repeat_delay_ms;           // Held time before the first repeat, 0 = no auto-repeat
+    uint16_t repeat_interval_ms;        // Time between repeats, 0 = REPEAT_DEFAULT_INTERVAL_MS
+} armdeck_button_ext_t;
+
+/* Combo table version (bump when the layout changes) */
+#define ARMDECK_COMBO_VERSION       0x01
+
+/* Combo limits */
+#define ARMDECK_MAX_COMBOS          16
+#define COMBO_DEFAULT_WINDOW_MS     50      // Used when the table sets 0
+#define COMBO_MAX_WINDOW_MS         200
+
+/* Combo: all member buttons pressed within the window trigger the action instead of theirs */
+typedef struct __attribute__((packed)) {
+    uint64_t buttons;                   // Member buttons, bit n = button n (2 or more)
+    armdeck_action_def_t action;        // Combo action, released with the first member
+    uint8_t reserved;                   // Padding
+} armdeck_combo_t;
+
+/* Combo table (only used combos are stored and sent) */
+typedef struct __attribute__((packed)) {
+    uint8_t version;                    // ARMDECK_COMBO_VERSION
+    uint8_t num_combos;                 // 0 to ARMDECK_MAX_COMBOS
+    uint8_t window_ms;                  // Press window, 0 = COMBO_DEFAULT_WINDOW_MS
+    uint8_t reserved;                   // Padding
+    armdeck_combo_t combos[ARMDECK_MAX_COMBOS];
+} armdeck_combo_table_t;
+
+/* Size of a combo table holding n combos */
+#define ARMDECK_COMBO_TABLE_SIZE(n) (offsetof(armdeck_combo_table_t, combos) + (n) * sizeof(armdeck_combo_t))
+
+/* Macro storage version (bump when the layout or the bytecode changes) */
+#define ARMDECK_MACRO_VERSION       0x01
+
+/* Macro limits. ACTION_MACRO buttons and combos run macro key_code. */
+#define ARMDECK_MAX_MACROS          16
+#define ARMDECK_MACRO_MAX_LEN       128     // Bytecode bytes per macro
+#define MACRO_MAX_DELAY_MS          10000
+
+/* Macro bytecode: an opcode byte followed by its operands, 16-bit operands little endian */
+#define MACRO_OP_END                0x00    // Stop (optional after the last step)
+#define MACRO_OP_PRESS              0x01    // key_code, modifier: key and/or modifiers down
+#define MACRO_OP_RELEASE            0x02    // key_code, modifier: key and/or modifiers up
+#define MACRO_OP_TAP                0x03    // key_code, modifier: down then up
+#define MACRO_OP_DELAY              0x04    // ms (16 bits, up to MACRO_MAX_DELAY_MS)
+#define MACRO_OP_CONSUMER           0x05    // usage (16 bits): Consumer Page usage down then up
+#define MACRO_OP_REPEAT             0x06    // count: run the steps since the start or the
+                                            // previous REPEAT count more times
+#define MACRO_OP_TEXT               0x07    // length, UTF-8 bytes: type the text with the
+                                            // settings text_layout
+
+/* One macro (only the used bytecode is sent) */
+typedef struct __attribute__((packed)) {
+    uint8_t macro_id;                   // 0 to ARMDECK_MAX_MACROS - 1
+    uint8_t length;                     // Bytecode length, 0 = empty
+    uint8_t code[ARMDECK_MACRO_MAX_LEN];
+} armdeck_macro_t;
+
+/* Size of a macro holding n bytecode bytes */
+#define ARMDECK_MACRO_SIZE(n)       (offsetof(armdeck_macro_t, code) + (n))
+
 /* Full configuration */
 typedef struct __attribute__((packed)) {
     uint8_t version;
     uint8_t num_buttons;
     uint16_t reserved;
-    armdeck_button_t buttons[15];
+    armdeck_button_t buttons[ARMDECK_MAX_BUTTONS];
 } armdeck_config_t;
 
+/* Size of a configuration holding n buttons (only used buttons are stored and sent) */
+#define ARMDECK_CONFIG_SIZE(n)      (offsetof(armdeck_config_t, buttons) + (n) * sizeof(armdeck_button_t))
+
+/* Matrix geometry version (bump when the layout changes) */
+#define ARMDECK_GEOMETRY_VERSION    0x01
+
+/* Matrix geometry: rows x cols keys, button n = row * cols + col */
+typedef struct __attribute__((packed)) {
+    uint8_t version;                        // ARMDECK_GEOMETRY_VERSION
+    uint8_t rows;                           // 1 to ARMDECK_MAX_ROWS
+    uint8_t cols;                           // 1 to ARMDECK_MAX_COLS, rows * cols <= ARMDECK_MAX_BUTTONS
+    uint8_t reserved;                       // Padding
+    uint8_t row_pins[ARMDECK_MAX_ROWS];     // Row GPIOs (outputs), unused entries ignored
+    uint8_t col_pins[ARMDECK_MAX_COLS];     // Column GPIOs (inputs with pull-up), unused entries ignored
+} armdeck_geometry_t;
+
+/* Device settings version (bump when the layout changes) */
+#define ARMDECK_SETTINGS_VERSION    0x03
+
+/* Keyboard report modes */
+#define KEYBOARD_MODE_6KRO          0       // Boot-compatible report, up to 6 keys
+#define KEYBOARD_MODE_NKRO          1       // Bitmap report, every held key
+
+/* Host keyboard layouts text is typed for */
+#define TEXT_LAYOUT_US              0       // US QWERTY
+#define TEXT_LAYOUT_FR              1       // French AZERTY
+#define TEXT_LAYOUT_COUNT           2
+
+/* Keep-alive default: idle seconds before the last report is sent again */
+#define KEEP_ALIVE_DEFAULT_S        15
+
+/* Matrix scan rate (scan_rate_hz), independent of the FreeRTOS tick */
+#define SCAN_DEFAULT_RATE_HZ        100
+#define SCAN_MIN_RATE_HZ            10
+#define SCAN_MAX_RATE_HZ            1000
+
+/* Device settings (scan, debounce and keyboard tunables) */
+typedef struct __attribute__((packed)) {
+    uint8_t version;            // ARMDECK_SETTINGS_VERSION
+    uint8_t scan_mode;          // 0 = polling, 1 = interrupt
+    uint8_t debounce_algo;      // 0 = defer, 1 = eager press, 2 = integrator
+    uint8_t debounce_press_ms;  // Press debounce / lockout time
+    uint8_t debounce_release_ms; // Release debounce time
+    uint16_t scan_rate_hz;      // Matrix scan rate, 0 = firmware default
+    uint8_t keyboard_mode;      // KEYBOARD_MODE_* (was padding, so 0 = 6KRO)
+    uint8_t text_layout;        // TEXT_LAYOUT_*: host layout of MACRO_OP_TEXT
+    uint8_t keep_alive_s;       // Idle seconds before a keep-alive report, 0 = off
+} armdeck_settings_t;
+
+/* Link policy modes */
+#define LINK_MODE_NONE              0       // Not connected, or nothing asked yet
+#define LINK_MODE_ACTIVE            1       // Shortest interval, no peripheral latency
+#define LINK_MODE_IDLE              2       // Long interval with peripheral latency
+
+/* BLE link state (CMD_GET_LINK) */
+typedef struct __attribute__((packed)) {
+    uint8_t connected;
+    uint8_t mode;               // LINK_MODE_* asked by the policy
+    uint8_t pending;            // A parameter update is in progress
+    uint8_t reserved;           // Padding
+    uint32_t interval_us;       // Negotiated connection interval
+    uint16_t latency;           // Negotiated peripheral latency, in connection events
+    uint16_t timeout_ms;        // Negotiated supervision timeout
+    uint16_t wakeups_per_s;     // Connection events the device must attend per second when idle
+    uint16_t reserved2;         // Padding
+    uint32_t requests;          // Parameter updates asked
+    uint32_t accepted;          // Updates applied (asked or host initiated)
+    uint32_t rejected;          // Updates refused or failed
+} armdeck_link_info_t;
+
+/* Bulk transfers carry one command payload or response longer than a packet allows.
+ * The transfer is opened by a packet (CMD_BULK_WRITE / CMD_BULK_READ), then the data
+ * travels as segments on the command characteristic: written without response by the
+ * host, notified by the device. Segments are not packets: no magic and no checksum,
+ * the link layer already checks them. Segment n holds bytes [n * segment_size,
+ * (n + 1) * segment_size) of the transfer and is stored in place, in any order.
+ * The receiver acknowledges with CMD_BULK_ACK; the sender keeps at most `window`
+ * segments beyond the last acknowledged one. */
+#define ARMDECK_BULK_MAX_LEN        2048    // Largest transfer (a full 64 button config is 1028)
+#define ARMDECK_BULK_MIN_SEGMENT    16      // Segment data bytes at the default 23 byte MTU
+#define ARMDECK_BULK_WINDOW         8       // Segments in flight before an acknowledgement
+#define ARMDECK_SEGMENT_MARKER      0xB5    // First byte of a segment (packets start with 0xAD)
+
+/* Segment header, followed by segment_size data bytes (fewer for the last segment) */
+typedef struct __attribute__((packed)) {
+    uint8_t marker;             // ARMDECK_SEGMENT_MARKER
+    uint8_t transfer_id;
+    uint16_t seq;
+} armdeck_segment_t;
+
+/* CMD_BULK_WRITE payload. CMD_BULK_READ takes the command byte then its usual payload. */
+typedef struct __attribute__((packed)) {
+    uint8_t command;            // Command the reassembled payload is run as (CMD_SET_CONFIG...)
+    uint16_t length;            // Payload bytes, up to ARMDECK_BULK_MAX_LEN
+    uint16_t segment_size;      // Data bytes per segment wanted, 0 = largest the MTU allows
+} armdeck_bulk_begin_t;
+
+/* CMD_BULK_WRITE and CMD_BULK_READ response */
+typedef struct __attribute__((packed)) {
+    uint8_t transfer_id;
+    uint8_t command;
+    uint16_t length;            // Transfer bytes (CMD_BULK_READ: error code then response payload)
+    uint16_t segment_size;      // Data bytes per segment, fits one notification or write
+    uint8_t window;             // Segments the sender may have in flight
+} armdeck_bulk_info_t;
+
+/* CMD_BULK_ACK payload. The device acknowledges uploads every half window and at the
+ * end, then notifies the response of the command. The host pulls downloads: each ack
+ * lets the device notify segments up to next_seq + window, the first one (next_seq 0)
+ * starts the download. */
+typedef struct __attribute__((packed)) {
+    uint8_t transfer_id;
+    uint16_t next_seq;          // Every segment below this one was received
+    uint32_t received;          // Bit n: segment next_seq + 1 + n already received (uploads)
+} armdeck_bulk_ack_t;
+
 /* Response packet */
 typedef struct __attribute__((packed)) {
     armdeck_header_t header;
@@ -120,7 +383,7 @@ esp_err_t armdeck_protocol_parse(const uint8_t* data, uint16_t len,
  * Build response packet
  */
 uint16_t armdeck_protocol_build_response(uint8_t cmd, uint8_t error, 
-                                         const void* payload, uint8_t payload_len,
+                                         const void* payload, uint16_t payload_len,
                                          uint8_t* output, uint16_t max_len);
 
 /**
@@ -134,6 +397,13 @@ uint8_t armdeck_protocol_checksum(const uint8_t* data, uint16_t len);
 esp_err_t armdeck_protocol_handle_command(const uint8_t* input, uint16_t input_len,
                                           uint8_t* output, uint16_t* output_len);
 
+/**
+ * Run one command on a parsed or reassembled payload, the response is built in
+ * output (up to max_len bytes). output_len is 0 when the command has no response.
+ */
+esp_err_t armdeck_protocol_dispatch(uint8_t command, const uint8_t* payload, uint16_t payload_len,
+                                    uint8_t* output, uint16_t* output_len, uint16_t max_len);
+
 /**
  * Get button configuration
  */
@@ -0,0 +1,85 @@
+#include "armdeck_repeat.h"
+#include "armdeck_hid.h"
+#include "button_matrix.h"
+#include "esp_timer.h"
+
+/* A repeat is two reports (up, then down again) so the host sees a new press */
+#define REPORTS_PER_REPEAT                  2
+
+typedef struct {
+    armdeck_action_def_t action;    // Action latched at the press
+    uint32_t interval_us;
+    int64_t deadline_us;            // Next repeat
+} repeat_slot_t;
+
+static repeat_slot_t slots[MATRIX_MAX_KEYS];
+static matrix_mask_t active_mask = 0;      // Buttons repeating
+
+static armdeck_repeat_cb_t repeat_output = NULL;
+
+esp_err_t armdeck_repeat_init(armdeck_repeat_cb_t output) {
+    active_mask = 0;
+    repeat_output = output;
+    return ESP_OK;
+}
+
+void armdeck_repeat_start(uint8_t button_id, const armdeck_action_def_t* action,
+                          const armdeck_button_ext_t* ext) {
+    if (button_id >= MATRIX_MAX_KEYS || !action || !ext || ext->repeat_delay_ms == 0) {
+        return;
+    }
+    if (action->action_type != ACTION_KEY && action->action_type != ACTION_MEDIA) {
+        return;
+    }
+    
+    /* Latch the timings so a configuration change cannot strand a repeating button */
+    repeat_slot_t* slot = &slots[button_id];
+    slot->action = *action;
+    slot->interval_us = (ext->repeat_interval_ms ? ext->repeat_interval_ms : REPEAT_DEFAULT_INTERVAL_MS) * 1000UL;
+    slot->deadline_us = esp_timer_get_time() + ext->repeat_delay_ms * 1000LL;
+    active_mask |= MATRIX_KEY_BIT(button_id);
+}
+
+void armdeck_repeat_stop(uint8_t button_id) {
+    if (button_id < MATRIX_MAX_KEYS) {
+        active_mask &= ~MATRIX_KEY_BIT(button_id);
+    }
+}
+
+int64_t armdeck_repeat_poll(int64_t now_us) {
+    if (active_mask == 0) {
+        return 0;
+    }
+    
+    /* One report per connection event: a repeat takes REPORTS_PER_REPEAT intervals of link time */
+    int64_t link_free_us = armdeck_hid_link_free_us(now_us);
+    bool connected = armdeck_hid_is_connected();
+    int64_t next_us = 0;
+    
+    for (matrix_mask_t work = active_mask; work; work &= work - 1) {
+        uint8_t button_id = __builtin_ctzll(work);
+        repeat_slot_t* slot = &slots[button_id];
+        
+        if (now_us >= slot->deadline_us && now_us >= link_free_us) {
+            if (connected && repeat_output) {
+                repeat_output(&slot->action, false);
+                repeat_output(&slot->action, true);
+                armdeck_hid_link_take(now_us, REPORTS_PER_REPEAT);
+                link_free_us = armdeck_hid_link_free_us(now_us);
+            }
+            
+            /* Keep the rate on schedule, but a late repeat is dropped rather than caught up */
+            slot->deadline_us += slot->interval_us;
+            if (slot->deadline_us <= now_us) {
+                slot->deadline_us = now_us + slot->interval_us;
+            }
+        }
+        
+        int64_t due_us = slot->deadline_us > link_free_us ? slot->deadline_us : link_free_us;
+        if (next_us == 0 || due_us < next_us) {
+            next_us = due_us;
+        }
+    }
+    
+    return next_us;
+}
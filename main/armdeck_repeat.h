@@ -0,0 +1,27 @@
+#ifndef ARMDECK_REPEAT_H
+#define ARMDECK_REPEAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "armdeck_protocol.h"
+
+/* Repeat output: the held action goes up then down again for each repeat */
+typedef void (*armdeck_repeat_cb_t)(const armdeck_action_def_t* action, bool pressed);
+
+/* Reset all repeats and set the output (before armdeck_dispatch_init) */
+esp_err_t armdeck_repeat_init(armdeck_repeat_cb_t output);
+
+/* An action went down on a button (dispatch task). Starts repeating it if the
+ * button has auto-repeat and the action is ACTION_KEY or ACTION_MEDIA. */
+void armdeck_repeat_start(uint8_t button_id, const armdeck_action_def_t* action,
+                          const armdeck_button_ext_t* ext);
+
+/* The button's action went up (dispatch task) */
+void armdeck_repeat_stop(uint8_t button_id);
+
+/* Send due repeats (dispatch task). Returns the next repeat time
+ * (esp_timer time) or 0 when no button repeats. */
+int64_t armdeck_repeat_poll(int64_t now_us);
+
+#endif /* ARMDECK_REPEAT_H */
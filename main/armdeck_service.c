@@ -1,7 +1,9 @@
 #include "armdeck_service.h"
 #include "armdeck_protocol.h"
-#include "armdeck_hid.h"
+#include "armdeck_ble.h"
+#include "armdeck_bulk.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <string.h>
 
 static const char* TAG = "ARMDECK_SERVICE";
@@ -10,12 +12,38 @@ static const char* TAG = "ARMDECK_SERVICE";
 static uint16_t service_handle = 0;
 static uint16_t command_char_handle = 0;
 static uint16_t command_char_val_handle = 0;
+static uint16_t command_cccd_handle = 0;
 static uint16_t keymap_char_handle = 0;
 static uint16_t keymap_char_val_handle = 0;
 
+/* Attributes of the service are consecutive handles after service_handle: the
+ * handle offset indexes what each one is, no comparison chain per event */
+#define SERVICE_NUM_HANDLES 16
+
+typedef enum {
+    SERVICE_ATTR_NONE = 0,
+    SERVICE_ATTR_COMMAND_VALUE,
+    SERVICE_ATTR_COMMAND_CCCD,
+    SERVICE_ATTR_KEYMAP_VALUE,
+} service_attr_t;
+
+static uint8_t attr_by_offset[SERVICE_NUM_HANDLES] = {0};
+
 /* Connection info */
 static uint16_t conn_id = 0xFFFF;
 static esp_gatt_if_t gatts_if = ESP_GATT_IF_NONE;
+static bool command_notify_enabled = false;    // Client subscribed through the CCCD
+
+/* Round trips: time from a command write to its notification being queued, and to
+ * the read that fetches it for clients without notifications (their extra ATT round trip) */
+static int64_t command_written_us = 0;
+static bool read_back_pending = false;
+static uint32_t notified_count = 0;
+static uint32_t notified_total_us = 0;
+static uint32_t notified_max_us = 0;
+static uint32_t read_back_count = 0;
+static uint32_t read_back_total_us = 0;
+static uint32_t read_back_max_us = 0;
 
 /* Service creation state */
 typedef enum {
@@ -46,6 +74,21 @@ static uint16_t command_value_len = 0;  // Track actual response length
 static uint8_t keymap_value[256] = {0};
 static uint16_t keymap_value_len = 0;   // Track actual keymap length
 
+static void set_attr(uint16_t handle, service_attr_t attr) {
+    uint16_t offset = handle - service_handle;
+    if (handle > service_handle && offset < SERVICE_NUM_HANDLES) {
+        attr_by_offset[offset] = attr;
+    }
+}
+
+static service_attr_t attr_of(uint16_t handle) {
+    uint16_t offset = handle - service_handle;
+    if (service_handle == 0 || handle <= service_handle || offset >= SERVICE_NUM_HANDLES) {
+        return SERVICE_ATTR_NONE;
+    }
+    return (service_attr_t)attr_by_offset[offset];
+}
+
 esp_err_t armdeck_service_init(void) {
     ESP_LOGI(TAG, "Initializing ArmDeck service");
     service_state = SERVICE_STATE_IDLE;
@@ -83,13 +126,102 @@ static void create_service(esp_gatt_if_t gatts_if_param) {
     
     memcpy(service_id.id.uuid.uuid.uuid128, service_uuid, 16);
     
-    esp_err_t ret = esp_ble_gatts_create_service(gatts_if, &service_id, 16);
+    esp_err_t ret = esp_ble_gatts_create_service(gatts_if, &service_id, SERVICE_NUM_HANDLES);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create service: %s", esp_err_to_name(ret));
         service_state = SERVICE_STATE_IDLE;
     }
 }
 
+static void add_keymap_characteristic(void) {
+    esp_bt_uuid_t keymap_char_uuid = {
+        .len = ESP_UUID_LEN_128,
+        .uuid = {.uuid128 = {0}}
+    };
+    memcpy(keymap_char_uuid.uuid.uuid128, keymap_uuid, 16);
+    
+    esp_err_t ret = esp_ble_gatts_add_char(
+        service_handle,
+        &keymap_char_uuid,
+        ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+        ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
+        NULL,
+        NULL
+    );
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add keymap characteristic: %s", esp_err_to_name(ret));
+    }
+}
+
+static void add_command_cccd(void) {
+    /* Client Characteristic Configuration: notifications are only sent once the client enables them */
+    esp_bt_uuid_t cccd_uuid = {
+        .len = ESP_UUID_LEN_16,
+        .uuid = {.uuid16 = ESP_GATT_UUID_CHAR_CLIENT_CONFIG}
+    };
+    
+    esp_err_t ret = esp_ble_gatts_add_char_descr(
+        service_handle,
+        &cccd_uuid,
+        ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+        NULL,
+        NULL
+    );
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add command CCCD: %s", esp_err_to_name(ret));
+    }
+}
+
+/* Run a command and keep its response as the command value (read fallback) */
+static bool run_command(const uint8_t* value, uint16_t len) {
+    uint8_t response[256];
+    uint16_t response_len = 0;
+    
+    esp_err_t ret = armdeck_protocol_handle_command(value, len, response, &response_len);
+    ESP_LOGD(TAG, "Protocol handler returned: %s, response_len=%d", esp_err_to_name(ret), response_len);
+    
+    if (response_len > 0 && response_len <= sizeof(command_value)) {
+        /* Error responses built by the command are kept too: they say what was wrong */
+        memcpy(command_value, response, response_len);
+        command_value_len = response_len;
+        ESP_LOG_BUFFER_HEX_LEVEL(TAG, response, response_len, ESP_LOG_DEBUG);
+    } else if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Protocol handler failed or no response, creating error response");
+        // Stocker une réponse d'erreur simple
+        command_value[0] = 0xAD;  // Magic 1
+        command_value[1] = 0xDC;  // Magic 2  
+        command_value[2] = 0xA1;  // CMD_NACK
+        command_value[3] = 0x01;  // Error length
+        command_value[4] = 0x01;  // ERR_INVALID_CMD
+        command_value[5] = 0x6A;  // Checksum (calculé manuellement)
+        command_value_len = 6;     // Error response is 6 bytes
+    } else {
+        /* Nothing to answer (bulk acknowledgement from the host) */
+        return false;
+    }
+    
+    read_back_pending = true;
+    return true;
+}
+
+static void notify_response(void) {
+    esp_err_t ret = armdeck_service_send_notification(command_value, command_value_len);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Response notification failed: %s", esp_err_to_name(ret));
+        return;
+    }
+    
+    uint32_t elapsed_us = esp_timer_get_time() - command_written_us;
+    notified_count++;
+    notified_total_us += elapsed_us;
+    if (elapsed_us > notified_max_us) {
+        notified_max_us = elapsed_us;
+    }
+    read_back_pending = false;
+}
+
 static void add_characteristics(void) {
     ESP_LOGI(TAG, "Adding characteristics");
     
@@ -111,7 +243,8 @@ static void add_characteristics(void) {
         service_handle,
         &command_char_uuid,
         ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-        ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_NOTIFY,
+        ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR |
+        ESP_GATT_CHAR_PROP_BIT_NOTIFY,  /* Bulk segments are written without response */
         NULL,
         NULL
     );
@@ -147,29 +280,18 @@ void armdeck_service_gatts_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gat
             }
             break;        
         case ESP_GATTS_ADD_CHAR_EVT:
-            if (param->add_char.status == ESP_GATT_OK) {
-                if (command_char_handle == 0) {
-                    command_char_handle = param->add_char.attr_handle;
-                    command_char_val_handle = command_char_handle + 1;
-                    ESP_LOGI(TAG, "Command characteristic added: %d", command_char_handle);
-                      /* Add keymap characteristic */
-                    esp_bt_uuid_t keymap_char_uuid = {
-                        .len = ESP_UUID_LEN_128,
-                        .uuid = {.uuid128 = {0}}
-                    };
-                    memcpy(keymap_char_uuid.uuid.uuid128, keymap_uuid, 16);
-                    
-                    esp_ble_gatts_add_char(
-                        service_handle,
-                        &keymap_char_uuid,
-                        ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                        ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE,
-                        NULL,
-                        NULL
-                    );
+            /* attr_handle is the value handle, the declaration comes just before it */
+            if (param->add_char.status == ESP_GATT_OK && param->add_char.service_handle == service_handle) {
+                if (command_char_val_handle == 0) {
+                    command_char_val_handle = param->add_char.attr_handle;
+                    command_char_handle = command_char_val_handle - 1;
+                    set_attr(command_char_val_handle, SERVICE_ATTR_COMMAND_VALUE);
+                    ESP_LOGI(TAG, "Command characteristic added: %d", command_char_val_handle);
+                    add_command_cccd();
                 } else {
-                    keymap_char_handle = param->add_char.attr_handle;
-                    keymap_char_val_handle = keymap_char_handle + 1;
+                    keymap_char_val_handle = param->add_char.attr_handle;
+                    keymap_char_handle = keymap_char_val_handle - 1;
+                    set_attr(keymap_char_val_handle, SERVICE_ATTR_KEYMAP_VALUE);
                     ESP_LOGI(TAG, "Keymap characteristic added: handle=%d, val_handle=%d", 
                     keymap_char_handle, keymap_char_val_handle);
                     service_state = SERVICE_STATE_READY;
@@ -181,68 +303,48 @@ void armdeck_service_gatts_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gat
             break;
             
         case ESP_GATTS_WRITE_EVT:
-            ESP_LOGI(TAG, "Write event: handle=%d, len=%d", param->write.handle, param->write.len);
+            ESP_LOGD(TAG, "Write event: handle=%d, len=%d", param->write.handle, param->write.len);
             
             // Log des données reçues pour debug
-            ESP_LOG_BUFFER_HEX(TAG, param->write.value, param->write.len);
+            ESP_LOG_BUFFER_HEX_LEVEL(TAG, param->write.value, param->write.len, ESP_LOG_DEBUG);
             
-            // ⚠️ IMPORTANT: Les writes peuvent arriver sur le handle de déclaration (84) 
-            // ou sur le handle de valeur (85). On doit accepter les deux !
-            if (param->write.handle == command_char_val_handle || param->write.handle == command_char_handle) {
-                ESP_LOGI(TAG, "Command received on handle %d (expected val=%d or decl=%d)", 
-                        param->write.handle, command_char_val_handle, command_char_handle);
-                
-                /* Handle command avec le protocole */
-                uint8_t response[256];
-                uint16_t response_len = 0;
-                
-                ESP_LOGI(TAG, "Calling armdeck_protocol_handle_command...");
-                esp_err_t ret = armdeck_protocol_handle_command(
-                    param->write.value,
-                    param->write.len,
-                    response,
-                    &response_len
-                );
-                
-                ESP_LOGI(TAG, "Protocol handler returned: %s, response_len=%d", 
-                        esp_err_to_name(ret), response_len);
-                  if (ret == ESP_OK && response_len > 0) {
-                    ESP_LOGI(TAG, "Storing response in command_value for next read");
-                    // Stocker la réponse pour le prochain read
-                    if (response_len <= sizeof(command_value)) {
-                        memcpy(command_value, response, response_len);
-                        command_value_len = response_len;  // Store actual length
-                        
-                        // Log de la réponse générée
-                        ESP_LOGI(TAG, "Generated response:");
-                        ESP_LOG_BUFFER_HEX(TAG, response, response_len);
+            bool has_response = false;
+            switch (attr_of(param->write.handle)) {
+                case SERVICE_ATTR_COMMAND_CCCD:
+                    if (param->write.len == 2) {
+                        /* Bit 0: notifications. Indications are not offered. */
+                        command_notify_enabled = param->write.value[0] & 0x01;
+                        ESP_LOGI(TAG, "Command notifications %s", command_notify_enabled ? "enabled" : "disabled");
+                    }
+                    break;
+                    
+                case SERVICE_ATTR_COMMAND_VALUE:
+                    if (param->write.len > 0 && param->write.value[0] == ARMDECK_SEGMENT_MARKER) {
+                        /* Bulk segment: stored in place, acknowledged by notification, nothing to read back */
+                        armdeck_bulk_receive_segment(param->write.value, param->write.len);
                     } else {
-                        ESP_LOGE(TAG, "Response too large: %d bytes", response_len);
+                        ESP_LOGI(TAG, "Command received (%d bytes)", param->write.len);
+                        command_written_us = esp_timer_get_time();
+                        has_response = run_command(param->write.value, param->write.len);
                     }
-                } else {
-                    ESP_LOGE(TAG, "Protocol handler failed or no response, creating error response");
-                    // Stocker une réponse d'erreur simple
-                    command_value[0] = 0xAD;  // Magic 1
-                    command_value[1] = 0xDC;  // Magic 2  
-                    command_value[2] = 0xA1;  // CMD_NACK
-                    command_value[3] = 0x01;  // Error length
-                    command_value[4] = 0x01;  // ERR_INVALID_CMD
-                    command_value[5] = 0x6A;  // Checksum (calculé manuellement)
-                    command_value_len = 6;     // Error response is 6 bytes
-                    ESP_LOGI(TAG, "Error response stored");
-                }            } else if (param->write.handle == keymap_char_val_handle || param->write.handle == keymap_char_handle) {
-                /* Handle keymap write */
-                ESP_LOGI(TAG, "Keymap write received on handle %d", param->write.handle);
-                if (param->write.len <= sizeof(keymap_value)) {
-                    memcpy(keymap_value, param->write.value, param->write.len);
-                    keymap_value_len = param->write.len;  // Store actual keymap length
-                } else {
-                    ESP_LOGE(TAG, "Keymap write too large: %d", param->write.len);
-                }
-            }else {
-                ESP_LOGW(TAG, "Write on unknown handle: %d (cmd_decl=%d, cmd_val=%d, keymap_decl=%d, keymap_val=%d)", 
-                        param->write.handle, command_char_handle, command_char_val_handle, 
-                        keymap_char_handle, keymap_char_val_handle);
+                    break;
+                    
+                case SERVICE_ATTR_KEYMAP_VALUE:
+                    /* Handle keymap write */
+                    ESP_LOGI(TAG, "Keymap write received on handle %d", param->write.handle);
+                    if (param->write.len <= sizeof(keymap_value)) {
+                        memcpy(keymap_value, param->write.value, param->write.len);
+                        keymap_value_len = param->write.len;  // Store actual keymap length
+                    } else {
+                        ESP_LOGE(TAG, "Keymap write too large: %d", param->write.len);
+                    }
+                    break;
+                    
+                default:
+                    ESP_LOGW(TAG, "Write on unknown handle: %d (cmd_val=%d, cmd_cccd=%d, keymap_val=%d)", 
+                            param->write.handle, command_char_val_handle, command_cccd_handle,
+                            keymap_char_val_handle);
+                    break;
             }
             
             /* Always send response if needed */
@@ -255,33 +357,64 @@ void armdeck_service_gatts_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gat
                     ESP_LOGI(TAG, "✅ Write response sent successfully");
                 }
             }
+            
+            /* Subscribed clients get the response on the command value handle, right
+             * after the write is acknowledged; the others read it back */
+            if (has_response && command_notify_enabled) {
+                notify_response();
+            }
             break;
         case ESP_GATTS_READ_EVT:
             ESP_LOGI(TAG, "Read event: handle=%d", param->read.handle);
             
             esp_gatt_rsp_t rsp = {0};
             rsp.attr_value.handle = param->read.handle;
-              // ✅ FIX : Gérer les reads sur TOUS les handles de commande
-            if (param->read.handle == command_char_handle || 
-                param->read.handle == command_char_val_handle) {
-                
-                // Renvoyer la réponse stockée avec la vraie longueur
-                rsp.attr_value.len = command_value_len;  // Use actual length instead of 256
-                memcpy(rsp.attr_value.value, command_value, rsp.attr_value.len);
-                ESP_LOGI(TAG, "Sending command response: %d bytes (actual length)", rsp.attr_value.len);
-                ESP_LOG_BUFFER_HEX(TAG, rsp.attr_value.value, rsp.attr_value.len);
-                
-            } else if (param->read.handle == keymap_char_handle ||
-                    param->read.handle == keymap_char_val_handle) {
-                
-                rsp.attr_value.len = keymap_value_len;  // Use actual keymap length
-                memcpy(rsp.attr_value.value, keymap_value, rsp.attr_value.len);
-                ESP_LOGI(TAG, "Sending keymap response: %d bytes (actual length)", rsp.attr_value.len);
+            rsp.attr_value.offset = param->read.offset;
+            
+            /* Values longer than MTU - 1 are read in pieces (Read Blob): serve the piece
+             * at the requested offset, sized to the MTU of this connection */
+            const uint8_t* value = NULL;
+            uint16_t value_len = 0;
+            uint16_t max_len = armdeck_ble_get_mtu(param->read.conn_id) - 1;
+            uint8_t cccd_value[2] = { command_notify_enabled ? 0x01 : 0x00, 0x00 };
+            switch (attr_of(param->read.handle)) {
+                case SERVICE_ATTR_COMMAND_VALUE:
+                    value = command_value;
+                    value_len = command_value_len;
                 
-            } else {
-                ESP_LOGW(TAG, "Read on unknown handle: %d", param->read.handle);
-                // Envoyer une réponse vide pour les handles inconnus
-                rsp.attr_value.len = 0;
+                    if (read_back_pending && param->read.offset == 0) {
+                        uint32_t elapsed_us = esp_timer_get_time() - command_written_us;
+                        read_back_count++;
+                        read_back_total_us += elapsed_us;
+                        if (elapsed_us > read_back_max_us) {
+                            read_back_max_us = elapsed_us;
+                        }
+                        read_back_pending = false;
+                    }
+                    break;
+                    
+                case SERVICE_ATTR_COMMAND_CCCD:
+                    value = cccd_value;
+                    value_len = sizeof(cccd_value);
+                    break;
+                    
+                case SERVICE_ATTR_KEYMAP_VALUE:
+                    value = keymap_value;
+                    value_len = keymap_value_len;
+                    break;
+                    
+                default:
+                    ESP_LOGW(TAG, "Read on unknown handle: %d", param->read.handle);
+                    break;
+            }
+            
+            if (value && param->read.offset < value_len) {
+                rsp.attr_value.len = value_len - param->read.offset;
+                if (rsp.attr_value.len > max_len) {
+                    rsp.attr_value.len = max_len;
+                }
+                memcpy(rsp.attr_value.value, value + param->read.offset, rsp.attr_value.len);
+                ESP_LOGI(TAG, "Sending %d of %d bytes at offset %d", rsp.attr_value.len, value_len, param->read.offset);
             }
             
             esp_err_t ret = esp_ble_gatts_send_response(gatts_if, param->read.conn_id, 
@@ -292,16 +425,27 @@ void armdeck_service_gatts_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gat
                 ESP_LOGI(TAG, "✅ Read response sent successfully");            }
             break;
             
+        case ESP_GATTS_ADD_CHAR_DESCR_EVT:
+            if (param->add_char_descr.status == ESP_GATT_OK &&
+                param->add_char_descr.service_handle == service_handle) {
+                command_cccd_handle = param->add_char_descr.attr_handle;
+                set_attr(command_cccd_handle, SERVICE_ATTR_COMMAND_CCCD);
+                ESP_LOGI(TAG, "Command CCCD added: %d", command_cccd_handle);
+                add_keymap_characteristic();
+            }
+            break;
+            
         case ESP_GATTS_CONNECT_EVT:
             conn_id = param->connect.conn_id;
+            command_notify_enabled = false;
             ESP_LOGI(TAG, "Device connected, conn_id=%d", conn_id);
-            
-            /* Force HID connection state when custom service connects */
-            armdeck_hid_force_connected(conn_id);
             break;
             
         case ESP_GATTS_DISCONNECT_EVT:
             conn_id = 0xFFFF;
+            command_notify_enabled = false;
+            read_back_pending = false;
+            armdeck_bulk_reset();
             ESP_LOGI(TAG, "Device disconnected");
             break;
             
@@ -315,18 +459,11 @@ bool armdeck_service_is_ready(void) {
 }
 
 esp_err_t armdeck_service_send_notification(const uint8_t* data, uint16_t len) {
-    if (conn_id == 0xFFFF || gatts_if == ESP_GATT_IF_NONE) {
+    if (conn_id == 0xFFFF || gatts_if == ESP_GATT_IF_NONE || !command_notify_enabled) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    return esp_ble_gatts_send_indicate(
-        gatts_if,
-        conn_id,
-        command_char_val_handle,
-        len,
-        (uint8_t*)data,
-        false  /* notification, not indication */
-    );
+    return armdeck_ble_notify(gatts_if, conn_id, command_char_val_handle, data, len);
 }
 
 uint16_t armdeck_service_get_conn_id(void) {
@@ -335,4 +472,15 @@ uint16_t armdeck_service_get_conn_id(void) {
 
 esp_gatt_if_t armdeck_service_get_gatts_if(void) {
     return gatts_if;
+}
+
+void armdeck_service_log_stats(void) {
+    if (notified_count == 0 && read_back_count == 0) {
+        return;
+    }
+    
+    ESP_LOGI(TAG, "Command responses: %lu notified (write to notification %lu us avg, %lu max), "
+             "%lu read back (write to read %lu us avg, %lu max)",
+             notified_count, notified_count ? notified_total_us / notified_count : 0, notified_max_us,
+             read_back_count, read_back_count ? read_back_total_us / read_back_count : 0, read_back_max_us);
 }
\ No newline at end of file
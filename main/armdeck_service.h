@@ -27,7 +27,7 @@ void armdeck_service_gatts_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gat
 /* Check if service is ready */
 bool armdeck_service_is_ready(void);
 
-/* Send notification on command characteristic */
+/* Send notification on command characteristic (only once the client subscribed) */
 esp_err_t armdeck_service_send_notification(const uint8_t* data, uint16_t len);
 
 /* Get current connection ID */
@@ -36,4 +36,7 @@ uint16_t armdeck_service_get_conn_id(void);
 /* Get GATTS interface */
 esp_gatt_if_t armdeck_service_get_gatts_if(void);
 
+/* Log command response counts and write to response times (notified or read back) */
+void armdeck_service_log_stats(void);
+
 #endif /* ARMDECK_SERVICE_H */
\ No newline at end of file
@@ -2,44 +2,206 @@
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "esp_cpu.h"
+#include "soc/soc.h"
+#include "soc/soc_caps.h"
+#include "soc/gpio_reg.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <string.h>
+
+_Static_assert(ARMDECK_MAX_BUTTONS <= MATRIX_MAX_KEYS &&
+               ARMDECK_MAX_ROWS <= MATRIX_MAX_ROWS && ARMDECK_MAX_COLS <= MATRIX_MAX_COLS,
+               "protocol geometry limits exceed the matrix driver limits");
 
 static const char* TAG = "ARMDECK_MATRIX";
 
-/* GPIO pins for rows (outputs) */
-static const int row_pins[MATRIX_ROWS] = {
-    GPIO_NUM_2,   // ROW1 - Buttons 1,2,3,4,5
-    GPIO_NUM_4,   // ROW2 - Buttons 6,7,8,9,10
-    GPIO_NUM_5    // ROW3 - Buttons 11,12,13,14,15
-};
+/* Matrix geometry, set at init (button n = row * num_cols + col) */
+static uint8_t num_rows = 0;
+static uint8_t num_cols = 0;
+static int row_pins[MATRIX_MAX_ROWS];   // Outputs
+static int col_pins[MATRIX_MAX_COLS];   // Inputs with pull-up
 
-/* GPIO pins for columns (inputs with pull-up) */
-static const int col_pins[MATRIX_COLS] = {
-    GPIO_NUM_18,  // COL1 - Buttons 1,6,11
-    GPIO_NUM_19,  // COL2 - Buttons 2,7,12
-    GPIO_NUM_21,  // COL3 - Buttons 3,8,13
-    GPIO_NUM_22,  // COL4 - Buttons 4,9,14
-    GPIO_NUM_23   // COL5 - Buttons 5,10,15
-};
+/* Scanner core and button state tracking (matrix_scan.c), owned by the scan task */
+static matrix_scanner_t scanner;
 
-/* Button state tracking */
-static bool button_states[TOTAL_BUTTONS] = {false};
-static bool button_last_states[TOTAL_BUTTONS] = {false};
-static uint32_t button_last_change[TOTAL_BUTTONS] = {0};
+/* Column reads: set when a column lives in the second input register */
+static bool cols_use_in1 = false;
+
+/* Debounce strategy and timings (owned by the scan task) */
+static debounce_config_t debounce_cfg = {
+    .algo = DEBOUNCE_DEFAULT_ALGO,
+    .press_ms = DEBOUNCE_DEFAULT_PRESS_MS,
+    .release_ms = DEBOUNCE_DEFAULT_RELEASE_MS
+};
+static debounce_config_t pending_debounce_cfg;
+static volatile bool debounce_cfg_pending = false;
 
 /* Task handle */
 static TaskHandle_t scan_task_handle = NULL;
 static bool scanning_enabled = false;
 
+/* Scan task notification bits */
+#define SCAN_NOTIFY_TICK    (1UL << 0)  // Scan timer period elapsed
+#define SCAN_NOTIFY_WAKE    (1UL << 1)  // Column edge while idle
+#define SCAN_NOTIFY_CTRL    (1UL << 2)  // Stop, mode or settings change
+
+/* Scan timer */
+static esp_timer_handle_t scan_timer = NULL;
+static uint16_t scan_rate_hz = SCAN_DEFAULT_RATE_HZ;
+static volatile uint16_t pending_scan_rate_hz = 0;     // 0 = nothing pending
+
+/* Scan mode */
+static volatile matrix_scan_mode_t scan_mode = MATRIX_DEFAULT_SCAN_MODE;
+static matrix_scan_mode_t active_mode = MATRIX_DEFAULT_SCAN_MODE;
+
+/* Interrupt wake state */
+static volatile int64_t wake_edge_us = 0;       // Timestamp of the column edge that woke us
+static volatile bool wake_armed = false;
+
+/* Latency statistics per scan mode */
+typedef struct {
+    uint32_t samples;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} latency_acc_t;
+
+static latency_acc_t latency[MATRIX_SCAN_MODE_COUNT];
+
+/* Scan pass cost */
+typedef struct {
+    uint32_t passes;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+} cycles_acc_t;
+
+static cycles_acc_t scan_cost;
+
+/* Scan interval statistics */
+typedef struct {
+    uint32_t samples;
+    uint32_t min_interval_us;
+    uint32_t max_interval_us;
+    uint32_t max_jitter_us;
+    uint64_t total_interval_us;
+    uint64_t total_jitter_us;
+} jitter_acc_t;
+
+static jitter_acc_t jitter;
+static int64_t last_tick_us = 0;    // 0 = timer (re)started, next tick starts a new interval
+
 /* Callback */
 static button_event_cb_t event_callback = NULL;
 
-esp_err_t armdeck_matrix_init(void) {
-    ESP_LOGI(TAG, "Initializing 5x3 button matrix...");
+/* Drive a row through the set/clear registers */
+static inline void row_write(int row, int level) {
+    int pin = row_pins[row];
+#if SOC_GPIO_PIN_COUNT > 32
+    if (pin >= 32) {
+        REG_WRITE(level ? GPIO_OUT1_W1TS_REG : GPIO_OUT1_W1TC_REG, 1UL << (pin - 32));
+        return;
+    }
+#endif
+    REG_WRITE(level ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, 1UL << pin);
+}
+
+/* Sample every column of the active row in one register read, bit n set = column n low */
+static inline uint32_t read_cols(void) {
+    uint32_t in = REG_READ(GPIO_IN_REG);
+#if SOC_GPIO_PIN_COUNT > 32
+    uint32_t in1 = cols_use_in1 ? REG_READ(GPIO_IN1_REG) : 0;
+#endif
+    uint32_t bits = 0;
+    
+    for (int col = 0; col < num_cols; col++) {
+        int pin = col_pins[col];
+#if SOC_GPIO_PIN_COUNT > 32
+        uint32_t level = pin >= 32 ? (in1 >> (pin - 32)) : (in >> pin);
+#else
+        uint32_t level = in >> pin;
+#endif
+        bits |= (~level & 1) << col;
+    }
+    return bits;
+}
+
+/* Scanner port on the ESP32 GPIO registers */
+static void port_row_write(void* ctx, uint8_t row, bool level) {
+    row_write(row, level);
+}
+
+static uint32_t port_read_cols(void* ctx) {
+    return read_cols();
+}
+
+static void port_delay_us(void* ctx, uint32_t us) {
+    esp_rom_delay_us(us);
+}
+
+static int64_t port_now_us(void* ctx) {
+    return esp_timer_get_time();
+}
+
+static const matrix_port_t esp_port = {
+    .row_write = port_row_write,
+    .read_cols = port_read_cols,
+    .delay_us = port_delay_us,
+    .now_us = port_now_us,
+    .ctx = NULL
+};
+
+/* Column edge ISR - only used in interrupt scan mode */
+static void IRAM_ATTR col_edge_isr(void* arg) {
+    if (!wake_armed) {
+        return;
+    }
+    wake_armed = false;
+    
+    /* Disable all column interrupts, the scan task takes over from here */
+    for (int i = 0; i < num_cols; i++) {
+        gpio_intr_disable(col_pins[i]);
+    }
+    
+    wake_edge_us = esp_timer_get_time();
+    
+    BaseType_t higher_prio_woken = pdFALSE;
+    if (scan_task_handle) {
+        xTaskNotifyFromISR(scan_task_handle, SCAN_NOTIFY_WAKE, eSetBits, &higher_prio_woken);
+    }
+    portYIELD_FROM_ISR(higher_prio_woken);
+}
+
+/* Scan timer callback - runs in the esp_timer task */
+static void scan_timer_cb(void* arg) {
+    if (scan_task_handle) {
+        xTaskNotify(scan_task_handle, SCAN_NOTIFY_TICK, eSetBits);
+    }
+}
+
+esp_err_t armdeck_matrix_init(uint8_t rows, uint8_t cols, const uint8_t* row_gpios, const uint8_t* col_gpios) {
+    if (!row_gpios || !col_gpios || rows == 0 || cols == 0 ||
+        rows > MATRIX_MAX_ROWS || cols > MATRIX_MAX_COLS || rows * cols > MATRIX_MAX_KEYS) {
+        ESP_LOGE(TAG, "Invalid matrix geometry: %d rows x %d cols", rows, cols);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    ESP_LOGI(TAG, "Initializing %dx%d button matrix...", cols, rows);
+    
+    num_rows = rows;
+    num_cols = cols;
+    cols_use_in1 = false;
+    for (int i = 0; i < rows; i++) {
+        row_pins[i] = row_gpios[i];
+    }
+    for (int i = 0; i < cols; i++) {
+        col_pins[i] = col_gpios[i];
+    }
     
     /* Configure row pins (outputs, high by default) */
-    for (int i = 0; i < MATRIX_ROWS; i++) {
+    for (int i = 0; i < num_rows; i++) {
         gpio_reset_pin(row_pins[i]);
         gpio_set_direction(row_pins[i], GPIO_MODE_OUTPUT);
         gpio_set_level(row_pins[i], 1);
@@ -47,21 +209,58 @@ esp_err_t armdeck_matrix_init(void) {
     }
     
     /* Configure column pins (inputs with pull-up) */
-    for (int i = 0; i < MATRIX_COLS; i++) {
+    for (int i = 0; i < num_cols; i++) {
         gpio_reset_pin(col_pins[i]);
         gpio_set_direction(col_pins[i], GPIO_MODE_INPUT);
         gpio_set_pull_mode(col_pins[i], GPIO_PULLUP_ONLY);
         ESP_LOGD(TAG, "Col %d on GPIO %d", i + 1, col_pins[i]);
+        if (col_pins[i] >= 32) {
+            cols_use_in1 = true;
+        }
+    }
+    
+    /* Column edge interrupts for the interrupt scan mode (disabled until armed) */
+    esp_err_t ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install ISR service: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    for (int i = 0; i < num_cols; i++) {
+        gpio_set_intr_type(col_pins[i], GPIO_INTR_NEGEDGE);
+        ret = gpio_isr_handler_add(col_pins[i], col_edge_isr, NULL);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to add ISR on col %d: %s", i + 1, esp_err_to_name(ret));
+            return ret;
+        }
+        gpio_intr_disable(col_pins[i]);
+    }
+    
+    /* Scan timer, started by the scan task */
+    if (scan_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = scan_timer_cb,
+            .name = "matrix_scan"
+        };
+        ret = esp_timer_create(&timer_args, &scan_timer);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create scan timer: %s", esp_err_to_name(ret));
+            return ret;
+        }
     }
     
     /* Initialize button states */
-    for (int i = 0; i < TOTAL_BUTTONS; i++) {
-        button_states[i] = false;
-        button_last_states[i] = false;
-        button_last_change[i] = 0;
+    matrix_scanner_init(&scanner, &esp_port, rows, cols, &debounce_cfg);
+    
+    for (int i = 0; i < MATRIX_SCAN_MODE_COUNT; i++) {
+        latency[i] = (latency_acc_t){ .min_us = UINT32_MAX };
     }
+    scan_cost = (cycles_acc_t){ .min_cycles = UINT32_MAX };
+    jitter = (jitter_acc_t){ .min_interval_us = UINT32_MAX };
     
-    ESP_LOGI(TAG, "Button matrix initialized");
+    ESP_LOGI(TAG, "Button matrix initialized (scan mode: %s, %d Hz, debounce: %s %d/%d ms)",
+             scan_mode == MATRIX_SCAN_INTERRUPT ? "interrupt" : "polling", scan_rate_hz,
+             scanner.debounce->name, debounce_cfg.press_ms, debounce_cfg.release_ms);
     return ESP_OK;
 }
 
@@ -69,54 +268,210 @@ void armdeck_matrix_set_callback(button_event_cb_t callback) {
     event_callback = callback;
 }
 
-static void scan_matrix(void) {
-    uint32_t current_time = esp_timer_get_time() / 1000; // Convert to ms
+static void record_latency(int64_t edge_us, int64_t now_us) {
+    if (edge_us <= 0 || now_us < edge_us) {
+        return;
+    }
+    
+    uint32_t delta = (uint32_t)(now_us - edge_us);
+    latency_acc_t* acc = &latency[active_mode];
+    acc->samples++;
+    acc->total_us += delta;
+    if (delta < acc->min_us) {
+        acc->min_us = delta;
+    }
+    if (delta > acc->max_us) {
+        acc->max_us = delta;
+    }
+}
+
+static void record_scan_cost(uint32_t cycles) {
+    scan_cost.passes++;
+    scan_cost.total_cycles += cycles;
+    if (cycles < scan_cost.min_cycles) {
+        scan_cost.min_cycles = cycles;
+    }
+    if (cycles > scan_cost.max_cycles) {
+        scan_cost.max_cycles = cycles;
+    }
+}
+
+/* Debounced transition from the scanner core */
+static void on_key_event(void* arg, uint8_t button_id, bool pressed, int64_t edge_us) {
+    /* Trigger callback if registered */
+    if (event_callback) {
+        event_callback(button_id, pressed);
+    }
+
+    if (pressed) {
+        record_latency(edge_us, esp_timer_get_time());
+    }
+
+    ESP_LOGD(TAG, "Button %d %s", button_id + 1, pressed ? "pressed" : "released");
+}
+
+/* Scan the matrix once. Returns true while any key is down or bouncing.
+ * edge_hint_us, when non-zero, is the time the transitions were really first seen (wake edge). */
+static bool scan_matrix(int64_t edge_hint_us) {
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
+    matrix_mask_t sample = matrix_scanner_sample(&scanner);
+    bool active = matrix_scanner_update(&scanner, sample, edge_hint_us, on_key_event, NULL);
+    
+    record_scan_cost(esp_cpu_get_cycle_count() - start_cycles);
+    return active;
+}
+
+/* Switch debounce strategy from the scan task, keys restart from their current debounced state */
+static void apply_debounce_config(void) {
+    debounce_cfg_pending = false;
+    debounce_cfg = pending_debounce_cfg;
     
-    for (int row = 0; row < MATRIX_ROWS; row++) {
-        /* Activate current row (set low) */
+    /* Before init the configuration is only kept for armdeck_matrix_init */
+    if (scanner.port) {
+        matrix_scanner_set_debounce(&scanner, &debounce_cfg);
+    }
+    
+    ESP_LOGI(TAG, "Debounce set to %s (press %d ms, release %d ms)",
+             debounce_get_strategy(debounce_cfg.algo)->name, debounce_cfg.press_ms, debounce_cfg.release_ms);
+}
+
+/* Drive all rows low and enable column edge interrupts.
+ * Returns false if a key is already down (no edge would ever fire). */
+static bool arm_wake(void) {
+    for (int row = 0; row < num_rows; row++) {
         gpio_set_level(row_pins[row], 0);
+    }
+    esp_rom_delay_us(10);
+    
+    wake_armed = true;
+    for (int col = 0; col < num_cols; col++) {
+        gpio_intr_enable(col_pins[col]);
+    }
+    
+    /* Close the race between the last scan and arming */
+    return read_cols() == 0;
+}
+
+static void disarm_wake(void) {
+    wake_armed = false;
+    for (int col = 0; col < num_cols; col++) {
+        gpio_intr_disable(col_pins[col]);
+    }
+    for (int row = 0; row < num_rows; row++) {
+        gpio_set_level(row_pins[row], 1);
+    }
+}
+
+static void scan_timer_start(void) {
+    last_tick_us = 0;
+    esp_timer_start_periodic(scan_timer, 1000000UL / scan_rate_hz);
+}
+
+static void scan_timer_stop(void) {
+    /* ESP_ERR_INVALID_STATE when already stopped is fine */
+    esp_timer_stop(scan_timer);
+}
+
+/* Switch scan rate from the scan task */
+static void apply_scan_rate(void) {
+    scan_rate_hz = pending_scan_rate_hz;
+    pending_scan_rate_hz = 0;
+    
+    scan_timer_stop();
+    scan_timer_start();
+    
+    ESP_LOGI(TAG, "Scan rate set to %d Hz", scan_rate_hz);
+}
+
+/* Measure the interval between two timer driven scans */
+static void record_tick(int64_t now_us) {
+    if (last_tick_us != 0) {
+        uint32_t interval = (uint32_t)(now_us - last_tick_us);
+        uint32_t period = 1000000UL / scan_rate_hz;
+        uint32_t deviation = interval > period ? interval - period : period - interval;
         
-        /* Small delay for signal stabilization */
-        esp_rom_delay_us(10);
-        
-        /* Read all columns */
-        for (int col = 0; col < MATRIX_COLS; col++) {
-            int button_id = (row * MATRIX_COLS) + col;
-            bool current_state = (gpio_get_level(col_pins[col]) == 0); // Pressed = low
-            
-            /* Debounce logic */
-            if (current_state != button_last_states[button_id]) {
-                button_last_change[button_id] = current_time;
-                button_last_states[button_id] = current_state;
-            } else if ((current_time - button_last_change[button_id]) > DEBOUNCE_DELAY_MS) {
-                /* State has been stable for debounce period */
-                if (current_state != button_states[button_id]) {
-                    button_states[button_id] = current_state;
-                    
-                    /* Trigger callback if registered */
-                    if (event_callback) {
-                        event_callback(button_id, current_state);
-                    }
-                    
-                    ESP_LOGI(TAG, "Button %d %s", button_id + 1,
-                            current_state ? "pressed" : "released");
-                }
-            }
+        jitter.samples++;
+        jitter.total_interval_us += interval;
+        jitter.total_jitter_us += deviation;
+        if (interval < jitter.min_interval_us) {
+            jitter.min_interval_us = interval;
+        }
+        if (interval > jitter.max_interval_us) {
+            jitter.max_interval_us = interval;
+        }
+        if (deviation > jitter.max_jitter_us) {
+            jitter.max_jitter_us = deviation;
         }
-        
-        /* Deactivate current row (set high) */
-        gpio_set_level(row_pins[row], 1);
     }
+    last_tick_us = now_us;
+}
+
+/* Block until one of the wanted notification bits is set */
+static uint32_t wait_events(uint32_t wanted) {
+    uint32_t events = 0;
+    do {
+        xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+    } while (!(events & wanted));
+    return events;
 }
 
 static void scan_task(void* pvParameters) {
     ESP_LOGI(TAG, "Button scan task started");
     
+    int64_t last_activity_us = esp_timer_get_time();
+    scan_timer_start();
+    
     while (scanning_enabled) {
-        scan_matrix();
-        vTaskDelay(pdMS_TO_TICKS(SCAN_PERIOD_MS));
+        uint32_t events = wait_events(SCAN_NOTIFY_TICK | SCAN_NOTIFY_CTRL);
+        int64_t edge_hint_us = 0;
+        
+        if (!scanning_enabled) {
+            break;
+        }
+        
+        active_mode = scan_mode;
+        
+        if (debounce_cfg_pending) {
+            apply_debounce_config();
+        }
+        if (pending_scan_rate_hz) {
+            apply_scan_rate();
+        }
+        
+        /* Settings change only, wait for the timer */
+        if (!(events & SCAN_NOTIFY_TICK)) {
+            continue;
+        }
+        
+        int64_t now_us = esp_timer_get_time();
+        record_tick(now_us);
+        
+        if (active_mode == MATRIX_SCAN_INTERRUPT &&
+            (now_us - last_activity_us) > (IDLE_TIMEOUT_MS * 1000LL)) {
+            /* Nothing happening: stop the timer and sleep until a column edge fires */
+            scan_timer_stop();
+            if (arm_wake()) {
+                ESP_LOGD(TAG, "Matrix idle, waiting for column edge");
+                wait_events(SCAN_NOTIFY_WAKE | SCAN_NOTIFY_CTRL);
+            }
+            disarm_wake();
+            
+            if (!scanning_enabled) {
+                break;
+            }
+            
+            edge_hint_us = wake_edge_us;
+            wake_edge_us = 0;
+            last_activity_us = esp_timer_get_time();
+            scan_timer_start();
+        }
+        
+        if (scan_matrix(edge_hint_us)) {
+            last_activity_us = esp_timer_get_time();
+        }
     }
     
+    scan_timer_stop();
     ESP_LOGI(TAG, "Button scan task stopped");
     vTaskDelete(NULL);
 }
@@ -148,23 +503,160 @@ esp_err_t armdeck_matrix_stop(void) {
     
     scanning_enabled = false;
     
+    /* Wake the task if it is waiting for a column edge or the timer */
+    xTaskNotify(scan_task_handle, SCAN_NOTIFY_CTRL, eSetBits);
+    
     /* Wait for task to finish */
-    vTaskDelay(pdMS_TO_TICKS(SCAN_PERIOD_MS * 2));
+    vTaskDelay(pdMS_TO_TICKS(20));
     
     scan_task_handle = NULL;
     ESP_LOGI(TAG, "Matrix scanning stopped");
     return ESP_OK;
 }
 
+void armdeck_matrix_set_scan_mode(matrix_scan_mode_t mode) {
+    if (mode >= MATRIX_SCAN_MODE_COUNT) {
+        return;
+    }
+    
+    scan_mode = mode;
+    
+    /* Leave a pending interrupt wait so the new mode takes effect now */
+    if (mode == MATRIX_SCAN_POLLING && scan_task_handle) {
+        xTaskNotify(scan_task_handle, SCAN_NOTIFY_CTRL, eSetBits);
+    }
+    
+    ESP_LOGI(TAG, "Scan mode set to %s", mode == MATRIX_SCAN_INTERRUPT ? "interrupt" : "polling");
+}
+
+matrix_scan_mode_t armdeck_matrix_get_scan_mode(void) {
+    return scan_mode;
+}
+
+esp_err_t armdeck_matrix_set_scan_rate(uint16_t rate_hz) {
+    if (rate_hz < SCAN_MIN_RATE_HZ || rate_hz > SCAN_MAX_RATE_HZ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (rate_hz == scan_rate_hz && !pending_scan_rate_hz) {
+        return ESP_OK;
+    }
+    
+    if (scan_task_handle == NULL) {
+        /* Not scanning: picked up by the next start */
+        scan_rate_hz = rate_hz;
+        ESP_LOGI(TAG, "Scan rate set to %d Hz", scan_rate_hz);
+    } else {
+        pending_scan_rate_hz = rate_hz;
+        xTaskNotify(scan_task_handle, SCAN_NOTIFY_CTRL, eSetBits);
+    }
+    return ESP_OK;
+}
+
+uint16_t armdeck_matrix_get_scan_rate(void) {
+    return scan_rate_hz;
+}
+
+esp_err_t armdeck_matrix_set_debounce(const debounce_config_t* cfg) {
+    if (!debounce_config_valid(cfg)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    pending_debounce_cfg = *cfg;
+    
+    if (scan_task_handle == NULL) {
+        /* Not scanning: apply right away */
+        apply_debounce_config();
+    } else {
+        debounce_cfg_pending = true;
+        
+        /* Make the scan task leave an idle wait to pick it up */
+        xTaskNotify(scan_task_handle, SCAN_NOTIFY_CTRL, eSetBits);
+    }
+    return ESP_OK;
+}
+
+uint8_t armdeck_matrix_get_num_keys(void) {
+    return scanner.num_keys;
+}
+
+esp_err_t armdeck_matrix_get_scan_cost(matrix_scan_cost_t* cost) {
+    if (!cost) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    cost->passes = scan_cost.passes;
+    cost->min_cycles = scan_cost.passes ? scan_cost.min_cycles : 0;
+    cost->max_cycles = scan_cost.max_cycles;
+    cost->avg_cycles = scan_cost.passes ? (uint32_t)(scan_cost.total_cycles / scan_cost.passes) : 0;
+    return ESP_OK;
+}
+
+esp_err_t armdeck_matrix_get_jitter_stats(matrix_jitter_stats_t* stats) {
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    stats->samples = jitter.samples;
+    stats->period_us = 1000000UL / scan_rate_hz;
+    stats->min_interval_us = jitter.samples ? jitter.min_interval_us : 0;
+    stats->max_interval_us = jitter.max_interval_us;
+    stats->avg_interval_us = jitter.samples ? (uint32_t)(jitter.total_interval_us / jitter.samples) : 0;
+    stats->max_jitter_us = jitter.max_jitter_us;
+    stats->avg_jitter_us = jitter.samples ? (uint32_t)(jitter.total_jitter_us / jitter.samples) : 0;
+    return ESP_OK;
+}
+
+esp_err_t armdeck_matrix_get_latency_stats(matrix_scan_mode_t mode, matrix_latency_stats_t* stats) {
+    if (mode >= MATRIX_SCAN_MODE_COUNT || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    const latency_acc_t* acc = &latency[mode];
+    stats->samples = acc->samples;
+    stats->min_us = acc->samples ? acc->min_us : 0;
+    stats->max_us = acc->max_us;
+    stats->avg_us = acc->samples ? (uint32_t)(acc->total_us / acc->samples) : 0;
+    return ESP_OK;
+}
+
+void armdeck_matrix_log_latency(void) {
+    static const char* mode_names[MATRIX_SCAN_MODE_COUNT] = { "polling", "interrupt" };
+    
+    for (int mode = 0; mode < MATRIX_SCAN_MODE_COUNT; mode++) {
+        matrix_latency_stats_t stats;
+        armdeck_matrix_get_latency_stats(mode, &stats);
+        
+        /* Polling cannot see the physical edge: up to one scan period of sampling delay comes on top */
+        ESP_LOGI(TAG, "Latency %-9s: n=%lu min=%lu us avg=%lu us max=%lu us (+%lu us sampling)",
+                 mode_names[mode], stats.samples, stats.min_us, stats.avg_us, stats.max_us,
+                 mode == MATRIX_SCAN_POLLING ? 1000000UL / scan_rate_hz : 0);
+    }
+    
+    matrix_scan_cost_t cost;
+    armdeck_matrix_get_scan_cost(&cost);
+    ESP_LOGI(TAG, "Scan pass: n=%lu min=%lu avg=%lu max=%lu cycles",
+             cost.passes, cost.min_cycles, cost.avg_cycles, cost.max_cycles);
+             
+    matrix_jitter_stats_t timing;
+    armdeck_matrix_get_jitter_stats(&timing);
+    ESP_LOGI(TAG, "Scan timing: %d Hz n=%lu interval min=%lu avg=%lu max=%lu us, jitter avg=%lu max=%lu us",
+             scan_rate_hz, timing.samples, timing.min_interval_us, timing.avg_interval_us,
+             timing.max_interval_us, timing.avg_jitter_us, timing.max_jitter_us);
+}
+
+matrix_mask_t armdeck_matrix_get_pressed_mask(void) {
+    return scanner.state_mask;
+}
+
 bool armdeck_matrix_get_button_state(uint8_t button_id) {
-    if (button_id >= TOTAL_BUTTONS) {
+    if (button_id >= scanner.num_keys) {
         return false;
     }
-    return button_states[button_id];
+    return (scanner.state_mask & MATRIX_KEY_BIT(button_id)) != 0;
 }
 
 void armdeck_matrix_test_button(uint8_t button_id) {
-    if (button_id >= TOTAL_BUTTONS || !event_callback) {
+    if (button_id >= scanner.num_keys || !event_callback) {
         return;
     }
     
@@ -176,4 +668,72 @@ void armdeck_matrix_test_button(uint8_t button_id) {
     
     /* Simulate release */
     event_callback(button_id, false);
-}
\ No newline at end of file
+}
+
+#ifdef ARMDECK_MATRIX_BENCHMARK
+/* Per-pin scan pass as it was before the bit-packed state: gpio_get_level() for every
+ * key, a 10 us settle per row and the debounce strategy run on every key every pass */
+static void legacy_scan_pass(debounce_key_t* shadow, uint32_t current_time) {
+    for (int row = 0; row < num_rows; row++) {
+        gpio_set_level(row_pins[row], 0);
+        esp_rom_delay_us(10);
+        
+        for (int col = 0; col < num_cols; col++) {
+            int button_id = (row * num_cols) + col;
+            bool current_state = (gpio_get_level(col_pins[col]) == 0);
+            scanner.debounce->update(&shadow[button_id], current_state, current_time, &scanner.debounce_cfg);
+        }
+        
+        gpio_set_level(row_pins[row], 1);
+    }
+}
+
+static void log_bench(const char* name, const cycles_acc_t* acc) {
+    ESP_LOGI(TAG, "Benchmark %-8s: n=%lu min=%lu avg=%lu max=%lu cycles",
+             name, acc->passes, acc->min_cycles,
+             acc->passes ? (uint32_t)(acc->total_cycles / acc->passes) : 0, acc->max_cycles);
+}
+
+esp_err_t armdeck_matrix_benchmark(uint32_t passes) {
+    if (scan_task_handle != NULL) {
+        ESP_LOGW(TAG, "Stop scanning before running the benchmark");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (passes == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    debounce_key_t shadow[MATRIX_MAX_KEYS];
+    memcpy(shadow, scanner.keys, scanner.num_keys * sizeof(debounce_key_t));
+    
+    /* Legacy per-pin pass */
+    cycles_acc_t legacy = { .min_cycles = UINT32_MAX };
+    for (uint32_t i = 0; i < passes; i++) {
+        uint32_t now_ms = esp_timer_get_time() / 1000;
+        uint32_t start = esp_cpu_get_cycle_count();
+        legacy_scan_pass(shadow, now_ms);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        
+        legacy.passes++;
+        legacy.total_cycles += cycles;
+        legacy.min_cycles = cycles < legacy.min_cycles ? cycles : legacy.min_cycles;
+        legacy.max_cycles = cycles > legacy.max_cycles ? cycles : legacy.max_cycles;
+    }
+    
+    /* Bit-packed pass, through the real scan path without reporting events */
+    button_event_cb_t saved_callback = event_callback;
+    cycles_acc_t saved_cost = scan_cost;
+    event_callback = NULL;
+    scan_cost = (cycles_acc_t){ .min_cycles = UINT32_MAX };
+    for (uint32_t i = 0; i < passes; i++) {
+        scan_matrix(0);
+    }
+    cycles_acc_t packed = scan_cost;
+    scan_cost = saved_cost;
+    event_callback = saved_callback;
+    
+    log_bench("per-pin", &legacy);
+    log_bench("packed", &packed);
+    return ESP_OK;
+}
+#endif
\ No newline at end of file
@@ -4,19 +4,59 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "armdeck_debounce.h"
+#include "matrix_scan.h"
+#include "armdeck_protocol.h"
 
-/* Matrix configuration */
-#define MATRIX_ROWS         3
-#define MATRIX_COLS         5
-#define TOTAL_BUTTONS       (MATRIX_ROWS * MATRIX_COLS)
-#define DEBOUNCE_DELAY_MS   50
-#define SCAN_PERIOD_MS      10
+#define IDLE_TIMEOUT_MS     200     // Quiet period before going back to interrupt wait
+
+/* Scan modes */
+typedef enum {
+    MATRIX_SCAN_POLLING = 0,    // Scan at the scan rate forever
+    MATRIX_SCAN_INTERRUPT,      // Wait for a column edge, scan only while keys are active
+    MATRIX_SCAN_MODE_COUNT
+} matrix_scan_mode_t;
+
+/* Default scan mode, can be overridden per deployment */
+#ifndef MATRIX_DEFAULT_SCAN_MODE
+#define MATRIX_DEFAULT_SCAN_MODE    MATRIX_SCAN_INTERRUPT
+#endif
+
+/* Press-to-callback latency statistics (microseconds) */
+typedef struct {
+    uint32_t samples;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t avg_us;
+} matrix_latency_stats_t;
+
+/* Scan pass cost statistics (CPU cycles) */
+typedef struct {
+    uint32_t passes;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint32_t avg_cycles;
+} matrix_scan_cost_t;
+
+/* Scan timer interval statistics (microseconds), deviation is against the nominal period */
+typedef struct {
+    uint32_t samples;
+    uint32_t period_us;
+    uint32_t min_interval_us;
+    uint32_t max_interval_us;
+    uint32_t avg_interval_us;
+    uint32_t max_jitter_us;
+    uint32_t avg_jitter_us;
+} matrix_jitter_stats_t;
 
 /* Button event callback */
 typedef void (*button_event_cb_t)(uint8_t button_id, bool pressed);
 
-/* Initialize button matrix */
-esp_err_t armdeck_matrix_init(void);
+/* Initialize button matrix (rows x cols keys, GPIO numbers for each row and column) */
+esp_err_t armdeck_matrix_init(uint8_t rows, uint8_t cols, const uint8_t* row_gpios, const uint8_t* col_gpios);
+
+/* Get number of keys of the initialized matrix */
+uint8_t armdeck_matrix_get_num_keys(void);
 
 /* Set button event callback */
 void armdeck_matrix_set_callback(button_event_cb_t callback);
@@ -27,10 +67,45 @@ esp_err_t armdeck_matrix_start(void);
 /* Stop button scanning task */
 esp_err_t armdeck_matrix_stop(void);
 
+/* Select scan mode (applied on next idle/scan cycle) */
+void armdeck_matrix_set_scan_mode(matrix_scan_mode_t mode);
+
+/* Get current scan mode */
+matrix_scan_mode_t armdeck_matrix_get_scan_mode(void);
+
+/* Set scan rate (SCAN_MIN_RATE_HZ..SCAN_MAX_RATE_HZ, applied on next scan cycle) */
+esp_err_t armdeck_matrix_set_scan_rate(uint16_t rate_hz);
+
+/* Get current scan rate */
+uint16_t armdeck_matrix_get_scan_rate(void);
+
+/* Select debounce algorithm and timings */
+esp_err_t armdeck_matrix_set_debounce(const debounce_config_t* cfg);
+
+/* Get press-to-callback latency statistics for a scan mode */
+esp_err_t armdeck_matrix_get_latency_stats(matrix_scan_mode_t mode, matrix_latency_stats_t* stats);
+
+/* Get scan pass cost statistics */
+esp_err_t armdeck_matrix_get_scan_cost(matrix_scan_cost_t* cost);
+
+/* Get scan interval jitter statistics */
+esp_err_t armdeck_matrix_get_jitter_stats(matrix_jitter_stats_t* stats);
+
+/* Log latency, scan cost and scan timing statistics */
+void armdeck_matrix_log_latency(void);
+
+/* Get debounced state of all buttons */
+matrix_mask_t armdeck_matrix_get_pressed_mask(void);
+
 /* Get current button state */
 bool armdeck_matrix_get_button_state(uint8_t button_id);
 
 /* Test mode - simulate button press */
 void armdeck_matrix_test_button(uint8_t button_id);
 
+#ifdef ARMDECK_MATRIX_BENCHMARK
+/* Compare per-pin and register scan passes (scanning must be stopped) */
+esp_err_t armdeck_matrix_benchmark(uint32_t passes);
+#endif
+
 #endif /* ARMDECK_MATRIX_H */
\ No newline at end of file
@@ -17,29 +17,28 @@
 // HID LED output report length
 #define HID_LED_OUT_RPT_LEN         1
 
-// HID mouse input report length
-#define HID_MOUSE_IN_RPT_LEN        5
+// HID mouse input report length (buttons, X, Y, wheel, as in the report map)
+#define HID_MOUSE_IN_RPT_LEN        4
 
 // HID consumer control input report length
-#define HID_CC_IN_RPT_LEN           2
+#define HID_CC_IN_RPT_LEN           (2 * HID_CC_IN_USAGES)
 
-esp_err_t esp_hidd_register_callbacks(esp_hidd_event_cb_t callbacks)
+// HID NKRO keyboard input report length
+#define HID_NKRO_IN_RPT_LEN         (1 + HID_NKRO_BITMAP_LEN)
+
+esp_err_t esp_hidd_register_callbacks(esp_hidd_event_cb_t callbacks, esp_hidd_gatts_app_register_t register_app)
 {
     esp_err_t hidd_status;
 
-    if(callbacks != NULL) {
+    if(callbacks != NULL && register_app != NULL) {
    	    hidd_le_env.hidd_cb = callbacks;
     } else {
         return ESP_FAIL;
     }
 
-    if((hidd_status = hidd_register_cb()) != ESP_OK) {
-        return hidd_status;
-    }
+    register_app(BATTRAY_APP_ID, esp_hidd_prf_cb_hdl);
 
-    esp_ble_gatts_app_register(BATTRAY_APP_ID);
-
-    if((hidd_status = esp_ble_gatts_app_register(HIDD_APP_ID)) != ESP_OK) {
+    if((hidd_status = register_app(HIDD_APP_ID, esp_hidd_prf_cb_hdl)) != ESP_OK) {
         return hidd_status;
     }
 
@@ -84,14 +83,21 @@ uint16_t esp_hidd_get_version(void)
 	return HIDD_VERSION;
 }
 
-void esp_hidd_send_consumer_value(uint16_t conn_id, uint8_t key_cmd, bool key_pressed)
+void esp_hidd_send_consumer_usages(uint16_t conn_id, const uint16_t *usages, uint8_t num_usages)
 {
-    uint8_t buffer[HID_CC_IN_RPT_LEN] = {0, 0};
-    if (key_pressed) {
-        ESP_LOGD(HID_LE_PRF_TAG, "hid_consumer_build_report");
-        hid_consumer_build_report(buffer, key_cmd);
+    if (num_usages > HID_CC_IN_USAGES) {
+        ESP_LOGE(HID_LE_PRF_TAG, "%s(), the number of usages should not be more than %d", __func__, HID_CC_IN_USAGES);
+        return;
     }
-    ESP_LOGD(HID_LE_PRF_TAG, "buffer[0] = %x, buffer[1] = %x", buffer[0], buffer[1]);
+
+    uint8_t buffer[HID_CC_IN_RPT_LEN] = {0};
+
+    // Usages go on the wire as is, little endian
+    for (int i = 0; i < num_usages; i++) {
+        buffer[2 * i] = usages[i] & 0xFF;
+        buffer[2 * i + 1] = usages[i] >> 8;
+    }
+
     hid_dev_send_report(hidd_le_env.gatt_if, conn_id,
                         HID_RPT_ID_CC_IN, HID_REPORT_TYPE_INPUT, HID_CC_IN_RPT_LEN, buffer);
     return;
@@ -117,17 +123,68 @@ void esp_hidd_send_keyboard_value(uint16_t conn_id, key_mask_t special_key_mask,
     return;
 }
 
-void esp_hidd_send_mouse_value(uint16_t conn_id, uint8_t mouse_button, int8_t mickeys_x, int8_t mickeys_y)
+void esp_hidd_send_keyboard_bitmap(uint16_t conn_id, key_mask_t special_key_mask, const uint8_t *bitmap)
+{
+    uint8_t buffer[HID_NKRO_IN_RPT_LEN];
+
+    buffer[0] = special_key_mask;
+    memcpy(&buffer[1], bitmap, HID_NKRO_BITMAP_LEN);
+
+    hid_dev_send_report(hidd_le_env.gatt_if, conn_id,
+                        HID_RPT_ID_NKRO_IN, HID_REPORT_TYPE_INPUT, HID_NKRO_IN_RPT_LEN, buffer);
+    return;
+}
+
+void esp_hidd_send_mouse_value(uint16_t conn_id, uint8_t mouse_button, int8_t mickeys_x, int8_t mickeys_y, int8_t wheel)
 {
     uint8_t buffer[HID_MOUSE_IN_RPT_LEN];
 
     buffer[0] = mouse_button;   // Buttons
     buffer[1] = mickeys_x;           // X
     buffer[2] = mickeys_y;           // Y
-    buffer[3] = 0;           // Wheel
-    buffer[4] = 0;           // AC Pan
+    buffer[3] = wheel;           // Wheel
 
     hid_dev_send_report(hidd_le_env.gatt_if, conn_id,
                         HID_RPT_ID_MOUSE_IN, HID_REPORT_TYPE_INPUT, HID_MOUSE_IN_RPT_LEN, buffer);
     return;
 }
+
+void esp_hidd_send_keep_alive(uint16_t conn_id)
+{
+    if (!hid_dev_resend_last_report(hidd_le_env.gatt_if, conn_id)) {
+        esp_hidd_send_keyboard_value(conn_id, 0, NULL, 0);
+    }
+    return;
+}
+
+void esp_hidd_resync_reports(void)
+{
+    hid_dev_resync_reports();
+}
+
+void esp_hidd_set_congested(bool congested)
+{
+    hid_dev_set_congested(congested);
+}
+
+void esp_hidd_send_pending(void)
+{
+    hid_dev_send_pending();
+}
+
+void esp_hidd_discard_pending(void)
+{
+    hid_dev_discard_pending();
+}
+
+void esp_hidd_get_report_stats(esp_hidd_report_stats_t *stats)
+{
+    hid_dev_get_report_stats(stats);
+}
+
+#ifdef ARMDECK_PRESS_BENCHMARK
+void esp_hidd_benchmark_report_lookup(uint32_t lookups)
+{
+    hid_dev_benchmark_lookup(lookups);
+}
+#endif
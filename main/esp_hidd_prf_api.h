@@ -9,6 +9,7 @@
 
 #include "esp_bt_defs.h"
 #include "esp_gatt_defs.h"
+#include "esp_gatts_api.h"
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -53,6 +54,34 @@ typedef enum {
 #define RIGHT_GUI_KEY_MASK           (1 << 7)
 
 typedef uint8_t key_mask_t;
+
+// Consumer control report: array of 16-bit Consumer Page usages
+#define HID_CC_IN_USAGES             4
+
+// NKRO keyboard report: modifier byte + one bit per key usage 0 to HID_NKRO_MAX_USAGE
+#define HID_NKRO_MAX_USAGE           0x8F
+#define HID_NKRO_BITMAP_LEN          ((HID_NKRO_MAX_USAGE + 1) / 8)
+
+/**
+ * @brief Input report counters. Reports identical to the last one sent with the
+ *        same report ID are suppressed until the next resync; the others are queued
+ *        and sent in order as the link accepts them. Mouse motion is relative, so
+ *        mouse reports that move are always sent and only their buttons are cached.
+ */
+typedef struct {
+    uint32_t sent;          /*!< Reports accepted by the stack */
+    uint32_t suppressed;    /*!< Identical reports skipped */
+    uint32_t resent;        /*!< Cached reports sent again as keep-alives */
+    uint32_t resyncs;       /*!< Cache resets (connection changes, explicit requests) */
+    uint32_t retries;       /*!< Sends refused by the stack, retried later */
+    uint32_t collapsed;     /*!< Queued intermediate states replaced by a later report */
+    uint32_t dropped;       /*!< Reports lost to a full queue */
+    uint32_t congestions;   /*!< ESP_GATTS_CONGEST_EVT pauses */
+    uint8_t  queued;        /*!< Reports waiting now */
+    uint8_t  max_queued;    /*!< Deepest queue seen */
+    int64_t  last_sent_us;  /*!< esp_timer time of the last report accepted, 0 if none */
+} esp_hidd_report_stats_t;
+
 /**
  * @brief HIDD callback parameters union
  */
@@ -116,6 +145,13 @@ typedef union {
  */
 typedef void (*esp_hidd_event_cb_t) (esp_hidd_cb_event_t event, esp_hidd_cb_param_t *param);
 
+/**
+ * @brief GATTS application registration: registers app_id with the stack and routes the
+ *        events of that application to callback. Bluedroid keeps a single GATTS callback,
+ *        so the profile registers through the dispatcher that owns it.
+ */
+typedef esp_err_t (*esp_hidd_gatts_app_register_t) (uint16_t app_id, esp_gatts_cb_t callback);
+
 
 
 /**
@@ -123,11 +159,12 @@ typedef void (*esp_hidd_event_cb_t) (esp_hidd_cb_event_t event, esp_hidd_cb_para
  * @brief           This function is called to receive hid device callback event
  *
  * @param[in]    callbacks: callback functions
+ * @param[in]    register_app: registers the HID and battery GATTS applications
  *
  * @return         ESP_OK - success, other - failed
  *
  */
-esp_err_t esp_hidd_register_callbacks(esp_hidd_event_cb_t callbacks);
+esp_err_t esp_hidd_register_callbacks(esp_hidd_event_cb_t callbacks, esp_hidd_gatts_app_register_t register_app);
 
 /**
  *
@@ -156,11 +193,57 @@ esp_err_t esp_hidd_profile_deinit(void);
  */
 uint16_t esp_hidd_get_version(void);
 
-void esp_hidd_send_consumer_value(uint16_t conn_id, uint8_t key_cmd, bool key_pressed);
+void esp_hidd_send_consumer_usages(uint16_t conn_id, const uint16_t *usages, uint8_t num_usages);
 
 void esp_hidd_send_keyboard_value(uint16_t conn_id, key_mask_t special_key_mask, uint8_t *keyboard_cmd, uint8_t num_key);
 
-void esp_hidd_send_mouse_value(uint16_t conn_id, uint8_t mouse_button, int8_t mickeys_x, int8_t mickeys_y);
+void esp_hidd_send_keyboard_bitmap(uint16_t conn_id, key_mask_t special_key_mask, const uint8_t *bitmap);
+
+void esp_hidd_send_mouse_value(uint16_t conn_id, uint8_t mouse_button, int8_t mickeys_x, int8_t mickeys_y, int8_t wheel);
+
+/**
+ *
+ * @brief           Send the last input report again as a keep-alive, or an empty keyboard
+ *                  report when none was sent since the last resync
+ *
+ */
+void esp_hidd_send_keep_alive(uint16_t conn_id);
+
+/**
+ *
+ * @brief           Forget the last sent reports so the next report of each ID is sent
+ *                  even if identical (use when the host may have lost the state)
+ *
+ */
+void esp_hidd_resync_reports(void);
+
+/**
+ *
+ * @brief           Report link congestion (ESP_GATTS_CONGEST_EVT): reports are queued, not
+ *                  lost, while congested, and sent when it clears
+ *
+ */
+void esp_hidd_set_congested(bool congested);
+
+/**
+ *
+ * @brief           Retry queued reports (call on ESP_GATTS_CONF_EVT)
+ *
+ */
+void esp_hidd_send_pending(void);
+
+/**
+ *
+ * @brief           Drop queued reports (call on disconnection)
+ *
+ */
+void esp_hidd_discard_pending(void);
+
+void esp_hidd_get_report_stats(esp_hidd_report_stats_t *stats);
+
+#ifdef ARMDECK_PRESS_BENCHMARK
+void esp_hidd_benchmark_report_lookup(uint32_t lookups);
+#endif
 
 #ifdef __cplusplus
 }
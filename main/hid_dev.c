@@ -10,10 +10,69 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef ARMDECK_PRESS_BENCHMARK
+#include "esp_cpu.h"
+#endif
+
+// Last payload sent per input report ID, to skip resending identical reports
+#define HID_DEV_CACHE_IDS       8
+#define HID_DEV_REPORT_MAX_LEN  20
+
+// Reports waiting for the link, oldest first. More slots than input report IDs,
+// so a full queue always holds an intermediate state that a later report replaces.
+#define HID_DEV_QUEUE_LEN       8
+
+// Delay before retrying a report the stack refused while the link is not congested:
+// about one connection event, so a refused release does not wait for the next report
+#define HID_DEV_RETRY_DELAY_US  7500
+
+typedef struct
+{
+    bool        valid;          // Payload sent since the last resync
+    uint8_t     length;
+    uint8_t     data[HID_DEV_REPORT_MAX_LEN];
+} hid_dev_cache_t;
+
+typedef struct
+{
+    esp_gatt_if_t   gatts_if;
+    uint16_t        conn_id;
+    uint16_t        handle;
+    uint8_t         id;
+    uint8_t         length;
+    uint8_t         data[HID_DEV_REPORT_MAX_LEN];
+} hid_dev_queued_t;
 
 static hid_report_map_t *hid_dev_rpt_tbl;
 static uint8_t hid_dev_rpt_tbl_Len;
 
+// Input report handles indexed by protocol mode and report ID, built at registration
+// so the send path does not scan the report table
+static uint16_t hid_dev_input_handles[HID_PROTOCOL_MODE_REPORT + 1][HID_DEV_CACHE_IDS];
+
+static hid_dev_cache_t hid_dev_cache[HID_DEV_CACHE_IDS];
+static uint8_t hid_dev_last_id;     // Input report sent last, for keep-alives
+static hid_dev_queued_t hid_dev_queue[HID_DEV_QUEUE_LEN];
+static uint8_t hid_dev_queue_len;
+static bool hid_dev_congested;      // Between the two ESP_GATTS_CONGEST_EVT
+static bool hid_dev_draining;       // A task is sending the head of the queue
+static uint32_t hid_dev_discard_gen; // Bumped by each discard, checked by the sending task
+static esp_timer_handle_t hid_dev_retry_timer;
+static esp_hidd_report_stats_t hid_dev_stats;
+static portMUX_TYPE hid_dev_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void hid_dev_drain(void);
+
+static void hid_dev_retry_cb(void *arg)
+{
+    hid_dev_drain();
+}
+
+#ifdef ARMDECK_PRESS_BENCHMARK
+// Report table scan the send path used before the indexed handles
 static hid_report_map_t *hid_dev_rpt_by_id(uint8_t id, uint8_t type)
 {
     hid_report_map_t *rpt = hid_dev_rpt_tbl;
@@ -26,114 +85,340 @@ static hid_report_map_t *hid_dev_rpt_by_id(uint8_t id, uint8_t type)
 
     return NULL;
 }
+#endif
 
 void hid_dev_register_reports(uint8_t num_reports, hid_report_map_t *p_report)
 {
     hid_dev_rpt_tbl = p_report;
     hid_dev_rpt_tbl_Len = num_reports;
+
+    memset(hid_dev_input_handles, 0, sizeof(hid_dev_input_handles));
+    for (uint8_t i = 0; i < num_reports; i++) {
+        if (p_report[i].type == HID_REPORT_TYPE_INPUT && p_report[i].id < HID_DEV_CACHE_IDS &&
+            p_report[i].mode <= HID_PROTOCOL_MODE_REPORT) {
+            hid_dev_input_handles[p_report[i].mode][p_report[i].id] = p_report[i].handle;
+        }
+    }
+
+    if (hid_dev_retry_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = hid_dev_retry_cb,
+            .name = "hid_retry"
+        };
+        if (esp_timer_create(&timer_args, &hid_dev_retry_timer) != ESP_OK) {
+            ESP_LOGE(HID_LE_PRF_TAG, "%s(), retry timer not created", __func__);
+        }
+    }
     return;
 }
 
-void hid_dev_send_report(esp_gatt_if_t gatts_if, uint16_t conn_id,
-                                    uint8_t id, uint8_t type, uint8_t length, uint8_t *data)
+// Attribute handle of an input report in the current protocol mode, 0 if none
+static uint16_t hid_dev_input_handle(uint8_t id)
 {
-    hid_report_map_t *p_rpt;
+    if (id >= HID_DEV_CACHE_IDS || hidProtocolMode > HID_PROTOCOL_MODE_REPORT) {
+        return 0;
+    }
+    return hid_dev_input_handles[hidProtocolMode][id];
+}
 
-    // get att handle for report
-    if ((p_rpt = hid_dev_rpt_by_id(id, type)) != NULL) {
-        // if notifications are enabled
-        ESP_LOGD(HID_LE_PRF_TAG, "%s(), send the report, handle = %d", __func__, p_rpt->handle);
-        esp_ble_gatts_send_indicate(gatts_if, conn_id, p_rpt->handle, length, data, false);
+// Mouse reports: a button byte, then relative X, Y and wheel motion
+static bool hid_dev_has_motion(uint8_t id, uint8_t length, const uint8_t *data)
+{
+    if (id != HID_RPT_ID_MOUSE_IN) {
+        return false;
     }
+    for (uint8_t i = 1; i < length; i++) {
+        if (data[i] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    return;
+// Add the motion of a superseded mouse report to the one replacing it, saturating
+static void hid_dev_merge_motion(hid_dev_queued_t *report, const hid_dev_queued_t *older)
+{
+    for (uint8_t i = 1; i < report->length && i < older->length; i++) {
+        int sum = (int8_t)report->data[i] + (int8_t)older->data[i];
+        report->data[i] = (uint8_t)(int8_t)(sum > 127 ? 127 : (sum < -127 ? -127 : sum));
+    }
 }
 
-void hid_consumer_build_report(uint8_t *buffer, consumer_cmd_t cmd)
+// Caller holds the lock. Returns false when the report is identical to the last one with this ID.
+// Motion is never a repeat of earlier motion, and is not kept: a resend only repeats the buttons.
+static bool hid_dev_cache_update(uint8_t id, uint8_t length, const uint8_t *data)
 {
-    if (!buffer) {
-        ESP_LOGE(HID_LE_PRF_TAG, "%s(), the buffer is NULL, hid build report failed.", __func__);
-        return;
+    hid_dev_cache_t *cache = &hid_dev_cache[id];
+    bool motion = hid_dev_has_motion(id, length, data);
+
+    hid_dev_last_id = id;
+    if (!motion && cache->valid && cache->length == length && memcmp(cache->data, data, length) == 0) {
+        hid_dev_stats.suppressed++;
+        return false;
     }
 
-    switch (cmd) {
-        case HID_CONSUMER_CHANNEL_UP:
-            HID_CC_RPT_SET_CHANNEL(buffer, HID_CC_RPT_CHANNEL_UP);
-            break;
+    cache->valid = true;
+    cache->length = length;
+    memcpy(cache->data, data, length);
+    if (id == HID_RPT_ID_MOUSE_IN && length > 1) {
+        memset(&cache->data[1], 0, length - 1);
+    }
+    return true;
+}
 
-        case HID_CONSUMER_CHANNEL_DOWN:
-            HID_CC_RPT_SET_CHANNEL(buffer, HID_CC_RPT_CHANNEL_DOWN);
-            break;
+// Caller holds the lock. Index of a queued report that a later report with the same ID
+// supersedes, or -1. The head may be on its way to the stack and is never picked.
+// A superseded mouse report hands its motion over to the later one.
+static int hid_dev_find_superseded(void)
+{
+    for (int i = 1; i < hid_dev_queue_len; i++) {
+        for (int j = i + 1; j < hid_dev_queue_len; j++) {
+            if (hid_dev_queue[j].id == hid_dev_queue[i].id) {
+                if (hid_dev_queue[i].id == HID_RPT_ID_MOUSE_IN) {
+                    hid_dev_merge_motion(&hid_dev_queue[j], &hid_dev_queue[i]);
+                }
+                return i;
+            }
+        }
+    }
+    return -1;
+}
 
-        case HID_CONSUMER_VOLUME_UP:
-            HID_CC_RPT_SET_VOLUME_UP(buffer);
-            break;
+// Caller holds the lock. Reports carry the whole state of their ID, so when the queue is
+// full only intermediate states are collapsed: the latest state, releases included, stays.
+static bool hid_dev_enqueue(const hid_dev_queued_t *report)
+{
+    if (hid_dev_queue_len == HID_DEV_QUEUE_LEN) {
+        for (int i = hid_dev_queue_len - 1; i > 0; i--) {
+            if (hid_dev_queue[i].id == report->id) {
+                hid_dev_queued_t older = hid_dev_queue[i];
+                hid_dev_queue[i] = *report;
+                if (report->id == HID_RPT_ID_MOUSE_IN) {
+                    hid_dev_merge_motion(&hid_dev_queue[i], &older);
+                }
+                hid_dev_stats.collapsed++;
+                return true;
+            }
+        }
 
-        case HID_CONSUMER_VOLUME_DOWN:
-            HID_CC_RPT_SET_VOLUME_DOWN(buffer);
-            break;
+        int i = hid_dev_find_superseded();
+        if (i < 0) {
+            hid_dev_stats.dropped++;
+            return false;
+        }
+        memmove(&hid_dev_queue[i], &hid_dev_queue[i + 1], (hid_dev_queue_len - i - 1) * sizeof(hid_dev_queue[0]));
+        hid_dev_queue_len--;
+        hid_dev_stats.collapsed++;
+    }
 
-        case HID_CONSUMER_MUTE:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_MUTE);
-            break;
+    hid_dev_queue[hid_dev_queue_len++] = *report;
+    if (hid_dev_queue_len > hid_dev_stats.max_queued) {
+        hid_dev_stats.max_queued = hid_dev_queue_len;
+    }
+    return true;
+}
 
-        case HID_CONSUMER_POWER:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_POWER);
-            break;
+// Send queued reports in order until the queue is empty, the link is congested or the
+// stack refuses one. A refused report stays at the head and is retried on the next report,
+// notification sent or end of congestion, or by the retry timer when none of these comes.
+// Only one task sends at a time; the others just queue and the sending task picks their
+// reports up.
+static void hid_dev_drain(void)
+{
+    hid_dev_queued_t report;
+    uint32_t gen;
+    bool refused = false;
 
-        case HID_CONSUMER_RECALL_LAST:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_LAST);
-            break;
+    portENTER_CRITICAL(&hid_dev_lock);
+    if (hid_dev_draining) {
+        portEXIT_CRITICAL(&hid_dev_lock);
+        return;
+    }
+    hid_dev_draining = true;
 
-        case HID_CONSUMER_ASSIGN_SEL:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_ASSIGN_SEL);
-            break;
+    while (hid_dev_queue_len > 0 && !hid_dev_congested) {
+        report = hid_dev_queue[0];
+        gen = hid_dev_discard_gen;
+        portEXIT_CRITICAL(&hid_dev_lock);
 
-        case HID_CONSUMER_PLAY:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_PLAY);
-            break;
+        esp_err_t ret = esp_ble_gatts_send_indicate(report.gatts_if, report.conn_id, report.handle,
+                                                    report.length, report.data, false);
 
-        case HID_CONSUMER_PAUSE:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_PAUSE);
+        portENTER_CRITICAL(&hid_dev_lock);
+        // The queue was discarded (disconnect) while the lock was released: the head is
+        // gone already, and the queue may have been refilled since
+        if (gen != hid_dev_discard_gen || hid_dev_queue_len == 0) {
+            continue;
+        }
+        if (ret != ESP_OK) {
+            hid_dev_stats.retries++;
+            refused = true;
             break;
+        }
+        hid_dev_queue_len--;
+        memmove(&hid_dev_queue[0], &hid_dev_queue[1], hid_dev_queue_len * sizeof(hid_dev_queue[0]));
+        hid_dev_stats.sent++;
+        hid_dev_stats.last_sent_us = esp_timer_get_time();
+    }
 
-        case HID_CONSUMER_RECORD:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_RECORD);
-            break;
+    hid_dev_draining = false;
+    portEXIT_CRITICAL(&hid_dev_lock);
 
-        case HID_CONSUMER_FAST_FORWARD:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_FAST_FWD);
-            break;
+    // Already armed is fine: one retry is pending either way
+    if (refused && hid_dev_retry_timer != NULL) {
+        esp_timer_start_once(hid_dev_retry_timer, HID_DEV_RETRY_DELAY_US);
+    }
+}
 
-        case HID_CONSUMER_REWIND:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_REWIND);
-            break;
+void hid_dev_send_report(esp_gatt_if_t gatts_if, uint16_t conn_id,
+                                    uint8_t id, uint8_t type, uint8_t length, uint8_t *data)
+{
+    uint16_t handle;
 
-        case HID_CONSUMER_SCAN_NEXT_TRK:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_SCAN_NEXT_TRK);
-            break;
+    if (type != HID_REPORT_TYPE_INPUT || length > HID_DEV_REPORT_MAX_LEN) {
+        ESP_LOGE(HID_LE_PRF_TAG, "%s(), report %d type %d length %d cannot be queued", __func__, id, type, length);
+        return;
+    }
 
-        case HID_CONSUMER_SCAN_PREV_TRK:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_SCAN_PREV_TRK);
-            break;        case HID_CONSUMER_STOP:
-            HID_CC_RPT_SET_BUTTON(buffer, HID_CC_RPT_STOP);
-            break;
+    // get att handle for report
+    if ((handle = hid_dev_input_handle(id)) != 0) {
+        hid_dev_queued_t report = {
+            .gatts_if = gatts_if,
+            .conn_id = conn_id,
+            .handle = handle,
+            .id = id,
+            .length = length,
+        };
+        memcpy(report.data, data, length);
 
-        case HID_CONSUMER_BRIGHTNESS_UP:
-            // For brightness, we might need to send the raw value
-            buffer[0] = 0x6F;
-            buffer[1] = 0x00;
-            break;
-            
-        case HID_CONSUMER_BRIGHTNESS_DOWN:
-            // For brightness, we might need to send the raw value  
-            buffer[0] = 0x70;
-            buffer[1] = 0x00;
-            break;
+        portENTER_CRITICAL(&hid_dev_lock);
+        bool changed = hid_dev_cache_update(id, length, data);
+        bool queued = changed && hid_dev_enqueue(&report);
+        portEXIT_CRITICAL(&hid_dev_lock);
 
-        default:
-            break;
+        if (!changed) {
+            ESP_LOGD(HID_LE_PRF_TAG, "%s(), report %d unchanged, not sent", __func__, id);
+            return;
+        }
+        if (!queued) {
+            ESP_LOGE(HID_LE_PRF_TAG, "%s(), queue full, report %d dropped", __func__, id);
+        }
+        // if notifications are enabled
+        ESP_LOGD(HID_LE_PRF_TAG, "%s(), send the report, handle = %d", __func__, handle);
+        hid_dev_drain();
     }
 
     return;
 }
+
+bool hid_dev_resend_last_report(esp_gatt_if_t gatts_if, uint16_t conn_id)
+{
+    hid_dev_queued_t report = {
+        .gatts_if = gatts_if,
+        .conn_id = conn_id,
+    };
+    bool valid;
+
+    portENTER_CRITICAL(&hid_dev_lock);
+    report.id = hid_dev_last_id;
+    valid = hid_dev_cache[report.id].valid;
+    if (valid) {
+        report.length = hid_dev_cache[report.id].length;
+        memcpy(report.data, hid_dev_cache[report.id].data, report.length);
+    }
+    portEXIT_CRITICAL(&hid_dev_lock);
+
+    report.handle = hid_dev_input_handle(report.id);
+    if (!valid || report.handle == 0) {
+        return false;
+    }
+
+    // Reports still queued already keep the link busy
+    portENTER_CRITICAL(&hid_dev_lock);
+    if (hid_dev_queue_len == 0 && hid_dev_enqueue(&report)) {
+        hid_dev_stats.resent++;
+    }
+    portEXIT_CRITICAL(&hid_dev_lock);
+
+    hid_dev_drain();
+    return true;
+}
+
+void hid_dev_resync_reports(void)
+{
+    portENTER_CRITICAL(&hid_dev_lock);
+    for (int i = 0; i < HID_DEV_CACHE_IDS; i++) {
+        hid_dev_cache[i].valid = false;
+    }
+    hid_dev_stats.resyncs++;
+    portEXIT_CRITICAL(&hid_dev_lock);
+}
+
+void hid_dev_set_congested(bool congested)
+{
+    portENTER_CRITICAL(&hid_dev_lock);
+    if (congested && !hid_dev_congested) {
+        hid_dev_stats.congestions++;
+    }
+    hid_dev_congested = congested;
+    portEXIT_CRITICAL(&hid_dev_lock);
+
+    if (!congested) {
+        hid_dev_drain();
+    }
+}
+
+void hid_dev_send_pending(void)
+{
+    hid_dev_drain();
+}
+
+void hid_dev_discard_pending(void)
+{
+    portENTER_CRITICAL(&hid_dev_lock);
+    hid_dev_queue_len = 0;
+    hid_dev_congested = false;
+    hid_dev_discard_gen++;
+    portEXIT_CRITICAL(&hid_dev_lock);
+
+    if (hid_dev_retry_timer != NULL) {
+        esp_timer_stop(hid_dev_retry_timer);
+    }
+}
+
+void hid_dev_get_report_stats(esp_hidd_report_stats_t *stats)
+{
+    portENTER_CRITICAL(&hid_dev_lock);
+    *stats = hid_dev_stats;
+    stats->queued = hid_dev_queue_len;
+    portEXIT_CRITICAL(&hid_dev_lock);
+}
+
+#ifdef ARMDECK_PRESS_BENCHMARK
+void hid_dev_benchmark_lookup(uint32_t lookups)
+{
+    static const uint8_t ids[] = { HID_RPT_ID_KEY_IN, HID_RPT_ID_CC_IN, HID_RPT_ID_NKRO_IN };
+    volatile uint16_t sink = 0;
+
+    if (lookups == 0) {
+        return;
+    }
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (uint32_t i = 0; i < lookups; i++) {
+        hid_report_map_t *p_rpt = hid_dev_rpt_by_id(ids[i % sizeof(ids)], HID_REPORT_TYPE_INPUT);
+        sink += p_rpt ? p_rpt->handle : 0;
+    }
+    uint32_t scan_cycles = esp_cpu_get_cycle_count() - start;
+
+    start = esp_cpu_get_cycle_count();
+    for (uint32_t i = 0; i < lookups; i++) {
+        sink += hid_dev_input_handle(ids[i % sizeof(ids)]);
+    }
+    uint32_t indexed_cycles = esp_cpu_get_cycle_count() - start;
+
+    ESP_LOGI(HID_LE_PRF_TAG, "Benchmark report handle: scan=%lu indexed=%lu cycles per report (n=%lu)",
+             scan_cycles / lookups, indexed_cycles / lookups, lookups);
+    (void)sink;
+}
+#endif
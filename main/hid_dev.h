@@ -175,48 +175,7 @@ typedef uint8_t mouse_cmd_t;
 #define HID_CONSUMER_BRIGHTNESS_DOWN 0x70 // Monitor Brightness Down (112 decimal)  
 #define HID_CONSUMER_VOLUME_UP      233 // Volume Increment
 #define HID_CONSUMER_VOLUME_DOWN    234 // Volume Decrement
-typedef uint8_t consumer_cmd_t;
-
-#define HID_CC_RPT_MUTE                 1
-#define HID_CC_RPT_POWER                2
-#define HID_CC_RPT_LAST                 3
-#define HID_CC_RPT_ASSIGN_SEL           4
-#define HID_CC_RPT_PLAY                 5
-#define HID_CC_RPT_PAUSE                6
-#define HID_CC_RPT_RECORD               7
-#define HID_CC_RPT_FAST_FWD             8
-#define HID_CC_RPT_REWIND               9
-#define HID_CC_RPT_SCAN_NEXT_TRK        10
-#define HID_CC_RPT_SCAN_PREV_TRK        11
-#define HID_CC_RPT_STOP                 12
-
-#define HID_CC_RPT_CHANNEL_UP           0x01
-#define HID_CC_RPT_CHANNEL_DOWN         0x03
-#define HID_CC_RPT_VOLUME_UP            0x40
-#define HID_CC_RPT_VOLUME_DOWN          0x80
-
-// HID Consumer Control report bitmasks
-#define HID_CC_RPT_NUMERIC_BITS         0xF0
-#define HID_CC_RPT_CHANNEL_BITS         0xCF
-#define HID_CC_RPT_VOLUME_BITS          0x3F
-#define HID_CC_RPT_BUTTON_BITS          0xF0
-#define HID_CC_RPT_SELECTION_BITS       0xCF
-
-
-// Macros for the HID Consumer Control 2-byte report
-#define HID_CC_RPT_SET_NUMERIC(s, x)    (s)[0] &= HID_CC_RPT_NUMERIC_BITS;   \
-                                        (s)[0] = (x)
-#define HID_CC_RPT_SET_CHANNEL(s, x)    (s)[0] &= HID_CC_RPT_CHANNEL_BITS;   \
-                                        (s)[0] |= ((x) & 0x03) << 4
-#define HID_CC_RPT_SET_VOLUME_UP(s)     (s)[0] &= HID_CC_RPT_VOLUME_BITS;    \
-                                        (s)[0] |= 0x40
-#define HID_CC_RPT_SET_VOLUME_DOWN(s)   (s)[0] &= HID_CC_RPT_VOLUME_BITS;    \
-                                        (s)[0] |= 0x80
-#define HID_CC_RPT_SET_BUTTON(s, x)     (s)[1] &= HID_CC_RPT_BUTTON_BITS;    \
-                                        (s)[1] |= (x)
-#define HID_CC_RPT_SET_SELECTION(s, x)  (s)[1] &= HID_CC_RPT_SELECTION_BITS; \
-                                        (s)[1] |= ((x) & 0x03) << 4
-
+typedef uint16_t consumer_cmd_t;
 
 // HID report mapping table
 typedef struct
@@ -241,7 +200,27 @@ void hid_dev_register_reports(uint8_t num_reports, hid_report_map_t *p_report);
 void hid_dev_send_report(esp_gatt_if_t gatts_if, uint16_t conn_id,
                                     uint8_t id, uint8_t type, uint8_t length, uint8_t *data);
 
-void hid_consumer_build_report(uint8_t *buffer, consumer_cmd_t cmd);
+// Resend the last input report as is (keep-alive), false if none since the last resync
+bool hid_dev_resend_last_report(esp_gatt_if_t gatts_if, uint16_t conn_id);
+
+// Forget the cached reports: the next report of every ID is sent even if unchanged
+void hid_dev_resync_reports(void);
+
+// Link congestion from ESP_GATTS_CONGEST_EVT: queued reports wait until it clears
+void hid_dev_set_congested(bool congested);
+
+// Retry the queued reports (a notification went out, the link may have room)
+void hid_dev_send_pending(void);
+
+// Drop the queued reports (disconnection)
+void hid_dev_discard_pending(void);
+
+void hid_dev_get_report_stats(esp_hidd_report_stats_t *stats);
+
+#ifdef ARMDECK_PRESS_BENCHMARK
+// Compare the report table scan with the indexed handle lookup
+void hid_dev_benchmark_lookup(uint32_t lookups);
+#endif
 
 void hid_keyboard_build_report(uint8_t *buffer, keyboard_cmd_t cmd);
 
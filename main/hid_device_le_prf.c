@@ -91,75 +91,54 @@ static const uint8_t hidReportMap[] = {
     0x75, 0x03,  //   Report Size (3)
     0x91, 0x01,  //   Output: (Constant)
     //
-    //   Key arrays (6 bytes)
+    //   Key arrays (6 bytes), F13-F24 and other usages past 101 included
     0x95, 0x06,  //   Report Count (6)
     0x75, 0x08,  //   Report Size (8)
     0x15, 0x00,  //   Log Min (0)
-    0x25, 0x65,  //   Log Max (101)
+    0x26, 0xE7, 0x00, //   Log Max (231)
     0x05, 0x07,  //   Usage Pg (Key Codes)
     0x19, 0x00,  //   Usage Min (0)
-    0x29, 0x65,  //   Usage Max (101)
+    0x29, 0xE7,  //   Usage Max (231)
     0x81, 0x00,  //   Input: (Data, Array)
     //
     0xC0,        // End Collection
+
+    0x05, 0x01,  // Usage Pg (Generic Desktop)
+    0x09, 0x06,  // Usage (Keyboard)
+    0xA1, 0x01,  // Collection: (Application)
+    0x85, 0x05,  // Report Id (5)
+    //
+    //   Modifier byte
+    0x05, 0x07,  //   Usage Pg (Key Codes)
+    0x19, 0xE0,  //   Usage Min (224)
+    0x29, 0xE7,  //   Usage Max (231)
+    0x15, 0x00,  //   Log Min (0)
+    0x25, 0x01,  //   Log Max (1)
+    0x75, 0x01,  //   Report Size (1)
+    0x95, 0x08,  //   Report Count (8)
+    0x81, 0x02,  //   Input: (Data, Variable, Absolute)
+    //
+    //   NKRO key bitmap, one bit per usage 0 to HID_NKRO_MAX_USAGE (18 bytes)
+    0x19, 0x00,  //   Usage Min (0)
+    0x29, 0x8F,  //   Usage Max (143)
+    0x95, 0x90,  //   Report Count (144)
+    0x81, 0x02,  //   Input: (Data, Variable, Absolute)
+    //
+    0xC0,        // End Collection
     //
     0x05, 0x0C,   // Usage Pg (Consumer Devices)
     0x09, 0x01,   // Usage (Consumer Control)
     0xA1, 0x01,   // Collection (Application)
     0x85, 0x03,   // Report Id (3)
-    0x09, 0x02,   //   Usage (Numeric Key Pad)
-    0xA1, 0x02,   //   Collection (Logical)
-    0x05, 0x09,   //     Usage Pg (Button)
-    0x19, 0x01,   //     Usage Min (Button 1)
-    0x29, 0x0A,   //     Usage Max (Button 10)
-    0x15, 0x01,   //     Logical Min (1)
-    0x25, 0x0A,   //     Logical Max (10)
-    0x75, 0x04,   //     Report Size (4)
-    0x95, 0x01,   //     Report Count (1)
-    0x81, 0x00,   //     Input (Data, Ary, Abs)
-    0xC0,         //   End Collection
-    0x05, 0x0C,   //   Usage Pg (Consumer Devices)
-    0x09, 0x86,   //   Usage (Channel)
-    0x15, 0xFF,   //   Logical Min (-1)
-    0x25, 0x01,   //   Logical Max (1)
-    0x75, 0x02,   //   Report Size (2)
-    0x95, 0x01,   //   Report Count (1)
-    0x81, 0x46,   //   Input (Data, Var, Rel, Null)
-    0x09, 0xE9,   //   Usage (Volume Up)
-    0x09, 0xEA,   //   Usage (Volume Down)
+    //   Usage array: HID_CC_IN_USAGES held usages as 16-bit IDs, 0 = none
     0x15, 0x00,   //   Logical Min (0)
-    0x75, 0x01,   //   Report Size (1)
-    0x95, 0x02,   //   Report Count (2)
-    0x81, 0x02,   //   Input (Data, Var, Abs)
-    0x09, 0xE2,   //   Usage (Mute)
-    0x09, 0x30,   //   Usage (Power)
-    0x09, 0x83,   //   Usage (Recall Last)
-    0x09, 0x81,   //   Usage (Assign Selection)
-    0x09, 0xB0,   //   Usage (Play)
-    0x09, 0xB1,   //   Usage (Pause)
-    0x09, 0xB2,   //   Usage (Record)
-    0x09, 0xB3,   //   Usage (Fast Forward)
-    0x09, 0xB4,   //   Usage (Rewind)
-    0x09, 0xB5,   //   Usage (Scan Next)
-    0x09, 0xB6,   //   Usage (Scan Prev)
-    0x09, 0xB7,   //   Usage (Stop)
-    0x15, 0x01,   //   Logical Min (1)
-    0x25, 0x0C,   //   Logical Max (12)
-    0x75, 0x04,   //   Report Size (4)
-    0x95, 0x01,   //   Report Count (1)
+    0x26, 0xFF, 0x03, //   Logical Max (0x3FF)
+    0x19, 0x00,   //   Usage Min (0)
+    0x2A, 0xFF, 0x03, //   Usage Max (0x3FF)
+    0x75, 0x10,   //   Report Size (16)
+    0x95, 0x04,   //   Report Count (4)
     0x81, 0x00,   //   Input (Data, Ary, Abs)
-    0x09, 0x80,   //   Usage (Selection)
-    0xA1, 0x02,   //   Collection (Logical)
-    0x05, 0x09,   //     Usage Pg (Button)
-    0x19, 0x01,   //     Usage Min (Button 1)
-    0x29, 0x03,   //     Usage Max (Button 3)
-    0x15, 0x01,   //     Logical Min (1)
-    0x25, 0x03,   //     Logical Max (3)
-    0x75, 0x02,   //     Report Size (2)
-    0x81, 0x00,   //     Input (Data, Ary, Abs)
-    0xC0,           //   End Collection
-    0x81, 0x03,   //   Input (Const, Var, Abs)
-    0xC0,            // End Collectionq
+    0xC0,         // End Collection
 
 #if (SUPPORT_REPORT_VENDOR == true)
     0x06, 0xFF, 0xFF, // Usage Page(Vendor defined)
@@ -191,20 +170,10 @@ enum
 
 #define HI_UINT16(a) (((a) >> 8) & 0xFF)
 #define LO_UINT16(a) ((a) & 0xFF)
-#define PROFILE_NUM            1
-#define PROFILE_APP_IDX        0
-
-struct gatts_profile_inst {
-    esp_gatts_cb_t gatts_cb;
-    uint16_t gatts_if;
-    uint16_t app_id;
-    uint16_t conn_id;
-};
-
 hidd_le_env_t hidd_le_env;
 
 // HID report map length
-uint8_t hidReportMapLen = sizeof(hidReportMap);
+uint16_t hidReportMapLen = sizeof(hidReportMap);
 uint8_t hidProtocolMode = HID_PROTOCOL_MODE_REPORT;
 
 // HID report mapping table
@@ -248,6 +217,10 @@ static uint8_t hidReportRefFeature[HID_REPORT_REF_LEN] =
 static uint8_t hidReportRefCCIn[HID_REPORT_REF_LEN] =
              { HID_RPT_ID_CC_IN, HID_REPORT_TYPE_INPUT };
 
+// HID Report Reference characteristic descriptor, NKRO keyboard input
+static uint8_t hidReportRefNkroIn[HID_REPORT_REF_LEN] =
+             { HID_RPT_ID_NKRO_IN, HID_REPORT_TYPE_INPUT };
+
 
 /*
  *  Heart Rate PROFILE ATTRIBUTES
@@ -471,6 +444,27 @@ static esp_gatts_attr_db_t hidd_le_gatt_db[HIDD_LE_IDX_NB] =
                                                                        sizeof(hidReportRefCCIn), sizeof(hidReportRefCCIn),
                                                                        hidReportRefCCIn}},
 
+    // NKRO Report Characteristic Declaration
+    [HIDD_LE_IDX_REPORT_NKRO_IN_CHAR]       = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
+                                                                         ESP_GATT_PERM_READ,
+                                                                         CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE,
+                                                                         (uint8_t *)&char_prop_read_notify}},
+    // NKRO Report Characteristic Value
+    [HIDD_LE_IDX_REPORT_NKRO_IN_VAL]        = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_uuid,
+                                                                       ESP_GATT_PERM_READ,
+                                                                       HIDD_LE_REPORT_MAX_LEN, 0,
+                                                                       NULL}},
+    // Report NKRO INPUT Characteristic - Client Characteristic Configuration Descriptor
+    [HIDD_LE_IDX_REPORT_NKRO_IN_CCC]        = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
+                                                                      (ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE),
+                                                                      sizeof(uint16_t), 0,
+                                                                      NULL}},
+    // NKRO Report Characteristic - Report Reference Descriptor
+    [HIDD_LE_IDX_REPORT_NKRO_IN_REP_REF]    = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&hid_report_ref_descr_uuid,
+                                                                       ESP_GATT_PERM_READ,
+                                                                       sizeof(hidReportRefNkroIn), sizeof(hidReportRefNkroIn),
+                                                                       hidReportRefNkroIn}},
+
     // Boot Keyboard Input Report Characteristic Declaration
     [HIDD_LE_IDX_BOOT_KB_IN_REPORT_CHAR] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid,
                                                                         ESP_GATT_PERM_READ,
@@ -536,6 +530,13 @@ static void hid_add_id_tbl(void);
 void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
 									esp_ble_gatts_cb_param_t *param)
 {
+    // The battery application only registers, the HID application owns both services:
+    // only its copy of the connection events is handled
+    if (event != ESP_GATTS_REG_EVT && gatts_if != ESP_GATT_IF_NONE &&
+        gatts_if != hidd_le_env.gatt_if) {
+        return;
+    }
+
     switch(event) {
         case ESP_GATTS_REG_EVT: {
             esp_ble_gap_config_local_icon (ESP_BLE_APPEARANCE_GENERIC_HID);
@@ -559,6 +560,13 @@ void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
             break;
         }
         case ESP_GATTS_CONF_EVT: {
+            // A report went out: retry the queued ones
+            esp_hidd_send_pending();
+            break;
+        }
+        case ESP_GATTS_CONGEST_EVT: {
+            // Reports wait in their queue while the link is congested
+            esp_hidd_set_congested(param->congest.congested);
             break;
         }
         case ESP_GATTS_CREATE_EVT:
@@ -578,6 +586,7 @@ void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
             break;
         }
         case ESP_GATTS_DISCONNECT_EVT: {
+            esp_hidd_discard_pending();
 			 if(hidd_le_env.hidd_cb != NULL) {
                     (hidd_le_env.hidd_cb)(ESP_HIDD_EVENT_BLE_DISCONNECT, NULL);
              }
@@ -679,50 +688,6 @@ bool hidd_clcb_dealloc (uint16_t conn_id)
     return false;
 }
 
-static struct gatts_profile_inst heart_rate_profile_tab[PROFILE_NUM] = {
-    [PROFILE_APP_IDX] = {
-        .gatts_cb = esp_hidd_prf_cb_hdl,
-        .gatts_if = ESP_GATT_IF_NONE,       /* Not get the gatt_if, so initial is ESP_GATT_IF_NONE */
-    },
-
-};
-
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
-                                esp_ble_gatts_cb_param_t *param)
-{
-    /* If event is register event, store the gatts_if for each profile */
-    if (event == ESP_GATTS_REG_EVT) {
-        if (param->reg.status == ESP_GATT_OK) {
-            heart_rate_profile_tab[PROFILE_APP_IDX].gatts_if = gatts_if;
-        } else {
-            ESP_LOGI(HID_LE_PRF_TAG, "Reg app failed, app_id %04x, status %d",
-                    param->reg.app_id,
-                    param->reg.status);
-            return;
-        }
-    }
-
-    do {
-        int idx;
-        for (idx = 0; idx < PROFILE_NUM; idx++) {
-            if (gatts_if == ESP_GATT_IF_NONE || /* ESP_GATT_IF_NONE, not specify a certain gatt_if, need to call every profile cb function */
-                    gatts_if == heart_rate_profile_tab[idx].gatts_if) {
-                if (heart_rate_profile_tab[idx].gatts_cb) {
-                    heart_rate_profile_tab[idx].gatts_cb(event, gatts_if, param);
-                }
-            }
-        }
-    } while (0);
-}
-
-
-esp_err_t hidd_register_cb(void)
-{
-	esp_err_t status;
-	status = esp_ble_gatts_register_callback(gatts_event_handler);
-	return status;
-}
-
 void hidd_set_attr_value(uint16_t handle, uint16_t val_len, const uint8_t *value)
 {
     hidd_inst_t *hidd_inst = &hidd_le_env.hidd_inst;
@@ -809,6 +774,13 @@ static void hid_add_id_tbl(void)
       hid_rpt_map[7].cccdHandle = 0;
       hid_rpt_map[7].mode = HID_PROTOCOL_MODE_REPORT;
 
+      // NKRO keyboard input report
+      hid_rpt_map[8].id = hidReportRefNkroIn[0];
+      hid_rpt_map[8].type = hidReportRefNkroIn[1];
+      hid_rpt_map[8].handle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_NKRO_IN_VAL];
+      hid_rpt_map[8].cccdHandle = hidd_le_env.hidd_inst.att_tbl[HIDD_LE_IDX_REPORT_NKRO_IN_CCC];
+      hid_rpt_map[8].mode = HID_PROTOCOL_MODE_REPORT;
+
 
   // Setup report ID map
   hid_dev_register_reports(HID_NUM_REPORTS, hid_rpt_map);
@@ -40,6 +40,7 @@
 #define HID_RPT_ID_KEY_IN        2   // Keyboard input report ID
 #define HID_RPT_ID_CC_IN         3   //Consumer Control input report ID
 #define HID_RPT_ID_VENDOR_OUT    4   // Vendor output report ID
+#define HID_RPT_ID_NKRO_IN       5   // NKRO keyboard input report ID
 #define HID_RPT_ID_LED_OUT       2  // LED output report ID
 #define HID_RPT_ID_FEATURE       0  // Feature report ID
 
@@ -145,6 +146,11 @@ enum {
     HIDD_LE_IDX_REPORT_CC_IN_VAL,
     HIDD_LE_IDX_REPORT_CC_IN_CCC,
     HIDD_LE_IDX_REPORT_CC_IN_REP_REF,
+    // Report NKRO keyboard input
+    HIDD_LE_IDX_REPORT_NKRO_IN_CHAR,
+    HIDD_LE_IDX_REPORT_NKRO_IN_VAL,
+    HIDD_LE_IDX_REPORT_NKRO_IN_CCC,
+    HIDD_LE_IDX_REPORT_NKRO_IN_REP_REF,
 
     // Boot Keyboard Input Report
     HIDD_LE_IDX_BOOT_KB_IN_REPORT_CHAR,
@@ -329,7 +335,8 @@ void hidd_set_attr_value(uint16_t handle, uint16_t val_len, const uint8_t *value
 
 void hidd_get_attr_value(uint16_t handle, uint16_t *length, uint8_t **value);
 
-esp_err_t hidd_register_cb(void);
+void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
+                         esp_ble_gatts_cb_param_t *param);
 
 
 #endif  ///__HID_DEVICE_LE_PRF__
@@ -0,0 +1,109 @@
+#include "matrix_scan.h"
+#include <stddef.h>
+
+bool matrix_scanner_init(matrix_scanner_t* scanner, const matrix_port_t* port,
+                         uint8_t rows, uint8_t cols, const debounce_config_t* cfg) {
+    if (!scanner || !port || !cfg || rows == 0 || cols == 0 ||
+        rows > MATRIX_MAX_ROWS || cols > MATRIX_MAX_COLS || rows * cols > MATRIX_MAX_KEYS) {
+        return false;
+    }
+    
+    scanner->port = port;
+    scanner->rows = rows;
+    scanner->cols = cols;
+    scanner->num_keys = rows * cols;
+    scanner->debounce_cfg = *cfg;
+    scanner->debounce = debounce_get_strategy(cfg->algo);
+    
+    for (int i = 0; i < MATRIX_MAX_KEYS; i++) {
+        debounce_key_reset(&scanner->keys[i], 0);
+        scanner->edge_us[i] = 0;
+    }
+    scanner->raw_mask = 0;
+    scanner->state_mask = 0;
+    scanner->busy_mask = 0;
+    return true;
+}
+
+void matrix_scanner_set_debounce(matrix_scanner_t* scanner, const debounce_config_t* cfg) {
+    scanner->debounce_cfg = *cfg;
+    scanner->debounce = debounce_get_strategy(cfg->algo);
+    
+    uint32_t now_ms = scanner->port->now_us(scanner->port->ctx) / 1000;
+    for (int i = 0; i < scanner->num_keys; i++) {
+        debounce_key_t* key = &scanner->keys[i];
+        key->raw = key->state;
+        key->since_ms = now_ms;
+        key->lock_until_ms = now_ms;
+        key->level_ms = key->state ? cfg->release_ms : 0;
+    }
+    scanner->raw_mask = scanner->state_mask;
+    scanner->busy_mask = 0;
+}
+
+matrix_mask_t matrix_scanner_sample(matrix_scanner_t* scanner) {
+    const matrix_port_t* port = scanner->port;
+    matrix_mask_t sample = 0;
+    uint32_t row_bits = 0;
+    
+    for (int row = 0; row < scanner->rows; row++) {
+        /* Activate current row (set low), give pulled-down columns of the previous row time to recover */
+        port->row_write(port->ctx, row, false);
+        port->delay_us(port->ctx, row_bits ? MATRIX_ROW_RECOVER_US : MATRIX_ROW_SELECT_US);
+        
+        row_bits = port->read_cols(port->ctx);
+        sample |= (matrix_mask_t)row_bits << (row * scanner->cols);
+        
+        /* Deactivate current row (set high) */
+        port->row_write(port->ctx, row, true);
+    }
+    return sample;
+}
+
+bool matrix_scanner_update(matrix_scanner_t* scanner, matrix_mask_t sample, int64_t edge_hint_us,
+                           matrix_key_cb_t cb, void* arg) {
+    /* Only keys whose raw input changed or whose debounce is still running need work */
+    matrix_mask_t changed = sample ^ scanner->raw_mask;
+    matrix_mask_t work = changed | scanner->busy_mask;
+    scanner->raw_mask = sample;
+    
+    if (work) {
+        int64_t now_us = scanner->port->now_us(scanner->port->ctx);
+        uint32_t current_time = now_us / 1000; // Convert to ms
+        
+        while (work) {
+            int button_id = __builtin_ctzll(work);
+            matrix_mask_t bit = MATRIX_KEY_BIT(button_id);
+            bool current_state = (sample & bit) != 0;
+            debounce_key_t* key = &scanner->keys[button_id];
+            work &= work - 1;
+            
+            if (!(scanner->busy_mask & bit)) {
+                /* Start of a transition: remember when it was first seen */
+                debounce_key_resume(key, current_time);
+                scanner->edge_us[button_id] = edge_hint_us ? edge_hint_us : now_us;
+            }
+            
+            /* Debounce logic */
+            if (scanner->debounce->update(key, current_state, current_time, &scanner->debounce_cfg)) {
+                if (key->state) {
+                    scanner->state_mask |= bit;
+                } else {
+                    scanner->state_mask &= ~bit;
+                }
+                
+                if (cb) {
+                    cb(arg, button_id, key->state, scanner->edge_us[button_id]);
+                }
+            }
+            
+            if (debounce_key_busy(key, current_time)) {
+                scanner->busy_mask |= bit;
+            } else {
+                scanner->busy_mask &= ~bit;
+            }
+        }
+    }
+    
+    return (scanner->state_mask | scanner->busy_mask) != 0;
+}
@@ -0,0 +1,74 @@
+#ifndef ARMDECK_MATRIX_SCAN_H
+#define ARMDECK_MATRIX_SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "armdeck_debounce.h"
+
+/* Scanner core shared by the firmware and the host simulator (tools/matrix_sim).
+ * No ESP-IDF dependency: pins, delays and the clock go through matrix_port_t. */
+
+/* Matrix limits (actual geometry is passed to matrix_scanner_init) */
+#define MATRIX_MAX_ROWS     8
+#define MATRIX_MAX_COLS     16
+#define MATRIX_MAX_KEYS     64
+
+/* Row timing (microseconds). A key pulls its column low almost instantly, the slow
+ * part is the column rising back through the internal pull-up once a row is released,
+ * so the longer wait is only paid after a row that had keys down. */
+#ifndef MATRIX_ROW_SELECT_US
+#define MATRIX_ROW_SELECT_US    1
+#endif
+#ifndef MATRIX_ROW_RECOVER_US
+#define MATRIX_ROW_RECOVER_US   5
+#endif
+
+/* Bit-packed key set, bit n = button n */
+typedef uint64_t matrix_mask_t;
+#define MATRIX_KEY_BIT(id)  ((matrix_mask_t)1 << (id))
+_Static_assert(MATRIX_MAX_KEYS <= 64, "matrix_mask_t too small for MATRIX_MAX_KEYS");
+
+/* Hardware access used by the scanner */
+typedef struct {
+    void (*row_write)(void* ctx, uint8_t row, bool level);  // Drive a row (low = selected)
+    uint32_t (*read_cols)(void* ctx);                       // Bit n set = column n low
+    void (*delay_us)(void* ctx, uint32_t us);
+    int64_t (*now_us)(void* ctx);                           // Monotonic clock
+    void* ctx;
+} matrix_port_t;
+
+/* Debounced transition, edge_us is when the transition was first seen */
+typedef void (*matrix_key_cb_t)(void* arg, uint8_t button_id, bool pressed, int64_t edge_us);
+
+/* Scanner state (button n = row * cols + col) */
+typedef struct {
+    const matrix_port_t* port;
+    uint8_t rows;
+    uint8_t cols;
+    uint8_t num_keys;
+    debounce_config_t debounce_cfg;
+    const debounce_strategy_t* debounce;
+    debounce_key_t keys[MATRIX_MAX_KEYS];
+    int64_t edge_us[MATRIX_MAX_KEYS];   // First raw edge of the pending transition
+    matrix_mask_t raw_mask;             // Last raw sample of every key
+    matrix_mask_t state_mask;           // Debounced state of every key
+    matrix_mask_t busy_mask;            // Keys with a debounce still in progress
+} matrix_scanner_t;
+
+/* Initialize a scanner, all keys released. Returns false on an invalid geometry. */
+bool matrix_scanner_init(matrix_scanner_t* scanner, const matrix_port_t* port,
+                         uint8_t rows, uint8_t cols, const debounce_config_t* cfg);
+
+/* Switch debounce strategy, keys restart from their current debounced state */
+void matrix_scanner_set_debounce(matrix_scanner_t* scanner, const debounce_config_t* cfg);
+
+/* Sample the whole matrix into a key mask */
+matrix_mask_t matrix_scanner_sample(matrix_scanner_t* scanner);
+
+/* Debounce one sample and report transitions through cb. Returns true while any key is
+ * down or bouncing. edge_hint_us, when non-zero, is the time the transitions were really
+ * first seen (e.g. a column edge interrupt). */
+bool matrix_scanner_update(matrix_scanner_t* scanner, matrix_mask_t sample, int64_t edge_hint_us,
+                           matrix_key_cb_t cb, void* arg);
+
+#endif /* ARMDECK_MATRIX_SCAN_H */
@@ -0,0 +1,607 @@
+/* Host simulator for the matrix scanner and debouncer (main/matrix_scan.c, main/armdeck_debounce.c).
+ *
+ * Switch contact waveforms are replayed on a virtual clock through a simulated matrix_port_t,
+ * the scanner runs at the firmware scan rate (polling), and every debounce setting is scored
+ * against the expected presses: detected, missed, false triggers and latencies.
+ *
+ * Scenario file format (one statement per line, '#' starts a comment, key = button id from 0):
+ *   matrix <rows> <cols>                   matrix geometry (default 3 x 5)
+ *   tap <key> <t_ms> <hold_ms> [bounce_ms] scripted press with contact bounce on both edges
+ *   glitch <key> <t_ms> <width_us>         lone contact pulse that must not be reported
+ *   edge <t_us> <key> <0|1>                recorded contact edge (1 = closed)
+ *   expect <key> <press_ms> <release_ms>   ground truth press for recorded edges
+ *   end <t_ms>                             extend the simulated time
+ *
+ * Without a file, a synthetic scenario (taps, short taps and glitches) is generated from the seed. */
+
+#include "matrix_scan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define SIM_DEFAULT_RATE_HZ     100     // Same as the firmware SCAN_DEFAULT_RATE_HZ
+#define SIM_DEFAULT_ROWS        3
+#define SIM_DEFAULT_COLS        5
+#define SIM_TAIL_US             500000  // Simulated time after the last edge
+#define SIM_MAX_CONFIGS         16
+#define SIM_MAX_RATES           8
+
+/* Contact waveform of one key, edges sorted by time */
+typedef struct {
+    int64_t t_us;
+    uint32_t seq;           // Insertion order, keeps equal timestamps stable
+    bool closed;
+} sim_edge_t;
+
+typedef struct {
+    sim_edge_t* edges;
+    size_t count;
+    size_t cap;
+} sim_wave_t;
+
+/* Expected press */
+typedef struct {
+    uint8_t key;
+    int64_t press_us;
+    int64_t release_us;
+} sim_expect_t;
+
+typedef struct {
+    uint8_t rows;
+    uint8_t cols;
+    sim_wave_t waves[MATRIX_MAX_KEYS];
+    sim_expect_t* expects;
+    size_t num_expects;
+    size_t cap_expects;
+    uint32_t glitches;
+    uint32_t seq;
+    int64_t end_us;
+} sim_scenario_t;
+
+/* Debounced transition reported by the scanner */
+typedef struct {
+    int64_t t_us;
+    uint8_t key;
+    bool pressed;
+} sim_report_t;
+
+typedef struct {
+    sim_report_t* items;
+    size_t count;
+    size_t cap;
+} sim_reports_t;
+
+/* Simulated GPIO and clock */
+typedef struct {
+    const sim_scenario_t* scenario;
+    int64_t now_us;
+    int selected_row;                   // -1 = no row driven low
+    size_t cursor[MATRIX_MAX_KEYS];     // Next edge to apply per key
+    bool closed[MATRIX_MAX_KEYS];
+} sim_port_t;
+
+/* Score of one run */
+typedef struct {
+    uint32_t expected;
+    uint32_t detected;
+    uint32_t missed;
+    uint32_t false_triggers;
+    int64_t lat_min_us;
+    int64_t lat_max_us;
+    int64_t lat_total_us;
+    uint32_t releases;
+    int64_t rel_max_us;
+    int64_t rel_total_us;
+} sim_score_t;
+
+static uint32_t rng_state = 1;
+static bool verbose = false;
+
+static uint32_t rng_next(void) {
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+/* Uniform in [lo, hi] */
+static int64_t rng_range(int64_t lo, int64_t hi) {
+    if (hi <= lo) {
+        return lo;
+    }
+    return lo + (int64_t)(rng_next() % (uint32_t)(hi - lo + 1));
+}
+
+static void* grow(void* items, size_t* cap, size_t size) {
+    *cap = *cap ? *cap * 2 : 64;
+    void* p = realloc(items, *cap * size);
+    if (!p) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    return p;
+}
+
+/* Scenario building */
+
+static void add_edge(sim_scenario_t* sc, uint8_t key, int64_t t_us, bool closed) {
+    sim_wave_t* wave = &sc->waves[key];
+    if (wave->count == wave->cap) {
+        wave->edges = grow(wave->edges, &wave->cap, sizeof(sim_edge_t));
+    }
+    wave->edges[wave->count++] = (sim_edge_t){ .t_us = t_us, .seq = sc->seq++, .closed = closed };
+    if (t_us > sc->end_us) {
+        sc->end_us = t_us;
+    }
+}
+
+static void add_expect(sim_scenario_t* sc, uint8_t key, int64_t press_us, int64_t release_us) {
+    if (sc->num_expects == sc->cap_expects) {
+        sc->expects = grow(sc->expects, &sc->cap_expects, sizeof(sim_expect_t));
+    }
+    sc->expects[sc->num_expects++] = (sim_expect_t){ .key = key, .press_us = press_us, .release_us = release_us };
+    if (release_us > sc->end_us) {
+        sc->end_us = release_us;
+    }
+}
+
+/* Contact transition to 'closed' at t_us, chattering for bounce_us with shrinking open/close gaps */
+static void add_bouncy_edge(sim_scenario_t* sc, uint8_t key, int64_t t_us, bool closed, int64_t bounce_us) {
+    add_edge(sc, key, t_us, closed);
+    if (bounce_us <= 0) {
+        return;
+    }
+    
+    int64_t t = t_us;
+    bool level = closed;
+    int64_t max_gap = bounce_us / 3 > 1 ? bounce_us / 3 : 1;
+    while (1) {
+        t += rng_range(bounce_us / 20 + 1, max_gap);
+        if (t >= t_us + bounce_us) {
+            break;
+        }
+        level = !level;
+        add_edge(sc, key, t, level);
+        max_gap = max_gap * 3 / 4 > 1 ? max_gap * 3 / 4 : 1;
+    }
+    if (level != closed) {
+        add_edge(sc, key, t_us + bounce_us, closed);
+    }
+}
+
+static void add_tap(sim_scenario_t* sc, uint8_t key, int64_t t_us, int64_t hold_us, int64_t bounce_us) {
+    add_bouncy_edge(sc, key, t_us, true, bounce_us);
+    add_bouncy_edge(sc, key, t_us + hold_us, false, bounce_us);
+    add_expect(sc, key, t_us, t_us + hold_us);
+}
+
+static void add_glitch(sim_scenario_t* sc, uint8_t key, int64_t t_us, int64_t width_us) {
+    add_edge(sc, key, t_us, true);
+    add_edge(sc, key, t_us + width_us, false);
+    sc->glitches++;
+}
+
+static int cmp_edge(const void* a, const void* b) {
+    const sim_edge_t* ea = a;
+    const sim_edge_t* eb = b;
+    if (ea->t_us != eb->t_us) {
+        return ea->t_us < eb->t_us ? -1 : 1;
+    }
+    return ea->seq < eb->seq ? -1 : (ea->seq > eb->seq);
+}
+
+static int cmp_expect(const void* a, const void* b) {
+    const sim_expect_t* ea = a;
+    const sim_expect_t* eb = b;
+    if (ea->press_us != eb->press_us) {
+        return ea->press_us < eb->press_us ? -1 : 1;
+    }
+    return (int)ea->key - (int)eb->key;
+}
+
+static void finish_scenario(sim_scenario_t* sc) {
+    for (int i = 0; i < MATRIX_MAX_KEYS; i++) {
+        sim_wave_t* wave = &sc->waves[i];
+        if (wave->count) {
+            qsort(wave->edges, wave->count, sizeof(sim_edge_t), cmp_edge);
+        }
+    }
+    if (sc->num_expects) {
+        qsort(sc->expects, sc->num_expects, sizeof(sim_expect_t), cmp_expect);
+    }
+    sc->end_us += SIM_TAIL_US;
+}
+
+/* Synthetic scenario: ordinary taps, short taps and contact glitches on random keys */
+static void build_default_scenario(sim_scenario_t* sc) {
+    sc->rows = SIM_DEFAULT_ROWS;
+    sc->cols = SIM_DEFAULT_COLS;
+    
+    int num_keys = sc->rows * sc->cols;
+    int64_t t = 100000;
+    for (int i = 0; i < 240; i++) {
+        uint8_t key = rng_next() % num_keys;
+        uint32_t kind = rng_next() % 12;
+        
+        if (kind < 9) {
+            int64_t hold = rng_range(40000, 250000);
+            add_tap(sc, key, t, hold, rng_range(0, 5000));
+            t += hold;
+        } else if (kind < 11) {
+            int64_t hold = rng_range(8000, 20000);
+            add_tap(sc, key, t, hold, rng_range(500, 3000));
+            t += hold;
+        } else {
+            add_glitch(sc, key, t, rng_range(100, 1500));
+        }
+        t += rng_range(60000, 400000);
+    }
+}
+
+static bool parse_key(const sim_scenario_t* sc, long key, const char* path, int line) {
+    if (key < 0 || key >= sc->rows * sc->cols) {
+        fprintf(stderr, "%s:%d: key %ld outside the %dx%d matrix\n", path, line, key, sc->rows, sc->cols);
+        return false;
+    }
+    return true;
+}
+
+static bool load_scenario(sim_scenario_t* sc, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    
+    sc->rows = SIM_DEFAULT_ROWS;
+    sc->cols = SIM_DEFAULT_COLS;
+    
+    char buf[256];
+    int line = 0;
+    bool ok = true;
+    bool have_keys = false;
+    while (ok && fgets(buf, sizeof(buf), f)) {
+        line++;
+        char* hash = strchr(buf, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        
+        char cmd[16];
+        double a = 0, b = 0, c = 0, d = 0;
+        int n = sscanf(buf, "%15s %lf %lf %lf %lf", cmd, &a, &b, &c, &d);
+        if (n <= 0) {
+            continue;
+        }
+        
+        if (strcmp(cmd, "matrix") == 0 && n == 3) {
+            if (have_keys || a < 1 || b < 1 || a > MATRIX_MAX_ROWS || b > MATRIX_MAX_COLS ||
+                a * b > MATRIX_MAX_KEYS) {
+                fprintf(stderr, "%s:%d: invalid matrix (must come first, max %dx%d, %d keys)\n",
+                        path, line, MATRIX_MAX_ROWS, MATRIX_MAX_COLS, MATRIX_MAX_KEYS);
+                ok = false;
+            }
+            sc->rows = (uint8_t)a;
+            sc->cols = (uint8_t)b;
+        } else if (strcmp(cmd, "tap") == 0 && (n == 4 || n == 5)) {
+            ok = parse_key(sc, (long)a, path, line);
+            if (ok) {
+                add_tap(sc, (uint8_t)a, (int64_t)(b * 1000), (int64_t)(c * 1000), (int64_t)(d * 1000));
+            }
+        } else if (strcmp(cmd, "glitch") == 0 && n == 4) {
+            ok = parse_key(sc, (long)a, path, line);
+            if (ok) {
+                add_glitch(sc, (uint8_t)a, (int64_t)(b * 1000), (int64_t)c);
+            }
+        } else if (strcmp(cmd, "edge") == 0 && n == 4) {
+            ok = parse_key(sc, (long)b, path, line);
+            if (ok) {
+                add_edge(sc, (uint8_t)b, (int64_t)a, c != 0);
+            }
+        } else if (strcmp(cmd, "expect") == 0 && n == 4) {
+            ok = parse_key(sc, (long)a, path, line);
+            if (ok) {
+                add_expect(sc, (uint8_t)a, (int64_t)(b * 1000), (int64_t)(c * 1000));
+            }
+        } else if (strcmp(cmd, "end") == 0 && n == 2) {
+            if ((int64_t)(a * 1000) > sc->end_us) {
+                sc->end_us = (int64_t)(a * 1000);
+            }
+        } else {
+            fprintf(stderr, "%s:%d: cannot parse '%s'\n", path, line, cmd);
+            ok = false;
+        }
+        have_keys = have_keys || strcmp(cmd, "matrix") != 0;
+    }
+    
+    fclose(f);
+    return ok;
+}
+
+/* Simulated port */
+
+static void sim_row_write(void* ctx, uint8_t row, bool level) {
+    sim_port_t* port = ctx;
+    if (!level) {
+        port->selected_row = row;
+    } else if (port->selected_row == row) {
+        port->selected_row = -1;
+    }
+}
+
+/* Contact state of a key at the current time (time only moves forward) */
+static bool sim_key_closed(sim_port_t* port, int key) {
+    const sim_wave_t* wave = &port->scenario->waves[key];
+    while (port->cursor[key] < wave->count && wave->edges[port->cursor[key]].t_us <= port->now_us) {
+        port->closed[key] = wave->edges[port->cursor[key]].closed;
+        port->cursor[key]++;
+    }
+    return port->closed[key];
+}
+
+static uint32_t sim_read_cols(void* ctx) {
+    sim_port_t* port = ctx;
+    uint8_t cols = port->scenario->cols;
+    uint32_t bits = 0;
+    
+    if (port->selected_row < 0) {
+        return 0;
+    }
+    for (int col = 0; col < cols; col++) {
+        if (sim_key_closed(port, port->selected_row * cols + col)) {
+            bits |= 1UL << col;
+        }
+    }
+    return bits;
+}
+
+static void sim_delay_us(void* ctx, uint32_t us) {
+    ((sim_port_t*)ctx)->now_us += us;
+}
+
+static int64_t sim_now_us(void* ctx) {
+    return ((sim_port_t*)ctx)->now_us;
+}
+
+/* Run and score */
+
+static void on_report(void* arg, uint8_t button_id, bool pressed, int64_t edge_us) {
+    sim_reports_t* reports = arg;
+    (void)edge_us;
+    if (reports->count == reports->cap) {
+        reports->items = grow(reports->items, &reports->cap, sizeof(sim_report_t));
+    }
+    reports->items[reports->count++] = (sim_report_t){ .key = button_id, .pressed = pressed };
+}
+
+static void run_scenario(const sim_scenario_t* sc, const debounce_config_t* cfg, uint16_t rate_hz,
+                         sim_reports_t* reports) {
+    sim_port_t state = { .scenario = sc, .selected_row = -1 };
+    const matrix_port_t port = {
+        .row_write = sim_row_write,
+        .read_cols = sim_read_cols,
+        .delay_us = sim_delay_us,
+        .now_us = sim_now_us,
+        .ctx = &state
+    };
+    matrix_scanner_t scanner;
+    matrix_scanner_init(&scanner, &port, sc->rows, sc->cols, cfg);
+    
+    int64_t period_us = 1000000 / rate_hz;
+    reports->count = 0;
+    for (int64_t t = 0; t <= sc->end_us; t += period_us) {
+        state.now_us = t;
+        matrix_mask_t sample = matrix_scanner_sample(&scanner);
+        size_t first = reports->count;
+        matrix_scanner_update(&scanner, sample, 0, on_report, reports);
+        
+        /* Reports carry the time the scanner delivered them */
+        for (size_t i = first; i < reports->count; i++) {
+            reports->items[i].t_us = state.now_us;
+        }
+    }
+}
+
+static void score_run(const sim_scenario_t* sc, const sim_reports_t* reports, sim_score_t* score) {
+    size_t n = sc->num_expects;
+    bool* matched = calloc(n ? n : 1, sizeof(bool));
+    int64_t* press_at = calloc(n ? n : 1, sizeof(int64_t));
+    
+    *score = (sim_score_t){ .expected = n, .lat_min_us = INT64_MAX };
+    
+    for (size_t r = 0; r < reports->count; r++) {
+        const sim_report_t* rep = &reports->items[r];
+        
+        /* The press window of an expected press runs until the next press of the same key */
+        size_t owner = n;
+        for (size_t i = 0; i < n; i++) {
+            if (sc->expects[i].key == rep->key && sc->expects[i].press_us <= rep->t_us) {
+                owner = i;
+            }
+        }
+        
+        if (rep->pressed) {
+            if (owner == n || matched[owner]) {
+                score->false_triggers++;
+                if (verbose) {
+                    printf("    false press   key %2d at %9.3f ms\n", rep->key, rep->t_us / 1000.0);
+                }
+                continue;
+            }
+            matched[owner] = true;
+            press_at[owner] = rep->t_us;
+            
+            int64_t latency = rep->t_us - sc->expects[owner].press_us;
+            score->detected++;
+            score->lat_total_us += latency;
+            score->lat_min_us = latency < score->lat_min_us ? latency : score->lat_min_us;
+            score->lat_max_us = latency > score->lat_max_us ? latency : score->lat_max_us;
+        } else if (owner != n && matched[owner] && press_at[owner] >= 0 &&
+                   rep->t_us >= sc->expects[owner].release_us) {
+            /* First release after the press, counted once */
+            int64_t latency = rep->t_us - sc->expects[owner].release_us;
+            press_at[owner] = -1;
+            score->releases++;
+            score->rel_total_us += latency;
+            score->rel_max_us = latency > score->rel_max_us ? latency : score->rel_max_us;
+        }
+    }
+    
+    for (size_t i = 0; i < n; i++) {
+        if (!matched[i]) {
+            score->missed++;
+            if (verbose) {
+                printf("    missed press  key %2d at %9.3f ms (held %.3f ms)\n", sc->expects[i].key,
+                       sc->expects[i].press_us / 1000.0,
+                       (sc->expects[i].release_us - sc->expects[i].press_us) / 1000.0);
+            }
+        }
+    }
+    
+    free(matched);
+    free(press_at);
+}
+
+static bool parse_debounce(const char* arg, debounce_config_t* cfg) {
+    char name[16];
+    unsigned press = 0, release = 0;
+    if (sscanf(arg, "%15[^:]:%u:%u", name, &press, &release) != 3 || press > 255 || release > 255) {
+        return false;
+    }
+    
+    for (int algo = 0; algo < DEBOUNCE_ALGO_COUNT; algo++) {
+        if (strcasecmp(name, debounce_get_strategy(algo)->name) == 0) {
+            *cfg = (debounce_config_t){ .algo = algo, .press_ms = press, .release_ms = release };
+            return debounce_config_valid(cfg);
+        }
+    }
+    return false;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [-r rate_hz]... [-d algo:press_ms:release_ms]... [-s seed] [-v] [-e] [scenario]\n"
+            "  -r  scan rate in Hz (default %d, repeat to compare rates)\n"
+            "  -d  debounce setting, algo = defer | eager | integrator (repeat to compare)\n"
+            "  -s  seed for the synthetic scenario and scripted bounce (default 1)\n"
+            "  -v  list missed presses and false triggers\n"
+            "  -e  exit with status 1 if any setting misses a press or reports a false trigger\n",
+            prog, SIM_DEFAULT_RATE_HZ);
+}
+
+int main(int argc, char** argv) {
+    static const debounce_config_t default_configs[] = {
+        { DEBOUNCE_DEFER,      5,  5 },
+        { DEBOUNCE_DEFER,      10, 20 },
+        { DEBOUNCE_EAGER,      5,  10 },
+        { DEBOUNCE_EAGER,      DEBOUNCE_DEFAULT_PRESS_MS, DEBOUNCE_DEFAULT_RELEASE_MS },
+        { DEBOUNCE_INTEGRATOR, 5,  10 },
+        { DEBOUNCE_INTEGRATOR, 10, 20 },
+    };
+    debounce_config_t configs[SIM_MAX_CONFIGS];
+    uint16_t rates[SIM_MAX_RATES];
+    int num_configs = 0;
+    int num_rates = 0;
+    bool strict = false;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "r:d:s:veh")) != -1) {
+        switch (opt) {
+            case 'r': {
+                long rate = strtol(optarg, NULL, 10);
+                if (rate < 1 || rate > 100000 || num_rates == SIM_MAX_RATES) {
+                    fprintf(stderr, "invalid or too many scan rates: %s\n", optarg);
+                    return 2;
+                }
+                rates[num_rates++] = (uint16_t)rate;
+                break;
+            }
+            case 'd':
+                if (num_configs == SIM_MAX_CONFIGS || !parse_debounce(optarg, &configs[num_configs])) {
+                    fprintf(stderr, "invalid or too many debounce settings: %s\n", optarg);
+                    return 2;
+                }
+                num_configs++;
+                break;
+            case 's':
+                rng_state = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'e':
+                strict = true;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (optind < argc - 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    
+    if (num_configs == 0) {
+        num_configs = sizeof(default_configs) / sizeof(default_configs[0]);
+        memcpy(configs, default_configs, sizeof(default_configs));
+    }
+    if (num_rates == 0) {
+        rates[num_rates++] = SIM_DEFAULT_RATE_HZ;
+    }
+    
+    static sim_scenario_t scenario;
+    const char* name = "built-in";
+    if (optind < argc) {
+        name = argv[optind];
+        if (!load_scenario(&scenario, name)) {
+            return 2;
+        }
+    } else {
+        build_default_scenario(&scenario);
+    }
+    finish_scenario(&scenario);
+    
+    printf("Scenario %s: %dx%d matrix, %zu presses, %u glitches, %.1f s\n", name, scenario.rows,
+           scenario.cols, scenario.num_expects, scenario.glitches, scenario.end_us / 1e6);
+           
+    sim_reports_t reports = {0};
+    bool failed = false;
+    for (int r = 0; r < num_rates; r++) {
+        printf("\nScan rate %d Hz (polling, one scan every %.2f ms)\n", rates[r], 1000.0 / rates[r]);
+        printf("%-18s %8s %8s %6s %6s   %-28s %s\n", "debounce", "expected", "detected", "missed",
+               "false", "press latency ms min/avg/max", "release ms avg/max");
+               
+        for (int c = 0; c < num_configs; c++) {
+            const debounce_config_t* cfg = &configs[c];
+            char label[32];
+            snprintf(label, sizeof(label), "%s %d/%d", debounce_get_strategy(cfg->algo)->name,
+                     cfg->press_ms, cfg->release_ms);
+                     
+            sim_score_t score;
+            if (verbose) {
+                printf("  %s\n", label);
+            }
+            run_scenario(&scenario, cfg, rates[r], &reports);
+            score_run(&scenario, &reports, &score);
+            
+            char press[48] = "-";
+            char release[32] = "-";
+            if (score.detected) {
+                snprintf(press, sizeof(press), "%.2f / %.2f / %.2f", score.lat_min_us / 1000.0,
+                         score.lat_total_us / 1000.0 / score.detected, score.lat_max_us / 1000.0);
+            }
+            if (score.releases) {
+                snprintf(release, sizeof(release), "%.2f / %.2f",
+                         score.rel_total_us / 1000.0 / score.releases, score.rel_max_us / 1000.0);
+            }
+            printf("%-18s %8u %8u %6u %6u   %-28s %s\n", label, score.expected, score.detected,
+                   score.missed, score.false_triggers, press, release);
+                   
+            failed = failed || score.missed || score.false_triggers;
+        }
+    }
+    
+    free(reports.items);
+    return strict && failed ? 1 : 0;
+}